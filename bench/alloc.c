@@ -0,0 +1,152 @@
+// alloc.c counts heap activity for the benchmark harnesses by replacing
+// the allocator entry points and forwarding to the glibc implementation
+#include <stdatomic.h>
+#include <stdlib.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include <string.h>
+
+#include "alloc.h"
+
+static atomic_size_t allocation_count = 0;
+static atomic_size_t free_count = 0;
+static atomic_size_t byte_count = 0;
+// heap bytes in use, their high-water mark and what was in use at the reset
+static atomic_size_t live_bytes = 0;
+static atomic_size_t peak_live_bytes = 0;
+static atomic_size_t reset_live_bytes = 0;
+
+#ifdef __GLIBC__
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void *__libc_memalign(size_t alignment, size_t size);
+extern void __libc_free(void *ptr);
+
+// track_live adds the usable size of a new block to the bytes in use
+// and raises their high-water mark
+static void *track_live(void *ptr)
+{
+    if (ptr == NULL)
+    {
+        return NULL;
+    }
+
+    size_t size = malloc_usable_size(ptr);
+    size_t live = atomic_fetch_add_explicit(&live_bytes, size, memory_order_relaxed) + size;
+    size_t peak = atomic_load_explicit(&peak_live_bytes, memory_order_relaxed);
+    while (live > peak && !atomic_compare_exchange_weak_explicit(&peak_live_bytes, &peak, live, memory_order_relaxed, memory_order_relaxed))
+    {
+    }
+    return ptr;
+}
+
+// untrack_live removes the usable size of a block about to be released
+static void untrack_live(void *ptr)
+{
+    if (ptr != NULL)
+    {
+        atomic_fetch_sub_explicit(&live_bytes, malloc_usable_size(ptr), memory_order_relaxed);
+    }
+}
+
+static void count_allocation(size_t size)
+{
+    atomic_fetch_add_explicit(&allocation_count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&byte_count, size, memory_order_relaxed);
+}
+
+void *malloc(size_t size)
+{
+    count_allocation(size);
+    return track_live(__libc_malloc(size));
+}
+
+void *calloc(size_t count, size_t size)
+{
+    count_allocation(count * size);
+    return track_live(__libc_calloc(count, size));
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    count_allocation(size);
+    // the old block stays in use when a resize fails
+    size_t old_size = ptr != NULL ? malloc_usable_size(ptr) : 0;
+    void *result = __libc_realloc(ptr, size);
+    if (result == NULL && size != 0)
+    {
+        return NULL;
+    }
+
+    atomic_fetch_sub_explicit(&live_bytes, old_size, memory_order_relaxed);
+    return track_live(result);
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    count_allocation(size);
+    return track_live(__libc_memalign(alignment, size));
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    return memalign(alignment, size);
+}
+
+int posix_memalign(void **ptr, size_t alignment, size_t size)
+{
+    void *result = memalign(alignment, size);
+    if (result == NULL)
+    {
+        return 12; // ENOMEM
+    }
+
+    *ptr = result;
+    return 0;
+}
+
+void free(void *ptr)
+{
+    if (ptr != NULL)
+    {
+        atomic_fetch_add_explicit(&free_count, 1, memory_order_relaxed);
+    }
+    untrack_live(ptr);
+    __libc_free(ptr);
+}
+
+bool alloc_counter_supported(void)
+{
+    return true;
+}
+#else
+bool alloc_counter_supported(void)
+{
+    return false;
+}
+#endif
+
+void alloc_counter_reset(void)
+{
+    atomic_store(&allocation_count, 0);
+    atomic_store(&free_count, 0);
+    atomic_store(&byte_count, 0);
+    size_t live = atomic_load(&live_bytes);
+    atomic_store(&reset_live_bytes, live);
+    atomic_store(&peak_live_bytes, live);
+}
+
+struct AllocStats alloc_counter_read(void)
+{
+    struct AllocStats stats = {
+        .allocations = atomic_load(&allocation_count),
+        .frees = atomic_load(&free_count),
+        .bytes = atomic_load(&byte_count),
+    };
+    size_t peak = atomic_load(&peak_live_bytes);
+    size_t reset = atomic_load(&reset_live_bytes);
+    stats.peak_bytes = peak > reset ? peak - reset : 0;
+    return stats;
+}
@@ -0,0 +1,30 @@
+#ifndef BENCH_ALLOC_H
+#define BENCH_ALLOC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// AllocStats holds the heap activity observed since the last reset
+struct AllocStats
+{
+    // number of calls that returned new memory (malloc, calloc, realloc)
+    size_t allocations;
+    // number of calls to free with a non-NULL pointer
+    size_t frees;
+    // total number of bytes requested by allocations
+    size_t bytes;
+    // highest number of heap bytes in use at once, above what was in use at the reset
+    size_t peak_bytes;
+};
+
+// alloc_counter_supported reports whether allocations are being counted
+// counting relies on replacing the glibc allocator and is unavailable elsewhere
+bool alloc_counter_supported(void);
+
+// alloc_counter_reset zeroes all counters
+void alloc_counter_reset(void);
+
+// alloc_counter_read returns a snapshot of the counters
+struct AllocStats alloc_counter_read(void);
+
+#endif
@@ -0,0 +1,612 @@
+// loader.c benchmarks how loading items scales with their number
+//
+// it generates item files of increasing size and loads each one from a
+// file and from stdin, with and without lazy loading and gzip compression,
+// progressively and as a compiled deck. every run happens in a forked child
+// and reports the parse time, time to first frame, peak RSS and heap
+// activity as one CSV row or JSON record.
+//
+// usage: loader-bench [--output <path>] [--format csv|json] [--counts <n,n,...>]
+//                     [--max-items <n>] [--corpus-dir <path>] [--keep-corpus]
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+
+#define main minui_presenter_main
+#include "../minui-presenter.c"
+#undef main
+
+#include "alloc.h"
+
+// LoaderOptions holds the command line options of the harness
+struct LoaderOptions
+{
+    // where to write the results (stdout when empty)
+    char output[1024];
+    // whether to write csv or json
+    bool json;
+    // comma separated list of item counts to benchmark
+    char counts[1024];
+    // counts above this are skipped
+    long max_items;
+    // where the generated item files are written
+    char corpus_dir[1024];
+    // whether to leave the generated files behind
+    bool keep_corpus;
+};
+
+// LoaderResult is sent from the measuring child back to the parent
+struct LoaderResult
+{
+    // whether ItemsState_New() returned a state
+    bool ok;
+    // time spent inside ItemsState_New()
+    uint64_t parse_ns;
+    // time from the start of loading until the first frame was drawn
+    uint64_t first_frame_ns;
+    // peak resident set size of the child
+    long peak_rss_kb;
+    // peak resident set size minus the resident set size at fork
+    long rss_delta_kb;
+    // heap activity during loading
+    struct AllocStats allocs;
+};
+
+static const char *loader_colors[] = {"#000000", "#FFFFFF", "#336699", "#993333", "#339933", "#222222", "#F0A030", "#101820"};
+static const char *loader_words[] = {"lorem", "ipsum", "dolor", "sit", "amet", "presenter", "slide", "gallery", "install", "progress", "confirm", "device", "storage", "network"};
+static const char *loader_alignments[] = {"top", "middle", "bottom"};
+
+// LoaderInput is one way of handing the item file to ItemsState_New()
+struct LoaderInput
+{
+    // the name used in the results
+    const char *name;
+    // whether the file is piped through stdin
+    bool use_stdin;
+    // whether items are lazily loaded
+    bool lazy;
+    // whether the gzip compressed JSON file is loaded
+    bool gzip;
+    // whether the compiled deck is loaded instead of the JSON file
+    bool deck;
+    // whether the first frame is drawn while the rest of the items are parsed
+    bool progressive;
+    // whether the file lists "selected" after "items", so a progressive
+    // load only learns which item to show once every item was parsed
+    bool selected_last;
+};
+
+static const struct LoaderInput loader_inputs[] = {
+    {"file", false, false, false, false, false, false},
+    {"stdin", true, false, false, false, false, false},
+    {"file-lazy", false, true, false, false, false, false},
+    {"stdin-lazy", true, true, false, false, false, false},
+    {"file-gzip", false, false, true, false, false, false},
+    {"stdin-gzip", true, false, true, false, false, false},
+    {"file-gzip-lazy", false, true, true, false, false, false},
+    {"deck", false, false, false, true, false, false},
+    {"file-progressive", false, false, false, false, true, false},
+    {"stdin-progressive", true, false, false, false, true, false},
+    {"file-selected-last", false, false, false, false, false, true},
+    {"file-progressive-selected-last", false, false, false, false, true, true},
+};
+
+// now_ns returns a monotonic timestamp in nanoseconds
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// max_rss_kb returns the peak resident set size of the calling process in kilobytes
+static long max_rss_kb(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+// next_random is a small xorshift generator so corpora are reproducible
+static uint32_t next_random(uint32_t *seed)
+{
+    *seed ^= *seed << 13;
+    *seed ^= *seed >> 17;
+    *seed ^= *seed << 5;
+    return *seed;
+}
+
+// generate_items writes an item file with a mix of every supported field,
+// selecting the middle item either before or after the items
+static bool generate_items(const char *path, long count, const char *image_path, bool selected_last)
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    uint32_t seed = 2463534242u ^ (uint32_t)count;
+    size_t word_count = sizeof(loader_words) / sizeof(loader_words[0]);
+
+    fprintf(file, "{\n  // generated by loader-bench\n");
+    if (!selected_last)
+    {
+        fprintf(file, "  \"selected\": %ld,\n", count / 2);
+    }
+    fprintf(file, "  \"items\": [\n");
+    for (long i = 0; i < count; i++)
+    {
+        fprintf(file, "    {\"text\": \"Item %ld:", i);
+        int words = 3 + next_random(&seed) % 12;
+        for (int w = 0; w < words; w++)
+        {
+            fprintf(file, " %s", loader_words[next_random(&seed) % word_count]);
+        }
+        fprintf(file, "\"");
+
+        switch (next_random(&seed) % 3)
+        {
+        case 0:
+            fprintf(file, ", \"background_image\": \"%s\"", image_path);
+            break;
+        case 1:
+            fprintf(file, ", \"background_image\": \"/nonexistent/slide-%ld.png\"", i);
+            break;
+        }
+
+        if (next_random(&seed) % 4 != 0)
+        {
+            fprintf(file, ", \"background_color\": \"%s\"", loader_colors[next_random(&seed) % 8]);
+        }
+
+        if (next_random(&seed) % 2 == 0)
+        {
+            fprintf(file, ", \"show_pill\": %s", next_random(&seed) % 2 ? "true" : "false");
+        }
+
+        if (next_random(&seed) % 2 == 0)
+        {
+            fprintf(file, ", \"alignment\": \"%s\"", loader_alignments[next_random(&seed) % 3]);
+        }
+
+        fprintf(file, "}%s\n", i + 1 < count ? "," : "");
+    }
+    if (selected_last)
+    {
+        fprintf(file, "  ],\n  \"selected\": %ld\n}\n", count / 2);
+    }
+    else
+    {
+        fprintf(file, "  ]\n}\n");
+    }
+
+    return fclose(file) == 0;
+}
+
+// generate_image writes a small PNG that items can reference
+static bool generate_image(const char *path)
+{
+    SDL_Surface *surface = SDL_CreateRGBSurface(0, 320, 240, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0);
+    if (surface == NULL)
+    {
+        return false;
+    }
+
+    SDL_FillRect(surface, NULL, SDL_MapRGB(surface->format, 0x33, 0x66, 0x99));
+    int result = IMG_SavePNG(surface, path);
+    SDL_FreeSurface(surface);
+    return result == 0;
+}
+
+// generate_gzip writes a gzip compressed copy of an item file
+static bool generate_gzip(const char *path, const char *gzip_path)
+{
+    FILE *file = fopen(path, "rb");
+    gzFile gz = gzopen(gzip_path, "wb6");
+    bool ok = file != NULL && gz != NULL;
+
+    char buffer[65536];
+    size_t bytes_read;
+    while (ok && (bytes_read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    {
+        ok = gzwrite(gz, buffer, bytes_read) == (int)bytes_read;
+    }
+
+    if (file != NULL)
+    {
+        fclose(file);
+    }
+    if (gz != NULL && gzclose(gz) != Z_OK)
+    {
+        ok = false;
+    }
+    return ok;
+}
+
+// generate_deck compiles an item file into a deck in a child so the
+// parent's heap and RSS stay untouched for the measured runs
+static bool generate_deck(struct AppState *state, const char *path, const char *deck_path)
+{
+    pid_t child = fork();
+    if (child == 0)
+    {
+        struct ItemsState *items_state = ItemsState_New(path, state->item_key, state->background_image, state->background_color, state->show_pill, MessageAlignmentMiddle, false);
+        _exit(items_state != NULL && compile_deck(items_state, deck_path) ? 0 : 1);
+    }
+
+    int status = 0;
+    waitpid(child, &status, 0);
+    return child > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// stream_file_to_stdin replaces stdin with a pipe fed by a writer process
+// so the stdin path is measured the way scripts use it
+static pid_t stream_file_to_stdin(const char *path)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        return -1;
+    }
+
+    pid_t writer = fork();
+    if (writer == 0)
+    {
+        close(fds[0]);
+        FILE *file = fopen(path, "r");
+        if (file == NULL)
+        {
+            _exit(1);
+        }
+
+        char buffer[65536];
+        size_t bytes_read;
+        while ((bytes_read = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        {
+            if (write(fds[1], buffer, bytes_read) != (ssize_t)bytes_read)
+            {
+                _exit(1);
+            }
+        }
+        _exit(0);
+    }
+
+    close(fds[1]);
+    dup2(fds[0], STDIN_FILENO);
+    close(fds[0]);
+    return writer;
+}
+
+// measure loads the items in the calling (forked) process and draws the first frame
+static struct LoaderResult measure(struct AppState *state, const char *path, const struct LoaderInput *input)
+{
+    bool use_stdin = input->use_stdin;
+    struct LoaderResult result = {0};
+    long start_rss_kb = max_rss_kb();
+
+    pid_t writer = -1;
+    if (use_stdin)
+    {
+        writer = stream_file_to_stdin(path);
+    }
+
+    alloc_counter_reset();
+    uint64_t start = now_ns();
+    if (input->progressive)
+    {
+        strncpy(state->file, use_stdin ? "-" : path, sizeof(state->file) - 1);
+        if (!ItemsProgress_Start(state))
+        {
+            state->items_state = NULL;
+        }
+    }
+    else
+    {
+        state->items_state = ItemsState_New(use_stdin ? "-" : path, state->item_key, state->background_image, state->background_color, state->show_pill, MessageAlignmentMiddle, input->lazy);
+        result.parse_ns = now_ns() - start;
+        result.allocs = alloc_counter_read();
+    }
+
+    if (state->items_state != NULL)
+    {
+        result.ok = true;
+        GFX_clear(screen);
+        draw_screen(screen, state);
+        result.first_frame_ns = now_ns() - start;
+    }
+
+    // a progressive load keeps parsing after the first frame, until its last item
+    if (input->progressive && result.ok)
+    {
+        ItemsProgress_Wait(state, SIZE_MAX);
+        result.parse_ns = now_ns() - start;
+        result.allocs = alloc_counter_read();
+        result.ok = !state->quitting;
+    }
+
+    if (writer > 0)
+    {
+        waitpid(writer, NULL, 0);
+    }
+
+    result.peak_rss_kb = max_rss_kb();
+    result.rss_delta_kb = result.peak_rss_kb - start_rss_kb;
+    return result;
+}
+
+// run_isolated measures a single run in a child so peak RSS and leaks don't carry over
+static bool run_isolated(struct AppState *state, const char *path, const struct LoaderInput *input, struct LoaderResult *result)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        return false;
+    }
+
+    pid_t child = fork();
+    if (child == 0)
+    {
+        close(fds[0]);
+        struct LoaderResult child_result = measure(state, path, input);
+        ssize_t written = write(fds[1], &child_result, sizeof(child_result));
+        _exit(written == sizeof(child_result) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    ssize_t bytes_read = read(fds[0], result, sizeof(*result));
+    close(fds[0]);
+
+    int status = 0;
+    waitpid(child, &status, 0);
+    return bytes_read == sizeof(*result) && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+static bool parse_loader_arguments(struct LoaderOptions *options, int argc, char *argv[])
+{
+    static struct option long_options[] = {
+        {"output", required_argument, 0, 'o'},
+        {"format", required_argument, 0, 'f'},
+        {"counts", required_argument, 0, 'n'},
+        {"max-items", required_argument, 0, 'm'},
+        {"corpus-dir", required_argument, 0, 'c'},
+        {"keep-corpus", no_argument, 0, 'k'},
+        {0, 0, 0, 0}};
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "o:f:n:m:c:k", long_options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'o':
+            strncpy(options->output, optarg, sizeof(options->output) - 1);
+            break;
+        case 'f':
+            if (strcmp(optarg, "json") == 0)
+            {
+                options->json = true;
+            }
+            else if (strcmp(optarg, "csv") != 0)
+            {
+                log_error("Invalid format provided");
+                return false;
+            }
+            break;
+        case 'n':
+            strncpy(options->counts, optarg, sizeof(options->counts) - 1);
+            break;
+        case 'm':
+            options->max_items = atol(optarg);
+            break;
+        case 'c':
+            strncpy(options->corpus_dir, optarg, sizeof(options->corpus_dir) - 1);
+            break;
+        case 'k':
+            options->keep_corpus = true;
+            break;
+        default:
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    struct LoaderOptions options = {
+        .output = "",
+        .json = false,
+        .counts = "10,100,1000,10000,100000,1000000",
+        .max_items = 1000000,
+        .corpus_dir = "",
+        .keep_corpus = false,
+    };
+    if (!parse_loader_arguments(&options, argc, argv))
+    {
+        return ExitCodeError;
+    }
+
+    if (options.corpus_dir[0] == '\0')
+    {
+        strncpy(options.corpus_dir, "/tmp/minui-presenter-loader-XXXXXX", sizeof(options.corpus_dir) - 1);
+        if (mkdtemp(options.corpus_dir) == NULL)
+        {
+            log_error("Failed to create corpus directory");
+            return ExitCodeError;
+        }
+    }
+    else
+    {
+        mkdir(options.corpus_dir, 0755);
+    }
+
+    // render without a display unless the caller picked a driver
+    setenv("SDL_VIDEODRIVER", "dummy", 0);
+    setenv("SDL_AUDIODRIVER", "dummy", 0);
+    swallow_stdout_from_function(init);
+
+    struct AppState state = {
+        .redraw = 1,
+        .exit_code = ExitCodeSuccess,
+        .fonts = {
+            .size = FONT_LARGE,
+            .font_path = strdup(FONT_PATH),
+        },
+        .background_color = "#000000",
+        .item_key = "items",
+    };
+    if (!open_fonts(&state))
+    {
+        return ExitCodeError;
+    }
+
+    char image_path[1024];
+    snprintf(image_path, sizeof(image_path), "%s/background.png", options.corpus_dir);
+    if (!generate_image(image_path))
+    {
+        log_error("Failed to generate background image");
+        return ExitCodeError;
+    }
+
+    FILE *out = stdout;
+    if (options.output[0] != '\0')
+    {
+        out = fopen(options.output, "w");
+        if (out == NULL)
+        {
+            log_error("Failed to open output file");
+            return ExitCodeError;
+        }
+    }
+
+    if (options.json)
+    {
+        fprintf(out, "{\n  \"benchmark\": \"loader\",\n  \"platform\": \"%s\",\n  \"allocations_counted\": %s,\n  \"scenarios\": [\n",
+                PLATFORM, alloc_counter_supported() ? "true" : "false");
+    }
+    else
+    {
+        fprintf(out, "items,input,file_bytes,parse_ms,first_frame_ms,peak_rss_kb,rss_delta_kb,allocations,alloc_bytes,status\n");
+    }
+    fflush(out);
+
+    bool first = true;
+
+    char *counts = strdup(options.counts);
+    for (char *token = strtok(counts, ","); token != NULL; token = strtok(NULL, ","))
+    {
+        long count = atol(token);
+        if (count <= 0 || count > options.max_items)
+        {
+            continue;
+        }
+
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/items-%ld.json", options.corpus_dir, count);
+        char selected_last_path[1024];
+        snprintf(selected_last_path, sizeof(selected_last_path), "%s/items-%ld-selected-last.json", options.corpus_dir, count);
+        if (!generate_items(path, count, image_path, false) || !generate_items(selected_last_path, count, image_path, true))
+        {
+            log_error("Failed to generate item file");
+            return ExitCodeError;
+        }
+
+        char deck_path[1024];
+        snprintf(deck_path, sizeof(deck_path), "%s/items-%ld.deck", options.corpus_dir, count);
+        if (!generate_deck(&state, path, deck_path))
+        {
+            log_error("Failed to compile item file");
+            return ExitCodeError;
+        }
+
+        char gzip_path[1024];
+        snprintf(gzip_path, sizeof(gzip_path), "%s/items-%ld.json.gz", options.corpus_dir, count);
+        if (!generate_gzip(path, gzip_path))
+        {
+            log_error("Failed to compress item file");
+            return ExitCodeError;
+        }
+
+        struct stat st;
+        stat(path, &st);
+        struct stat gzip_st;
+        stat(gzip_path, &gzip_st);
+        struct stat deck_st;
+        stat(deck_path, &deck_st);
+
+        for (size_t i = 0; i < sizeof(loader_inputs) / sizeof(loader_inputs[0]); i++)
+        {
+            const struct LoaderInput *input = &loader_inputs[i];
+            struct LoaderResult result = {0};
+            const char *input_path = input->deck ? deck_path : (input->gzip ? gzip_path : (input->selected_last ? selected_last_path : path));
+            bool ok = run_isolated(&state, input_path, input, &result) && result.ok;
+            long long file_bytes = input->deck ? (long long)deck_st.st_size : (input->gzip ? (long long)gzip_st.st_size : (long long)st.st_size);
+            if (options.json)
+            {
+                fprintf(out, "%s    {\"name\": \"items-%ld/%s\", \"file_bytes\": %lld, \"parse_ms\": %.3f, \"first_frame_ms\": %.3f, \"peak_rss_kb\": %ld, \"rss_delta_kb\": %ld, \"allocations\": %zu, \"alloc_bytes\": %zu, \"ok\": %s}",
+                        first ? "" : ",\n",
+                        count,
+                        input->name,
+                        file_bytes,
+                        result.parse_ns / 1e6,
+                        result.first_frame_ns / 1e6,
+                        result.peak_rss_kb,
+                        result.rss_delta_kb,
+                        result.allocs.allocations,
+                        result.allocs.bytes,
+                        ok ? "true" : "false");
+                first = false;
+            }
+            else
+            {
+                fprintf(out, "%ld,%s,%lld,%.3f,%.3f,%ld,%ld,%zu,%zu,%s\n",
+                        count,
+                        input->name,
+                        file_bytes,
+                        result.parse_ns / 1e6,
+                        result.first_frame_ns / 1e6,
+                        result.peak_rss_kb,
+                        result.rss_delta_kb,
+                        result.allocs.allocations,
+                        result.allocs.bytes,
+                        ok ? "ok" : "error");
+            }
+            fflush(out);
+        }
+
+        if (!options.keep_corpus)
+        {
+            unlink(path);
+            unlink(gzip_path);
+            unlink(deck_path);
+            unlink(selected_last_path);
+        }
+    }
+    free(counts);
+
+    if (options.json)
+    {
+        fprintf(out, "\n  ]\n}\n");
+    }
+    fflush(out);
+
+    if (out != stdout)
+    {
+        fclose(out);
+    }
+
+    if (!options.keep_corpus)
+    {
+        unlink(image_path);
+        rmdir(options.corpus_dir);
+    }
+
+    swallow_stdout_from_function(destruct);
+    return ExitCodeSuccess;
+}
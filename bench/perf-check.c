@@ -0,0 +1,443 @@
+// perf-check.c compares benchmark results against committed baselines
+// and fails when a gated metric regresses beyond its tolerance
+//
+// usage: perf-check [--allow-unbaselined] [--tolerance <metric>=<fraction>]... <baseline> <results> [<baseline> <results>]...
+//        perf-check --record <baseline> <results>
+//
+// baselines hold a "tolerances" object mapping each gated metric to the
+// allowed relative increase (0.10 = 10%) and a "scenarios" object mapping
+// scenario names to their recorded metrics. results are the JSON written
+// by render-bench and loader-bench (--format json).
+//
+// a check that compares no scenario at all fails, so empty baselines can't
+// pass the gate, unless --allow-unbaselined is given. a --tolerance for a
+// metric that no baseline gates fails the check as well. scenarios without
+// a baseline, or whose baseline lacks some gated metrics, are listed.
+#include <getopt.h>
+#include <math.h>
+#include <parson/parson.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_TOLERANCE_OVERRIDES 32
+
+// ToleranceOverride replaces the tolerance of a metric in every baseline
+struct ToleranceOverride
+{
+    // the metric to override
+    char metric[128];
+    // the allowed relative increase
+    double tolerance;
+    // whether a baseline gates the metric
+    bool matched;
+};
+
+// CheckSummary counts the outcome of a comparison
+struct CheckSummary
+{
+    // number of scenarios compared against a baseline
+    int compared;
+    // number of metrics that regressed beyond their tolerance
+    int regressions;
+    // number of baseline scenarios missing from the results
+    int missing;
+    // number of scenarios that failed to run
+    int failed;
+    // number of scenarios without a baseline
+    int unbaselined;
+    // number of scenarios whose baseline lacks some gated metrics
+    int partial;
+};
+
+static struct ToleranceOverride overrides[MAX_TOLERANCE_OVERRIDES];
+static int override_count = 0;
+
+// default_tolerances returns the gated metrics for a benchmark without a baseline file
+static JSON_Value *default_tolerances(const char *benchmark)
+{
+    JSON_Value *value = json_value_init_object();
+    JSON_Object *tolerances = json_value_get_object(value);
+    if (strcmp(benchmark, "loader") == 0)
+    {
+        json_object_set_number(tolerances, "parse_ms", 0.20);
+        json_object_set_number(tolerances, "first_frame_ms", 0.20);
+        json_object_set_number(tolerances, "peak_rss_kb", 0.10);
+        json_object_set_number(tolerances, "allocations", 0.05);
+    }
+    else
+    {
+        json_object_set_number(tolerances, "ns_per_frame", 0.20);
+        json_object_set_number(tolerances, "allocs_per_frame", 0.05);
+        json_object_set_number(tolerances, "estimated_bytes_touched_per_frame", 0.05);
+        json_object_set_number(tolerances, "peak_heap_bytes", 0.10);
+    }
+    return value;
+}
+
+// tolerance_for returns the tolerance of a metric, preferring command line overrides
+static double tolerance_for(JSON_Object *tolerances, const char *metric)
+{
+    for (int i = 0; i < override_count; i++)
+    {
+        if (strcmp(overrides[i].metric, metric) == 0)
+        {
+            return overrides[i].tolerance;
+        }
+    }
+
+    return json_object_get_number(tolerances, metric);
+}
+
+// load_object parses a JSON file and returns its root object
+static JSON_Value *load_object(const char *path, JSON_Object **object)
+{
+    JSON_Value *value = json_parse_file_with_comments(path);
+    if (value == NULL)
+    {
+        fprintf(stderr, "perf-check: failed to parse %s\n", path);
+        return NULL;
+    }
+
+    *object = json_value_get_object(value);
+    if (*object == NULL)
+    {
+        fprintf(stderr, "perf-check: %s is not a JSON object\n", path);
+        json_value_free(value);
+        return NULL;
+    }
+
+    return value;
+}
+
+// compare checks every scenario of a result file against its baseline
+static bool compare(const char *baseline_path, const char *results_path, struct CheckSummary *summary)
+{
+    JSON_Object *baseline;
+    JSON_Value *baseline_value = load_object(baseline_path, &baseline);
+    if (baseline_value == NULL)
+    {
+        return false;
+    }
+
+    JSON_Object *results;
+    JSON_Value *results_value = load_object(results_path, &results);
+    if (results_value == NULL)
+    {
+        json_value_free(baseline_value);
+        return false;
+    }
+
+    const char *benchmark = json_object_get_string(results, "benchmark");
+    if (benchmark == NULL)
+    {
+        benchmark = "unknown";
+    }
+
+    JSON_Object *tolerances = json_object_get_object(baseline, "tolerances");
+    JSON_Value *fallback_tolerances = NULL;
+    if (tolerances == NULL)
+    {
+        fallback_tolerances = default_tolerances(benchmark);
+        tolerances = json_value_get_object(fallback_tolerances);
+    }
+
+    // overrides only apply to metrics a baseline gates
+    for (int i = 0; i < override_count; i++)
+    {
+        if (json_object_has_value_of_type(tolerances, overrides[i].metric, JSONNumber))
+        {
+            overrides[i].matched = true;
+        }
+    }
+
+    JSON_Object *baseline_scenarios = json_object_get_object(baseline, "scenarios");
+    JSON_Array *scenarios = json_object_get_array(results, "scenarios");
+    size_t scenario_count = json_array_get_count(scenarios);
+
+    printf("== %s: %s vs %s\n", benchmark, results_path, baseline_path);
+
+    // baselines are machine specific, so comparing across platforms is only indicative
+    const char *baseline_platform = json_object_get_string(baseline, "platform");
+    const char *results_platform = json_object_get_string(results, "platform");
+    if (baseline_platform != NULL && results_platform != NULL && strcmp(baseline_platform, results_platform) != 0)
+    {
+        printf("NOTE     baseline recorded on %s, results from %s, re-record it with `make perf-baseline`\n", baseline_platform, results_platform);
+    }
+
+    for (size_t i = 0; i < scenario_count; i++)
+    {
+        JSON_Object *scenario = json_array_get_object(scenarios, i);
+        const char *name = json_object_get_string(scenario, "name");
+        if (name == NULL)
+        {
+            continue;
+        }
+
+        if (json_object_has_value(scenario, "ok") && !json_object_get_boolean(scenario, "ok"))
+        {
+            printf("FAIL     %s: scenario did not complete\n", name);
+            summary->failed++;
+            continue;
+        }
+
+        JSON_Object *recorded = baseline_scenarios != NULL ? json_object_get_object(baseline_scenarios, name) : NULL;
+        if (recorded == NULL)
+        {
+            printf("NEW      %s: no baseline recorded\n", name);
+            summary->unbaselined++;
+            continue;
+        }
+
+        summary->compared++;
+        bool regressed = false;
+        char line[2048] = "";
+        char unrecorded[1024] = "";
+        size_t metric_count = json_object_get_count(tolerances);
+        for (size_t m = 0; m < metric_count; m++)
+        {
+            const char *metric = json_object_get_name(tolerances, m);
+            if (!json_object_has_value_of_type(scenario, metric, JSONNumber))
+            {
+                continue;
+            }
+
+            // a metric the baseline predates is reported rather than silently ungated
+            if (!json_object_has_value_of_type(recorded, metric, JSONNumber))
+            {
+                strncat(unrecorded, unrecorded[0] == '\0' ? "" : ", ", sizeof(unrecorded) - strlen(unrecorded) - 1);
+                strncat(unrecorded, metric, sizeof(unrecorded) - strlen(unrecorded) - 1);
+                continue;
+            }
+
+            double before = json_object_get_number(recorded, metric);
+            double after = json_object_get_number(scenario, metric);
+            double tolerance = tolerance_for(tolerances, metric);
+            double change = before != 0 ? (after - before) / before * 100.0 : (after != 0 ? INFINITY : 0.0);
+            bool metric_regressed = after > before * (1.0 + tolerance);
+
+            char part[256];
+            snprintf(part, sizeof(part), "%s%s %.2f -> %.2f (%+.1f%%%s)",
+                     line[0] == '\0' ? "" : ", ",
+                     metric, before, after, change,
+                     metric_regressed ? ", over tolerance" : "");
+            strncat(line, part, sizeof(line) - strlen(line) - 1);
+
+            if (metric_regressed)
+            {
+                regressed = true;
+                summary->regressions++;
+            }
+        }
+
+        printf("%-8s %s: %s\n", regressed ? "REGRESS" : "ok", name, line);
+        if (unrecorded[0] != '\0')
+        {
+            printf("PARTIAL  %s: no baseline for %s\n", name, unrecorded);
+            summary->partial++;
+        }
+    }
+
+    // scenarios that disappeared usually mean the baseline needs to be re-recorded
+    size_t baseline_count = baseline_scenarios != NULL ? json_object_get_count(baseline_scenarios) : 0;
+    for (size_t b = 0; b < baseline_count; b++)
+    {
+        const char *name = json_object_get_name(baseline_scenarios, b);
+        bool found = false;
+        for (size_t i = 0; i < scenario_count && !found; i++)
+        {
+            const char *result_name = json_object_get_string(json_array_get_object(scenarios, i), "name");
+            found = result_name != NULL && strcmp(result_name, name) == 0;
+        }
+
+        if (!found)
+        {
+            printf("MISSING  %s: present in the baseline but not in the results\n", name);
+            summary->missing++;
+        }
+    }
+
+    if (fallback_tolerances != NULL)
+    {
+        json_value_free(fallback_tolerances);
+    }
+    json_value_free(results_value);
+    json_value_free(baseline_value);
+    return true;
+}
+
+// record replaces the scenarios of a baseline with the given results
+// existing tolerances are kept so re-recording never loosens the gate
+static bool record(const char *baseline_path, const char *results_path)
+{
+    JSON_Object *results;
+    JSON_Value *results_value = load_object(results_path, &results);
+    if (results_value == NULL)
+    {
+        return false;
+    }
+
+    const char *benchmark = json_object_get_string(results, "benchmark");
+    if (benchmark == NULL)
+    {
+        benchmark = "unknown";
+    }
+
+    JSON_Value *baseline_value = json_parse_file_with_comments(baseline_path);
+    if (baseline_value == NULL || json_value_get_object(baseline_value) == NULL)
+    {
+        if (baseline_value != NULL)
+        {
+            json_value_free(baseline_value);
+        }
+        baseline_value = json_value_init_object();
+    }
+
+    JSON_Object *baseline = json_value_get_object(baseline_value);
+    json_object_set_string(baseline, "benchmark", benchmark);
+    if (json_object_get_string(results, "platform") != NULL)
+    {
+        json_object_set_string(baseline, "platform", json_object_get_string(results, "platform"));
+    }
+    if (json_object_get_object(baseline, "tolerances") == NULL)
+    {
+        json_object_set_value(baseline, "tolerances", default_tolerances(benchmark));
+    }
+
+    JSON_Value *scenarios_value = json_value_init_object();
+    JSON_Object *recorded = json_value_get_object(scenarios_value);
+    JSON_Array *scenarios = json_object_get_array(results, "scenarios");
+    for (size_t i = 0; i < json_array_get_count(scenarios); i++)
+    {
+        JSON_Object *scenario = json_array_get_object(scenarios, i);
+        const char *name = json_object_get_string(scenario, "name");
+        if (name == NULL || (json_object_has_value(scenario, "ok") && !json_object_get_boolean(scenario, "ok")))
+        {
+            continue;
+        }
+
+        JSON_Value *metrics_value = json_value_init_object();
+        JSON_Object *metrics = json_value_get_object(metrics_value);
+        for (size_t m = 0; m < json_object_get_count(scenario); m++)
+        {
+            const char *metric = json_object_get_name(scenario, m);
+            if (json_object_has_value_of_type(scenario, metric, JSONNumber))
+            {
+                json_object_set_number(metrics, metric, json_object_get_number(scenario, metric));
+            }
+        }
+        json_object_set_value(recorded, name, metrics_value);
+    }
+    json_object_set_value(baseline, "scenarios", scenarios_value);
+
+    bool ok = json_serialize_to_file_pretty(baseline_value, baseline_path) == JSONSuccess;
+    if (ok)
+    {
+        printf("recorded %zu scenarios into %s\n", json_object_get_count(recorded), baseline_path);
+    }
+    else
+    {
+        fprintf(stderr, "perf-check: failed to write %s\n", baseline_path);
+    }
+
+    json_value_free(baseline_value);
+    json_value_free(results_value);
+    return ok;
+}
+
+int main(int argc, char *argv[])
+{
+    static struct option long_options[] = {
+        {"tolerance", required_argument, 0, 't'},
+        {"record", no_argument, 0, 'r'},
+        {"allow-unbaselined", no_argument, 0, 'u'},
+        {0, 0, 0, 0}};
+
+    bool recording = false;
+    bool allow_unbaselined = false;
+    int opt;
+    while ((opt = getopt_long(argc, argv, "t:ru", long_options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 't':
+        {
+            char *separator = strchr(optarg, '=');
+            if (separator == NULL || override_count >= MAX_TOLERANCE_OVERRIDES)
+            {
+                fprintf(stderr, "perf-check: invalid tolerance %s (expected <metric>=<fraction>)\n", optarg);
+                return 1;
+            }
+
+            size_t length = separator - optarg;
+            if (length >= sizeof(overrides[override_count].metric))
+            {
+                length = sizeof(overrides[override_count].metric) - 1;
+            }
+            memcpy(overrides[override_count].metric, optarg, length);
+            overrides[override_count].metric[length] = '\0';
+            overrides[override_count].tolerance = atof(separator + 1);
+            override_count++;
+            break;
+        }
+        case 'r':
+            recording = true;
+            break;
+        case 'u':
+            allow_unbaselined = true;
+            break;
+        default:
+            return 1;
+        }
+    }
+
+    int remaining = argc - optind;
+    if (remaining < 2 || remaining % 2 != 0)
+    {
+        fprintf(stderr, "usage: perf-check [--record] [--allow-unbaselined] [--tolerance <metric>=<fraction>]... <baseline> <results> [<baseline> <results>]...\n");
+        return 1;
+    }
+
+    if (recording)
+    {
+        bool ok = true;
+        for (int i = optind; i < argc; i += 2)
+        {
+            ok = record(argv[i], argv[i + 1]) && ok;
+        }
+        return ok ? 0 : 1;
+    }
+
+    struct CheckSummary summary = {0};
+    for (int i = optind; i < argc; i += 2)
+    {
+        if (!compare(argv[i], argv[i + 1], &summary))
+        {
+            return 1;
+        }
+    }
+
+    printf("\n%d scenarios compared, %d regressions, %d missing, %d failed, %d without baseline, %d partially baselined\n",
+           summary.compared, summary.regressions, summary.missing, summary.failed, summary.unbaselined, summary.partial);
+
+    // an override no baseline gates is most likely a typo and would silently do nothing
+    bool unknown_override = false;
+    for (int i = 0; i < override_count; i++)
+    {
+        if (!overrides[i].matched)
+        {
+            fprintf(stderr, "perf-check: --tolerance %s does not match a gated metric of any baseline\n", overrides[i].metric);
+            unknown_override = true;
+        }
+    }
+
+    // nothing compared means nothing was gated, which is a failure unless asked for
+    bool empty = summary.compared == 0 && !allow_unbaselined;
+    if (empty)
+    {
+        printf("no scenario was compared against a baseline, run `make perf-baseline` on the reference machine or pass --allow-unbaselined\n");
+    }
+
+    return summary.regressions == 0 && summary.missing == 0 && summary.failed == 0 && !empty && !unknown_override ? 0 : 1;
+}
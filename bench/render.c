@@ -0,0 +1,472 @@
+// render.c benchmarks the rendering pipeline (draw_screen, scale_surface,
+// hex_to_sdl_color and layout_message) against a synthetic corpus and
+// reports the per-scenario cost as JSON
+//
+// usage: render-bench [--output <path>] [--filter <substring>]
+//                     [--min-iterations <n>] [--min-time-ms <ms>]
+//                     [--corpus-dir <path>]
+#include <sys/stat.h>
+#include <time.h>
+
+#define main minui_presenter_main
+#include "../minui-presenter.c"
+#undef main
+
+#include "alloc.h"
+
+// BenchImage describes a generated background image
+struct BenchImage
+{
+    // the name used in scenario names
+    const char *name;
+    // the format to encode the image as (png or jpg)
+    const char *format;
+    // the dimensions of the image
+    int width;
+    int height;
+    // the path the image was written to
+    char path[1024];
+};
+
+// BenchText describes a message used in scenarios
+struct BenchText
+{
+    // the name used in scenario names
+    const char *name;
+    // the message itself
+    const char *text;
+};
+
+// BenchOptions holds the command line options of the harness
+struct BenchOptions
+{
+    // where to write the results (stdout when empty)
+    char output[1024];
+    // only scenarios containing this substring are run
+    char filter[256];
+    // the minimum number of timed iterations per scenario
+    int min_iterations;
+    // the minimum wall time spent per scenario
+    int min_time_ms;
+    // where the synthetic corpus is written
+    char corpus_dir[1024];
+};
+
+// BenchScenario holds everything needed to run a single scenario
+struct BenchScenario
+{
+    // the unique name of the scenario
+    char name[256];
+    // runs a single frame (or operation) of the scenario
+    void (*run)(struct BenchScenario *scenario);
+    // estimate of the memory a frame touches outside of heap allocations, from
+    // the sizes of the framebuffers and inputs it reads and writes
+    size_t base_bytes;
+    // the app state used by draw scenarios
+    struct AppState *state;
+    // the surface used by scale_surface scenarios
+    SDL_Surface *source;
+    // the target dimensions used by scale_surface scenarios
+    int width;
+    int height;
+    // the input used by hex_to_sdl_color and layout_message scenarios
+    const char *text;
+};
+
+static const struct BenchText bench_texts[] = {
+    {"short", "Hello"},
+    {"long", "The quick brown fox jumps over the lazy dog while the presenter wraps this sentence across several lines of text, "
+             "measuring every word with the large font and rendering each line to its own surface before blitting it onto the screen"},
+};
+
+static struct BenchImage bench_images[] = {
+    {"png-small", "png", 160, 120, ""},
+    {"png-native", "png", FIXED_WIDTH, FIXED_HEIGHT, ""},
+    {"png-huge", "png", 4000, 3000, ""},
+    {"jpg-small", "jpg", 160, 120, ""},
+    {"jpg-huge", "jpg", 4000, 3000, ""},
+};
+
+static const char *bench_alignment_names[] = {"top", "middle", "bottom"};
+static const enum MessageAlignment bench_alignments[] = {MessageAlignmentTop, MessageAlignmentMiddle, MessageAlignmentBottom};
+
+// now_ns returns a monotonic timestamp in nanoseconds
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// generate_image writes a noisy gradient so encoders can't trivially compress it
+static bool generate_image(struct BenchImage *image, const char *dir)
+{
+    snprintf(image->path, sizeof(image->path), "%s/%s.%s", dir, image->name, image->format);
+
+    SDL_Surface *surface = SDL_CreateRGBSurface(0, image->width, image->height, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0);
+    if (surface == NULL)
+    {
+        return false;
+    }
+
+    uint32_t seed = 2463534242u;
+    for (int y = 0; y < image->height; y++)
+    {
+        uint32_t *row = (uint32_t *)((uint8_t *)surface->pixels + y * surface->pitch);
+        for (int x = 0; x < image->width; x++)
+        {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            uint8_t r = (x * 255) / image->width;
+            uint8_t g = (y * 255) / image->height;
+            uint8_t b = seed & 0x3F;
+            row[x] = (r << 16) | (g << 8) | b;
+        }
+    }
+
+    int result;
+    if (strcmp(image->format, "jpg") == 0)
+    {
+        result = IMG_SaveJPG(surface, image->path, 90);
+    }
+    else
+    {
+        result = IMG_SavePNG(surface, image->path);
+    }
+    SDL_FreeSurface(surface);
+
+    return result == 0;
+}
+
+static void run_draw(struct BenchScenario *scenario)
+{
+    GFX_clear(screen);
+    draw_screen(screen, scenario->state);
+}
+
+static void run_scale_surface(struct BenchScenario *scenario)
+{
+    SDL_Surface *scaled = scale_surface(scenario->source, scenario->width, scenario->height);
+    SDL_FreeSurface(scaled);
+}
+
+static void run_hex_to_sdl_color(struct BenchScenario *scenario)
+{
+    volatile SDL_Color color = hex_to_sdl_color(scenario->text);
+    (void)color;
+}
+
+static void run_layout_message(struct BenchScenario *scenario)
+{
+    struct Message messages[MAIN_ROW_COUNT];
+    int line_height = 0;
+    layout_message(scenario->state->fonts.large, scenario->text, messages, &line_height);
+}
+
+// run_scenario times a scenario and appends its result to the output
+static void run_scenario(struct BenchScenario *scenario, struct BenchOptions *options, FILE *out, bool *first)
+{
+    if (options->filter[0] != '\0' && strstr(scenario->name, options->filter) == NULL)
+    {
+        return;
+    }
+
+    // warm up caches and any lazily initialized state
+    for (int i = 0; i < 2; i++)
+    {
+        scenario->run(scenario);
+    }
+
+    uint64_t min_time_ns = (uint64_t)options->min_time_ms * 1000000ull;
+    size_t iterations = 0;
+    alloc_counter_reset();
+    uint64_t start = now_ns();
+    uint64_t elapsed = 0;
+    while (iterations < (size_t)options->min_iterations || elapsed < min_time_ns)
+    {
+        scenario->run(scenario);
+        iterations++;
+        elapsed = now_ns() - start;
+    }
+    struct AllocStats stats = alloc_counter_read();
+
+    double allocs_per_frame = (double)stats.allocations / iterations;
+    double alloc_bytes_per_frame = (double)stats.bytes / iterations;
+
+    fprintf(out, "%s    {\"name\": \"%s\", \"iterations\": %zu, \"ns_per_frame\": %.1f, \"allocs_per_frame\": %.2f, \"alloc_bytes_per_frame\": %.1f, \"estimated_bytes_touched_per_frame\": %.1f, \"peak_heap_bytes\": %zu}",
+            *first ? "" : ",\n",
+            scenario->name,
+            iterations,
+            (double)elapsed / iterations,
+            allocs_per_frame,
+            alloc_bytes_per_frame,
+            alloc_bytes_per_frame + scenario->base_bytes,
+            stats.peak_bytes);
+    fflush(out);
+    *first = false;
+}
+
+static bool parse_bench_arguments(struct BenchOptions *options, int argc, char *argv[])
+{
+    static struct option long_options[] = {
+        {"output", required_argument, 0, 'o'},
+        {"filter", required_argument, 0, 'f'},
+        {"min-iterations", required_argument, 0, 'n'},
+        {"min-time-ms", required_argument, 0, 't'},
+        {"corpus-dir", required_argument, 0, 'c'},
+        {0, 0, 0, 0}};
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "o:f:n:t:c:", long_options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'o':
+            strncpy(options->output, optarg, sizeof(options->output) - 1);
+            break;
+        case 'f':
+            strncpy(options->filter, optarg, sizeof(options->filter) - 1);
+            break;
+        case 'n':
+            options->min_iterations = atoi(optarg);
+            break;
+        case 't':
+            options->min_time_ms = atoi(optarg);
+            break;
+        case 'c':
+            strncpy(options->corpus_dir, optarg, sizeof(options->corpus_dir) - 1);
+            break;
+        default:
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    struct BenchOptions options = {
+        .output = "",
+        .filter = "",
+        .min_iterations = 5,
+        .min_time_ms = 200,
+        .corpus_dir = "",
+    };
+    if (!parse_bench_arguments(&options, argc, argv))
+    {
+        return ExitCodeError;
+    }
+
+    if (options.corpus_dir[0] == '\0')
+    {
+        strncpy(options.corpus_dir, "/tmp/minui-presenter-bench-XXXXXX", sizeof(options.corpus_dir) - 1);
+        if (mkdtemp(options.corpus_dir) == NULL)
+        {
+            log_error("Failed to create corpus directory");
+            return ExitCodeError;
+        }
+    }
+    else
+    {
+        mkdir(options.corpus_dir, 0755);
+    }
+
+    // render without a display unless the caller picked a driver
+    setenv("SDL_VIDEODRIVER", "dummy", 0);
+    setenv("SDL_AUDIODRIVER", "dummy", 0);
+    swallow_stdout_from_function(init);
+
+    struct AppState state = {
+        .redraw = 1,
+        .exit_code = ExitCodeSuccess,
+        .fonts = {
+            .size = FONT_LARGE,
+            .font_path = strdup(FONT_PATH),
+        },
+        .confirm_show = true,
+        .cancel_show = true,
+    };
+    strncpy(state.confirm_button, "A", sizeof(state.confirm_button));
+    strncpy(state.confirm_text, "SELECT", sizeof(state.confirm_text));
+    strncpy(state.cancel_button, "B", sizeof(state.cancel_button));
+    strncpy(state.cancel_text, "BACK", sizeof(state.cancel_text));
+    if (!open_fonts(&state))
+    {
+        return ExitCodeError;
+    }
+
+    size_t image_count = sizeof(bench_images) / sizeof(bench_images[0]);
+    for (size_t i = 0; i < image_count; i++)
+    {
+        if (!generate_image(&bench_images[i], options.corpus_dir))
+        {
+            char buff[1024];
+            snprintf(buff, sizeof(buff), "Failed to generate %s: %s", bench_images[i].path, IMG_GetError());
+            log_error(buff);
+            return ExitCodeError;
+        }
+    }
+
+    FILE *out = stdout;
+    if (options.output[0] != '\0')
+    {
+        out = fopen(options.output, "w");
+        if (out == NULL)
+        {
+            log_error("Failed to open output file");
+            return ExitCodeError;
+        }
+    }
+
+    size_t framebuffer_bytes = (size_t)screen->pitch * screen->h;
+    fprintf(out, "{\n  \"benchmark\": \"render\",\n  \"platform\": \"%s\",\n  \"width\": %d,\n  \"height\": %d,\n  \"allocations_counted\": %s,\n  \"scenarios\": [\n",
+            PLATFORM, screen->w, screen->h, alloc_counter_supported() ? "true" : "false");
+
+    bool first = true;
+    struct Item item = {0};
+    struct ItemsState items_state = {
+        .items = &item,
+        .item_count = 1,
+        .selected = 0,
+    };
+    state.items_state = &items_state;
+
+    // full frames: every text, image, pill and alignment combination
+    size_t text_count = sizeof(bench_texts) / sizeof(bench_texts[0]);
+    for (size_t t = 0; t < text_count; t++)
+    {
+        for (size_t i = 0; i <= image_count; i++)
+        {
+            for (int pill = 0; pill <= 1; pill++)
+            {
+                for (int a = 0; a < 3; a++)
+                {
+                    struct BenchScenario scenario = {
+                        .run = run_draw,
+                        .base_bytes = framebuffer_bytes * 2,
+                        .state = &state,
+                    };
+                    const char *image_name = i == 0 ? "none" : bench_images[i - 1].name;
+                    snprintf(scenario.name, sizeof(scenario.name), "draw/%s/%s/%s/%s", bench_texts[t].name, image_name, pill ? "pill" : "no-pill", bench_alignment_names[a]);
+
+                    item.text = (char *)bench_texts[t].text;
+                    item.background_color = "#336699";
+                    item.background_image = i == 0 ? NULL : bench_images[i - 1].path;
+                    item.image_exists = i != 0;
+                    item.show_pill = pill;
+                    item.alignment = bench_alignments[a];
+
+                    run_scenario(&scenario, &options, out, &first);
+                }
+            }
+        }
+    }
+
+    // full frames with every image served from an asset pack in each format
+    const char *pack_format_names[] = {"encoded", "raw", "raw-deflate"};
+    const enum PackFormat pack_formats[] = {PackFormatEncoded, PackFormatRaw, PackFormatRawDeflate};
+    for (size_t f = 0; f < sizeof(pack_formats) / sizeof(pack_formats[0]); f++)
+    {
+        char pack_path[1024];
+        snprintf(pack_path, sizeof(pack_path), "%s/%s.pack", options.corpus_dir, pack_format_names[f]);
+
+        char *pack_inputs[sizeof(bench_images) / sizeof(bench_images[0])];
+        for (size_t i = 0; i < image_count; i++)
+        {
+            pack_inputs[i] = bench_images[i].path;
+        }
+
+        if (!write_asset_pack(pack_path, pack_inputs, image_count, pack_formats[f]) || !AssetPack_Open(&asset_pack, pack_path))
+        {
+            log_error("Failed to build asset pack");
+            return ExitCodeError;
+        }
+
+        for (size_t i = 0; i < image_count; i++)
+        {
+            struct BenchScenario scenario = {
+                .run = run_draw,
+                .base_bytes = framebuffer_bytes * 2,
+                .state = &state,
+            };
+            snprintf(scenario.name, sizeof(scenario.name), "draw-pack/%s/%s", pack_format_names[f], bench_images[i].name);
+
+            char image_uri[1100];
+            snprintf(image_uri, sizeof(image_uri), "%s%s", PACK_URI_PREFIX, pack_inputs[i]);
+            item.text = (char *)bench_texts[0].text;
+            item.background_color = "#336699";
+            item.background_image = image_uri;
+            item.image_exists = true;
+            item.show_pill = true;
+            item.alignment = MessageAlignmentMiddle;
+
+            run_scenario(&scenario, &options, out, &first);
+        }
+
+        AssetPack_Close(&asset_pack);
+        unlink(pack_path);
+    }
+
+    // the building blocks of a frame in isolation
+    const char *colors[] = {"#336699", "A0B1C2", "not-a-color"};
+    for (size_t c = 0; c < sizeof(colors) / sizeof(colors[0]); c++)
+    {
+        struct BenchScenario scenario = {
+            .run = run_hex_to_sdl_color,
+            .base_bytes = strlen(colors[c]),
+            .text = colors[c],
+        };
+        snprintf(scenario.name, sizeof(scenario.name), "hex_to_sdl_color/%s", colors[c]);
+        run_scenario(&scenario, &options, out, &first);
+    }
+
+    for (size_t t = 0; t < text_count; t++)
+    {
+        struct BenchScenario scenario = {
+            .run = run_layout_message,
+            .base_bytes = strlen(bench_texts[t].text),
+            .state = &state,
+            .text = bench_texts[t].text,
+        };
+        snprintf(scenario.name, sizeof(scenario.name), "layout_message/%s", bench_texts[t].name);
+        run_scenario(&scenario, &options, out, &first);
+    }
+
+    for (size_t i = 0; i < image_count; i++)
+    {
+        SDL_Surface *source = IMG_Load(bench_images[i].path);
+        if (source == NULL)
+        {
+            continue;
+        }
+
+        struct BenchScenario scenario = {
+            .run = run_scale_surface,
+            .source = source,
+            .width = FIXED_WIDTH - 2 * PADDING,
+            .height = FIXED_HEIGHT - 2 * PADDING,
+        };
+        scenario.base_bytes = (size_t)source->pitch * source->h + (size_t)scenario.width * scenario.height * source->format->BytesPerPixel;
+        snprintf(scenario.name, sizeof(scenario.name), "scale_surface/%s", bench_images[i].name);
+        run_scenario(&scenario, &options, out, &first);
+        SDL_FreeSurface(source);
+    }
+
+    fprintf(out, "\n  ]\n}\n");
+    fflush(out);
+    if (out != stdout)
+    {
+        fclose(out);
+    }
+
+    for (size_t i = 0; i < image_count; i++)
+    {
+        unlink(bench_images[i].path);
+    }
+    rmdir(options.corpus_dir);
+
+    swallow_stdout_from_function(destruct);
+    return ExitCodeSuccess;
+}
@@ -1,14 +1,35 @@
+#include <dirent.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <fnmatch.h>
 #include <getopt.h>
+#include <limits.h>
 #include <msettings.h>
 #include <parson/parson.h>
+#include <poll.h>
 #include <pthread.h>
 #include <signal.h>
 #include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/wait.h>
+#include <sys/un.h>
+#include <time.h>
 #include <unistd.h>
+#include <zlib.h>
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #ifdef USE_SDL2
 #include <SDL2/SDL_ttf.h>
 #include <SDL2/SDL_image.h>
@@ -35,9 +56,6 @@ bool use_sdl2 = true;
 bool use_sdl2 = false;
 #endif
 
-pthread_mutex_t increment_item_list_index_lock = PTHREAD_MUTEX_INITIALIZER;
-volatile sig_atomic_t increment_item_list_index = 0;
-
 enum list_result_t
 {
     ExitCodeSuccess = 0,
@@ -56,11 +74,29 @@ enum list_result_t
 typedef int ExitCode;
 
 // log_error logs a message to stderr for debugging purposes
+// the real stderr while suppress_output points it at /dev/null (-1 otherwise),
+// so errors logged by other threads in the meantime are still seen
+int suppressed_stderr_fd = -1;
+pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// serializes the MinUI calls that draw its shared assets or draw text with
+// its shared fonts, and opening and closing fonts, which share the FreeType library
+pthread_mutex_t gfx_lock = PTHREAD_MUTEX_INITIALIZER;
+
 void log_error(const char *msg)
 {
-    // Set stderr to unbuffered mode
-    setvbuf(stderr, NULL, _IONBF, 0);
-    fprintf(stderr, "%s\n", msg);
+    pthread_mutex_lock(&log_lock);
+    if (suppressed_stderr_fd != -1)
+    {
+        dprintf(suppressed_stderr_fd, "%s\n", msg);
+    }
+    else
+    {
+        // Set stderr to unbuffered mode
+        setvbuf(stderr, NULL, _IONBF, 0);
+        fprintf(stderr, "%s\n", msg);
+    }
+    pthread_mutex_unlock(&log_lock);
 }
 
 // log_info logs a message to stdout for debugging purposes
@@ -94,10 +130,45 @@ enum MessageAlignment
     MessageAlignmentBottom,
 };
 
+// TransitionKind is how the change to an item is animated
+enum TransitionKind
+{
+    // the item doesn't set one, --transition applies
+    TransitionKindDefault,
+    // the item replaces the previous one at once
+    TransitionKindNone,
+    // the item fades in over the previous one
+    TransitionKindFade,
+    // the item pushes the previous one out of the screen
+    TransitionKindSlide,
+};
+
+// PackFormat is how an image is stored in an asset pack
+enum PackFormat
+{
+    // the original image file (PNG, JPG, ...)
+    PackFormatEncoded,
+    // ARGB8888 pixels scaled for the screen the pack was built for
+    PackFormatRaw,
+    // like PackFormatRaw, compressed with zlib
+    PackFormatRawDeflate,
+};
+
+// RenderFormat is how --render-all writes the items it draws
+enum RenderFormat
+{
+    // PNG images
+    RenderFormatPNG,
+    // the frame format of --handoff, the screen pixels behind a HandoffHeader
+    RenderFormatRaw,
+};
+
 struct Item
 {
     // the background color to use for the list
     char *background_color;
+    // the background color as 0xRRGGBB, used when background_color is NULL
+    uint32_t background_rgb;
     // path to the background image to use for the list
     char *background_image;
     // whether the background image exists
@@ -108,6 +179,117 @@ struct Item
     bool show_pill;
     // the alignment of the text
     enum MessageAlignment alignment;
+    // path to the progress segment a progress bar is drawn for (NULL for none)
+    char *progress;
+    // identifies the item when --watch reloads the file (NULL for none)
+    char *id;
+    // how the change to the item is animated
+    enum TransitionKind transition;
+    // how long the item is shown for before changing to the next one, in
+    // milliseconds. 0 keeps it on screen, -1 applies --slide-duration
+    int duration;
+};
+
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+// ArenaBlock is a single chunk of arena memory
+struct ArenaBlock
+{
+    // the next block in the arena
+    struct ArenaBlock *next;
+    // number of bytes handed out from this block
+    size_t used;
+    // number of bytes available in this block
+    size_t size;
+    // the memory itself
+    char data[];
+};
+
+// Arena is a bump allocator whose memory is released all at once
+struct Arena
+{
+    // the block allocations are currently served from
+    struct ArenaBlock *head;
+};
+
+// InternedString is a single entry of an InternTable
+struct InternedString
+{
+    // the arena copy of the string, NULL for empty slots
+    const char *string;
+    // the hash of the string
+    uint32_t hash;
+    // the length of the string
+    uint32_t length;
+    // caller defined value attached to the string, 0 until set
+    uint32_t data;
+};
+
+// InternTable deduplicates strings so every distinct value is stored once
+struct InternTable
+{
+    // open addressed slots, capacity is always a power of two
+    struct InternedString *entries;
+    // number of slots
+    size_t capacity;
+    // number of used slots
+    size_t count;
+};
+
+// number of items parsed around the selected item when lazily loading
+#define ITEM_WINDOW_SIZE 64
+// every how many items a stream offset is kept when lazily loading
+#define ITEM_INDEX_STRIDE 16
+
+#define DECK_MAGIC "MPDECK\r\n"
+#define DECK_VERSION 3
+// written as a number so a deck compiled on a machine of another byte order is rejected
+#define DECK_BYTE_ORDER 0x01020304
+// string pool offset of the empty string, also used for "no string"
+#define DECK_NO_STRING 0
+
+// DeckHeader starts every compiled deck file
+struct DeckHeader
+{
+    // always DECK_MAGIC
+    char magic[8];
+    // the version of the format, always DECK_VERSION
+    uint32_t version;
+    // always DECK_BYTE_ORDER
+    uint32_t byte_order;
+    // number of entries in the item table
+    uint32_t item_count;
+    // the initially selected item
+    uint32_t selected;
+    // file offset of the item table
+    uint64_t items_offset;
+    // file offset of the string pool
+    uint64_t strings_offset;
+    // size of the string pool in bytes
+    uint64_t strings_size;
+};
+
+// DeckItem is a single entry of the item table of a compiled deck
+struct DeckItem
+{
+    // string pool offset of the text
+    uint32_t text;
+    // string pool offset of the background image (DECK_NO_STRING for none)
+    uint32_t background_image;
+    // string pool offset of the progress segment (DECK_NO_STRING for none)
+    uint32_t progress;
+    // the background color as 0xRRGGBB
+    uint32_t background_rgb;
+    // whether to show a pill around the text
+    uint8_t show_pill;
+    // the MessageAlignment of the text
+    uint8_t alignment;
+    // the TransitionKind of the item, TransitionKindDefault in decks compiled before transitions
+    uint8_t transition;
+    // unused, keeps entries 4 byte aligned
+    uint8_t reserved;
+    // how long the item is shown for in milliseconds, -1 for --slide-duration
+    int32_t duration;
 };
 
 // ItemsState holds the state of the list
@@ -119,6 +301,155 @@ struct ItemsState
     size_t item_count;
     // index of currently selected item
     int selected;
+    // index of the item held in items[0]
+    size_t window_start;
+    // number of items held in items
+    size_t window_count;
+    // owns the text of every item
+    struct Arena arena;
+    // deduplicated image paths and colors, stored in the arena
+    struct InternTable strings;
+
+    // whether items may set a transition of their own
+    bool transitions;
+    // whether items may set a duration of their own
+    bool durations;
+
+    // whether items are parsed on demand instead of up front
+    bool lazy;
+    // the seekable copy of the document items are parsed from when lazy
+    FILE *source;
+    // stream offsets of every ITEM_INDEX_STRIDE-th item when lazy
+    uint64_t *offsets;
+    // the values applied to items that do not set them when lazy
+    struct Item defaults;
+    // owns the strings of the items currently held in items when lazy
+    struct Arena window_arena;
+    // deduplicated strings of the items currently held in items when lazy
+    struct InternTable window_strings;
+
+    // the mapped compiled deck items are read from (NULL when not a deck)
+    void *deck;
+    // size of the mapping
+    size_t deck_size;
+    // the item table of the deck
+    const struct DeckItem *deck_items;
+    // the string pool of the deck
+    const char *deck_strings;
+    // size of the string pool
+    size_t deck_strings_size;
+};
+
+// the height of the progress bar, before scaling
+#define PROGRESS_BAR_HEIGHT 8
+// every how many frames a missing progress segment is looked for again
+#define PROGRESS_RETRY_FRAMES 30
+// how often a read that raced the producer is retried before giving up for the frame
+#define PROGRESS_READ_ATTEMPTS 4
+
+// ProgressSegment is the shared memory a producer writes progress into
+// every write makes sequence odd, stores the values and makes it even
+// again, so a reader can tell when it read half of an update
+struct ProgressSegment
+{
+    // odd while the producer is writing
+    _Atomic uint32_t sequence;
+    // unused, always 0
+    uint32_t reserved;
+    // the progress made so far
+    _Atomic uint32_t value;
+    // the value at completion, 0 while unknown
+    _Atomic uint32_t total;
+};
+
+// ProgressBar follows the progress segment of the selected item
+struct ProgressBar
+{
+    // path to the segment, "" when the selected item has no progress bar
+    char path[1024];
+    // the mapped segment, NULL until the producer created it
+    struct ProgressSegment *segment;
+    // frames left before opening a missing segment is tried again
+    int retry_frames;
+    // the progress last read from the segment
+    uint32_t value;
+    // the total last read from the segment
+    uint32_t total;
+    // where draw_screen placed the bar
+    SDL_Rect rect;
+    // a copy of the screen under the bar, NULL until the bar is drawn
+    SDL_Surface *under;
+    // the width of the filled part of the bar on screen
+    int filled;
+    // whether the last full redraw was drawn twice
+    bool repeated;
+};
+
+// the most frames --render-ahead keeps, whatever its budget allows
+#define RENDER_AHEAD_MAX_FRAMES 8
+
+// CachedFrame is an item drawn ahead of time, without its progress bar
+struct CachedFrame
+{
+    // the drawn item, NULL until the slot is first used
+    SDL_Surface *surface;
+    // index of the drawn item, -1 for free slots
+    long item;
+    // where the progress bar of the item goes
+    SDL_Rect bar_rect;
+    // whether the background image of the item was drawn
+    bool image_drawn;
+};
+
+// FrameCache holds the items next to the selected one fully drawn, so
+// navigating to them is a single blit (--render-ahead)
+struct FrameCache
+{
+    // number of slots the memory budget allows, 0 when disabled
+    int capacity;
+    // the drawn items
+    struct CachedFrame frames[RENDER_AHEAD_MAX_FRAMES];
+    // the selection the items were last drawn around (-1 for none)
+    long selected;
+    // the direction of the last single step, items ahead of it are drawn first
+    int direction;
+    // counts the changes to the items, so copies of the cache know to drop their drawings
+    unsigned long generation;
+};
+
+// Slideshow changes to the next item on its own once the selected one was
+// shown for its duration (--slide-duration). every item is due at a deadline
+// on the monotonic clock, and the change is made on the frame whose flip
+// lands closest to it
+struct Slideshow
+{
+    // the item the deadline is for, -1 until the first frame
+    long item;
+    // when the item is due to change in nanoseconds, 0 while it stays
+    uint64_t deadline;
+    // whether SELECT paused the slideshow
+    bool paused;
+    // how much of the time of the item was left when paused, 0 when it stays
+    uint64_t remaining;
+    // whether the change to the next item was queued for the deadline
+    bool advancing;
+    // when the last change was queued, in nanoseconds
+    uint64_t queued;
+    // the deadline of the change waiting to be flipped onto the screen, 0 for none
+    uint64_t landing;
+    // the average time from queueing a change to flipping it onto the screen,
+    // in nanoseconds. a frame drawn on the render thread shows up a frame later
+    uint64_t latency;
+    // when the current frame started, in nanoseconds
+    uint64_t frame_start;
+    // the average time between frames, in nanoseconds
+    uint64_t frame_time;
+    // number of changes made for a deadline
+    unsigned long advances;
+    // number of those changes that reached the screen a frame or more late
+    unsigned long missed;
+    // the most one of the missed changes was late by, in nanoseconds
+    uint64_t worst;
 };
 
 // AppState holds the current state of the application
@@ -162,6 +493,44 @@ struct AppState
     char inaction_text[1024];
     // the path to the JSON file
     char file[1024];
+    // the directory whose images are displayed instead of a file, empty for none
+    char directory[1024];
+    // comma separated patterns the images of the directory have to match, empty for the default
+    char directory_filter[1024];
+    // whether the images in subdirectories of the directory are displayed too
+    bool recursive;
+    // whether to parse items on demand instead of up front
+    bool lazy_load;
+    // whether to apply commands read from stdin while displaying
+    bool follow;
+    // applies the commands read from stdin, NULL unless following
+    struct Follower *follower;
+    // whether to reload the items when the file changes
+    bool watch;
+    // whether to display the selected item before the rest of the file is parsed
+    bool progressive_load;
+    // the file the last frame is handed to the next process through, empty for none
+    char handoff[1024];
+    // parses the items while they are displayed, NULL unless progressively loading
+    struct ItemsProgress *items_progress;
+    // where to write a compiled deck of the items instead of displaying them
+    char compile_output[1024];
+    // the asset pack pack:// images are loaded from
+    char asset_pack[1024];
+    // where to write an asset pack instead of displaying anything
+    char pack_output[1024];
+    // how images are stored in the asset pack being written
+    enum PackFormat pack_format;
+    // where to write an image of every item instead of displaying them
+    char render_output[1024];
+    // how the images of --render-all are written
+    enum RenderFormat render_format;
+    // number of threads --render-all draws on, 0 for one per core
+    int render_workers;
+    // the images to write into the asset pack
+    char **pack_inputs;
+    // number of images to write into the asset pack
+    int pack_input_count;
     // quit after last item
     bool quit_after_last_item;
     // whether to show the hardware group
@@ -180,6 +549,51 @@ struct AppState
     struct Fonts fonts;
     // the display states
     struct ItemsState *items_state;
+    // the item with an image exists check in flight (-1 for none)
+    int probe_item;
+    // the selection images were last read ahead for (-1 for none)
+    int readahead_item;
+    // the server the display was requested through, NULL when run directly
+    struct PresenterServer *server;
+    // the message to display, empty when displaying --file
+    char message[1024];
+    // the alignment of the text, unless items set their own
+    enum MessageAlignment alignment;
+    // the progress segment drawn for --message
+    char progress[1024];
+    // the progress bar of the selected item
+    struct ProgressBar progress_bar;
+    // the background image decoded while starting up, for the first frame (NULL for none)
+    SDL_Surface *preloaded_image;
+    // the path preloaded_image was decoded from
+    char *preloaded_path;
+    // whether preloaded_image already has its on-screen size
+    bool preloaded_prescaled;
+    // megabytes of memory items may be drawn ahead of time into, 0 to disable
+    int render_ahead;
+    // whether frames are drawn on a thread of their own, away from input
+    bool render_thread;
+    // how changes between items are animated, unless items set their own
+    enum TransitionKind transition;
+    // how long a transition between items takes, in milliseconds
+    int transition_ms;
+    // how long items are shown for before changing to the next one, in milliseconds, 0 to keep them
+    int slide_duration_ms;
+    // changes between the items on their own when they have a duration
+    struct Slideshow slideshow;
+    // the number of columns and rows of the grid view, 0 when there is none
+    int grid_columns;
+    int grid_rows;
+    // whether the grid view is shown instead of the selected item
+    bool grid_shown;
+    // the first row of items the grid view shows
+    long grid_top;
+    // where the thumbnails of the grid view are kept between runs, empty to keep them in memory only
+    char thumbnail_cache[1024];
+    // makes the thumbnails of the grid view, NULL when there is none
+    struct ThumbnailPool *thumbnails;
+    // the items drawn ahead of time
+    struct FrameCache frame_cache;
 };
 
 struct Message
@@ -212,1387 +626,9803 @@ void strtrim(char *s)
     memmove(s, p, l + 1);
 }
 
-char *read_stdin()
+// Arena_Alloc returns size bytes of pointer-aligned memory owned by the arena
+void *Arena_Alloc(struct Arena *arena, size_t size)
 {
-    // Read all of stdin into a string
-    char *stdin_contents = NULL;
-    size_t stdin_size = 0;
-    size_t stdin_used = 0;
-    char buffer[4096];
-    size_t bytes_read;
+    size = (size + sizeof(void *) - 1) & ~(sizeof(void *) - 1);
 
-    while ((bytes_read = fread(buffer, 1, sizeof(buffer), stdin)) > 0)
+    struct ArenaBlock *block = arena->head;
+    if (block != NULL && block->size - block->used >= size)
     {
-        if (stdin_contents == NULL)
-        {
-            stdin_size = bytes_read * 2;
-            stdin_contents = malloc(stdin_size);
-        }
-        else if (stdin_used + bytes_read > stdin_size)
-        {
-            stdin_size *= 2;
-            stdin_contents = realloc(stdin_contents, stdin_size);
-        }
+        void *ptr = block->data + block->used;
+        block->used += size;
+        return ptr;
+    }
+
+    size_t block_size = size > ARENA_BLOCK_SIZE ? size : ARENA_BLOCK_SIZE;
+    block = malloc(sizeof(struct ArenaBlock) + block_size);
+    if (block == NULL)
+    {
+        return NULL;
+    }
+    block->size = block_size;
+    block->used = size;
 
-        memcpy(stdin_contents + stdin_used, buffer, bytes_read);
-        stdin_used += bytes_read;
+    // oversized allocations get a block of their own behind the current one
+    // so the space left in the current block can still be used
+    if (size > ARENA_BLOCK_SIZE && arena->head != NULL)
+    {
+        block->next = arena->head->next;
+        arena->head->next = block;
     }
+    else
+    {
+        block->next = arena->head;
+        arena->head = block;
+    }
+
+    return block->data;
+}
 
-    // Null terminate the string
-    if (stdin_contents)
+// Arena_StrNDup copies length bytes of a string into the arena and terminates it
+char *Arena_StrNDup(struct Arena *arena, const char *string, size_t length)
+{
+    char *copy = Arena_Alloc(arena, length + 1);
+    if (copy == NULL)
     {
-        if (stdin_used == stdin_size)
-        {
-            stdin_contents = realloc(stdin_contents, stdin_size + 1);
-        }
-        stdin_contents[stdin_used] = '\0';
+        return NULL;
+    }
+
+    memcpy(copy, string, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+// Arena_Free releases every block owned by the arena
+void Arena_Free(struct Arena *arena)
+{
+    struct ArenaBlock *block = arena->head;
+    while (block != NULL)
+    {
+        struct ArenaBlock *next = block->next;
+        free(block);
+        block = next;
     }
+    arena->head = NULL;
+}
 
-    return stdin_contents;
+// hash_string computes the FNV-1a hash of a string
+static uint32_t hash_string(const char *string, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= (unsigned char)string[i];
+        hash *= 16777619u;
+    }
+    return hash;
 }
 
-// hydrate_display_states hydrates the display states from a file or stdin
-struct ItemsState *ItemsState_New(const char *filename, const char *item_key, const char *default_background_image, const char *default_background_color, bool default_show_pill, enum MessageAlignment default_alignment)
+// InternTable_Grow doubles the number of slots and rehashes every entry
+static bool InternTable_Grow(struct InternTable *table)
 {
-    struct ItemsState *state = malloc(sizeof(struct ItemsState));
+    size_t capacity = table->capacity == 0 ? 64 : table->capacity * 2;
+    struct InternedString *entries = calloc(capacity, sizeof(struct InternedString));
+    if (entries == NULL)
+    {
+        return false;
+    }
 
-    JSON_Value *root_value;
-    if (strcmp(filename, "-") == 0)
+    for (size_t i = 0; i < table->capacity; i++)
     {
-        char *contents = read_stdin();
-        if (contents == NULL)
+        if (table->entries[i].string == NULL)
         {
-            log_error("Failed to read stdin");
-            return NULL;
+            continue;
         }
 
-        root_value = json_parse_string_with_comments(contents);
-        free(contents);
+        size_t slot = table->entries[i].hash & (capacity - 1);
+        while (entries[slot].string != NULL)
+        {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        entries[slot] = table->entries[i];
     }
-    else
+
+    free(table->entries);
+    table->entries = entries;
+    table->capacity = capacity;
+    return true;
+}
+
+// InternTable_Intern returns the entry for a string, copying it into the arena on first use
+// the returned entry is only valid until the next call
+struct InternedString *InternTable_Intern(struct InternTable *table, struct Arena *arena, const char *string, size_t length)
+{
+    if ((table->count + 1) * 2 > table->capacity && !InternTable_Grow(table))
     {
-        root_value = json_parse_file_with_comments(filename);
+        return NULL;
     }
 
-    if (root_value == NULL)
+    uint32_t hash = hash_string(string, length);
+    size_t slot = hash & (table->capacity - 1);
+    while (table->entries[slot].string != NULL)
     {
-        log_error("Failed to parse JSON file");
-        return NULL;
+        struct InternedString *entry = &table->entries[slot];
+        if (entry->hash == hash && entry->length == length && memcmp(entry->string, string, length) == 0)
+        {
+            return entry;
+        }
+        slot = (slot + 1) & (table->capacity - 1);
     }
 
-    JSON_Object *root_object = json_value_get_object(root_value);
-    if (root_object == NULL)
+    const char *copy = Arena_StrNDup(arena, string, length);
+    if (copy == NULL)
     {
-        json_value_free(root_value);
         return NULL;
     }
 
-    JSON_Array *items = json_object_get_array(root_object, item_key);
-    if (items == NULL)
+    struct InternedString *entry = &table->entries[slot];
+    entry->string = copy;
+    entry->hash = hash;
+    entry->length = length;
+    entry->data = 0;
+    table->count++;
+    return entry;
+}
+
+// InternTable_Free releases the slots of the table (the strings belong to the arena)
+void InternTable_Free(struct InternTable *table)
+{
+    free(table->entries);
+    table->entries = NULL;
+    table->capacity = 0;
+    table->count = 0;
+}
+
+#define JSON_READER_CHUNK_SIZE (64 * 1024)
+#define JSON_MAX_NESTING 2048
+#define JSON_EOF -1
+#define JSON_INVALID -2
+
+// JsonKeyMark records a key held by an open object, so closing the object
+// restores the depth the key was held at before
+struct JsonKeyMark
+{
+    // the index of the key in key_depths
+    uint32_t key;
+    // the depth the key was held at when the object recorded it
+    uint32_t depth;
+};
+
+// JsonReader is a streaming JSON tokenizer that never holds more than one
+// chunk of the input in memory, comments are accepted like parson's
+// json_parse_file_with_comments and gzip compressed input is inflated on
+// the fly
+struct JsonReader
+{
+    // the stream being read, NULL when reading from memory
+    FILE *file;
+    // the bytes currently available to the reader
+    const char *data;
+    // number of bytes in data
+    size_t length;
+    // read position within data
+    size_t position;
+    // absolute stream offset of data[0]
+    size_t offset;
+    // buffer that chunks of the stream are read into
+    char *chunk;
+    // when set, every chunk read from file is also written here so a
+    // non-seekable stream can be revisited later
+    FILE *spool;
+    // inflates the stream when it is gzip compressed (NULL otherwise)
+    z_stream *inflater;
+    // compressed bytes read from file that are waiting to be inflated
+    unsigned char *compressed;
+    // the most recently decoded string or number
+    char *scratch;
+    // length of the scratch contents
+    size_t scratch_length;
+    // allocated size of the scratch buffer
+    size_t scratch_capacity;
+    // every distinct key of the objects read so far, the data of an entry
+    // indexes key_depths
+    struct InternTable keys;
+    // holds the strings of keys
+    struct Arena key_arena;
+    // for every key, the depth of the innermost open object holding it (0 for none)
+    uint32_t *key_depths;
+    // allocated number of key_depths
+    size_t key_depth_capacity;
+    // the keys held by the open objects, with the depth each replaced
+    struct JsonKeyMark *key_marks;
+    // number of key_marks in use
+    size_t key_mark_count;
+    // allocated number of key_marks
+    size_t key_mark_capacity;
+    // number of objects currently open
+    uint32_t object_depth;
+};
+
+// JsonReader_InitFile prepares a reader for a stream
+bool JsonReader_InitFile(struct JsonReader *reader, FILE *file)
+{
+    memset(reader, 0, sizeof(*reader));
+    reader->file = file;
+    reader->chunk = malloc(JSON_READER_CHUNK_SIZE);
+    reader->data = reader->chunk;
+    return reader->chunk != NULL;
+}
+
+// JsonReader_InitString prepares a reader for a string that is already in memory
+void JsonReader_InitString(struct JsonReader *reader, const char *string, size_t length)
+{
+    memset(reader, 0, sizeof(*reader));
+    reader->data = string;
+    reader->length = length;
+}
+
+// JsonReader_Free releases the buffers of the reader (the stream is left open)
+void JsonReader_Free(struct JsonReader *reader)
+{
+    if (reader->inflater != NULL)
     {
-        json_value_free(root_value);
-        return NULL;
+        inflateEnd(reader->inflater);
+        free(reader->inflater);
+        reader->inflater = NULL;
+    }
+    free(reader->compressed);
+    free(reader->chunk);
+    free(reader->scratch);
+    free(reader->key_depths);
+    free(reader->key_marks);
+    InternTable_Free(&reader->keys);
+    Arena_Free(&reader->key_arena);
+    reader->compressed = NULL;
+    reader->chunk = NULL;
+    reader->scratch = NULL;
+    reader->key_depths = NULL;
+    reader->key_marks = NULL;
+}
+
+// JsonReader_Open reads the first chunk of a stream, switching to inflating
+// it when it starts with the gzip magic bytes
+bool JsonReader_Open(struct JsonReader *reader)
+{
+    size_t length = fread(reader->chunk, 1, JSON_READER_CHUNK_SIZE, reader->file);
+    if (length < 2 || (unsigned char)reader->chunk[0] != 0x1f || (unsigned char)reader->chunk[1] != 0x8b)
+    {
+        reader->length = length;
+        reader->position = 0;
+        return true;
     }
 
-    size_t item_count = json_array_get_count(items);
-    if (item_count == 0)
+    // the compressed bytes are handed to zlib as they are read, the document
+    // is never held in memory in either form
+    reader->inflater = calloc(1, sizeof(z_stream));
+    reader->compressed = malloc(JSON_READER_CHUNK_SIZE);
+    if (reader->inflater == NULL || reader->compressed == NULL || inflateInit2(reader->inflater, 15 + 16) != Z_OK)
     {
-        json_value_free(root_value);
-        return NULL;
+        free(reader->inflater);
+        reader->inflater = NULL;
+        return false;
     }
 
-    state->items = malloc(sizeof(struct Item) * item_count);
+    memcpy(reader->compressed, reader->chunk, length);
+    reader->inflater->next_in = reader->compressed;
+    reader->inflater->avail_in = length;
+    reader->length = 0;
+    reader->position = 0;
+    return true;
+}
+
+// JsonReader_SetSpool copies what was read so far, and everything read from now on, into spool
+bool JsonReader_SetSpool(struct JsonReader *reader, FILE *spool)
+{
+    reader->spool = spool;
+    return fwrite(reader->data, 1, reader->length, spool) == reader->length;
+}
+
+// JsonReader_Inflate fills the chunk with the next inflated bytes of a compressed stream
+static size_t JsonReader_Inflate(struct JsonReader *reader)
+{
+    z_stream *inflater = reader->inflater;
+    inflater->next_out = (Bytef *)reader->chunk;
+    inflater->avail_out = JSON_READER_CHUNK_SIZE;
 
-    for (size_t i = 0; i < item_count; i++)
+    while (inflater->avail_out == JSON_READER_CHUNK_SIZE)
     {
-        JSON_Object *item = json_array_get_object(items, i);
-        if (item == NULL)
+        if (inflater->avail_in == 0)
         {
-            char buff[1024];
-            snprintf(buff, sizeof(buff), "Failed to get item %zu", i);
-            log_error(buff);
-            json_value_free(root_value);
-            return NULL;
+            size_t length = fread(reader->compressed, 1, JSON_READER_CHUNK_SIZE, reader->file);
+            if (length == 0)
+            {
+                break;
+            }
+            inflater->next_in = reader->compressed;
+            inflater->avail_in = length;
         }
 
-        const char *text = json_object_get_string(item, "text");
-        if (text == NULL)
+        int result = inflate(inflater, Z_NO_FLUSH);
+        if (result == Z_STREAM_END)
         {
-            char buff[1024];
-            snprintf(buff, sizeof(buff), "Failed to get text for item %zu", i);
-            log_error(buff);
-            json_value_free(root_value);
-            return NULL;
+            // concatenated gzip members (e.g. from appending to a file) form one document
+            if (inflateReset(inflater) != Z_OK)
+            {
+                break;
+            }
+        }
+        else if (result != Z_OK)
+        {
+            // corrupt input ends the stream, which the parser reports as a syntax error
+            break;
         }
+    }
+
+    return JSON_READER_CHUNK_SIZE - inflater->avail_out;
+}
+
+// JsonReader_Offset returns the absolute offset of the next unread byte
+size_t JsonReader_Offset(struct JsonReader *reader)
+{
+    return reader->offset + reader->position;
+}
 
-        state->items[i].text = strdup(text);
+// JsonReader_Fill makes sure at least one unread byte is available
+static bool JsonReader_Fill(struct JsonReader *reader)
+{
+    if (reader->position < reader->length)
+    {
+        return true;
+    }
+
+    if (reader->file == NULL)
+    {
+        return false;
+    }
+
+    reader->offset += reader->length;
+    if (reader->inflater != NULL)
+    {
+        reader->length = JsonReader_Inflate(reader);
+    }
+    else
+    {
+        reader->length = fread(reader->chunk, 1, JSON_READER_CHUNK_SIZE, reader->file);
+    }
+    reader->position = 0;
+    if (reader->spool != NULL && fwrite(reader->chunk, 1, reader->length, reader->spool) != reader->length)
+    {
+        reader->length = 0;
+    }
+    return reader->length > 0;
+}
+
+// JsonReader_Seek moves a file reader to an absolute stream offset
+bool JsonReader_Seek(struct JsonReader *reader, size_t offset)
+{
+    if (reader->file == NULL || fseeko(reader->file, offset, SEEK_SET) != 0)
+    {
+        return false;
+    }
+
+    reader->offset = offset;
+    reader->length = 0;
+    reader->position = 0;
+    return true;
+}
+
+// JsonReader_Peek returns the next byte without consuming it
+static int JsonReader_Peek(struct JsonReader *reader)
+{
+    if (!JsonReader_Fill(reader))
+    {
+        return JSON_EOF;
+    }
+    return (unsigned char)reader->data[reader->position];
+}
+
+// JsonReader_Get consumes and returns the next byte
+static int JsonReader_Get(struct JsonReader *reader)
+{
+    if (!JsonReader_Fill(reader))
+    {
+        return JSON_EOF;
+    }
+    return (unsigned char)reader->data[reader->position++];
+}
 
-        const char *background_image = json_object_get_string(item, "background_image");
-        state->items[i].background_image = strdup(default_background_image);
-        state->items[i].image_exists = default_background_image != NULL && access(default_background_image, F_OK) != -1;
-        if (background_image != NULL)
+// JsonReader_PeekToken skips whitespace and comments and returns the next byte without consuming it
+int JsonReader_PeekToken(struct JsonReader *reader)
+{
+    for (;;)
+    {
+        int c = JsonReader_Peek(reader);
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r')
         {
-            state->items[i].background_image = strdup(background_image);
-            state->items[i].image_exists = access(background_image, F_OK) != -1;
+            reader->position++;
+            continue;
         }
 
-        const char *background_color = json_object_get_string(item, "background_color");
-        state->items[i].background_color = strdup(default_background_color);
-        if (background_color != NULL)
+        if (c != '/')
         {
-            state->items[i].background_color = strdup(background_color);
+            return c;
         }
 
-        state->items[i].show_pill = default_show_pill;
-        if (json_object_has_value(item, "show_pill"))
+        reader->position++;
+        int next = JsonReader_Get(reader);
+        if (next == '/')
         {
-            if (json_object_get_boolean(item, "show_pill") == 1)
+            while ((c = JsonReader_Get(reader)) != JSON_EOF && c != '\n')
             {
-                state->items[i].show_pill = true;
             }
-            else if (json_object_get_boolean(item, "show_pill") == 0)
+        }
+        else if (next == '*')
+        {
+            int previous = 0;
+            while ((c = JsonReader_Get(reader)) != JSON_EOF && !(previous == '*' && c == '/'))
             {
-                state->items[i].show_pill = false;
+                previous = c;
             }
-            else
+
+            if (c == JSON_EOF)
             {
-                char buff[1024];
-                snprintf(buff, sizeof(buff), "Invalid show_pill value provided for item %zu", i);
-                log_error(buff);
-                json_value_free(root_value);
-                return NULL;
+                return JSON_INVALID;
             }
         }
-
-        const char *alignment = json_object_get_string(item, "alignment");
-        if (alignment == NULL)
-        {
-            state->items[i].alignment = default_alignment;
-        }
-        else if (strcmp(alignment, "top") == 0)
-        {
-            state->items[i].alignment = MessageAlignmentTop;
-        }
-        else if (strcmp(alignment, "bottom") == 0)
-        {
-            state->items[i].alignment = MessageAlignmentBottom;
-        }
-        else if (strcmp(alignment, "middle") == 0)
-        {
-            state->items[i].alignment = MessageAlignmentMiddle;
-        }
         else
         {
-            char buff[1024];
-            snprintf(buff, sizeof(buff), "Invalid alignment provided for item %zu", i);
-            log_error(buff);
-            json_value_free(root_value);
-            return NULL;
+            return JSON_INVALID;
         }
     }
+}
 
-    state->item_count = item_count;
-    state->selected = 0;
-
-    if (json_object_has_value(root_object, "selected"))
+// JsonReader_Expect consumes the next token if it is the expected character
+bool JsonReader_Expect(struct JsonReader *reader, char expected)
+{
+    if (JsonReader_PeekToken(reader) != expected)
     {
-        state->selected = json_object_get_number(root_object, "selected");
-        if (state->selected < 0)
-        {
-            state->selected = 0;
-        }
-        else if (state->selected >= item_count)
-        {
-            state->selected = item_count - 1;
-        }
+        return false;
     }
 
-    json_value_free(root_value);
-    return state;
+    reader->position++;
+    return true;
 }
 
-// handle_input interprets input events and mutates app state
-void handle_input(struct AppState *state)
+// JsonReader_BeginObject starts tracking the keys of an object whose '{'
+// was consumed, returning the mark to end it with
+size_t JsonReader_BeginObject(struct JsonReader *reader)
 {
-    if (!state->items_state->items[state->items_state->selected].image_exists && state->items_state->items[state->items_state->selected].background_image != NULL)
+    reader->object_depth++;
+    return reader->key_mark_count;
+}
+
+// JsonReader_AddKey records the key in the scratch buffer for the innermost
+// open object, failing when the object already holds it, as duplicate keys
+// make the whole document invalid for parson
+bool JsonReader_AddKey(struct JsonReader *reader)
+{
+    struct InternedString *entry = InternTable_Intern(&reader->keys, &reader->key_arena, reader->scratch, reader->scratch_length);
+    if (entry == NULL)
     {
-        if (access(state->items_state->items[state->items_state->selected].background_image, F_OK) != -1)
-        {
-            state->items_state->items[state->items_state->selected].image_exists = true;
-            state->redraw = 1;
-        }
+        return false;
     }
 
-    if (increment_item_list_index)
+    // the first time a key is seen it gets the next free depth slot
+    if (entry->data == 0)
     {
-        pthread_mutex_lock(&increment_item_list_index_lock);
-        increment_item_list_index = 0;
-        state->items_state->selected += 1;
-        bool should_return = false;
-        if (state->items_state->selected >= state->items_state->item_count)
+        if (reader->keys.count >= reader->key_depth_capacity)
         {
-            if (state->quit_after_last_item)
-            {
-                state->redraw = 0;
-                state->quitting = 1;
-                state->exit_code = ExitCodeSuccess;
-                should_return = true;
-            }
-            else
+            size_t capacity = reader->key_depth_capacity == 0 ? 64 : reader->key_depth_capacity * 2;
+            uint32_t *depths = realloc(reader->key_depths, sizeof(uint32_t) * capacity);
+            if (depths == NULL)
             {
-                state->items_state->selected = 0;
+                return false;
             }
+            reader->key_depths = depths;
+            reader->key_depth_capacity = capacity;
         }
-        state->redraw = 1;
-        pthread_mutex_unlock(&increment_item_list_index_lock);
-        if (should_return)
-        {
-            return;
-        }
+        entry->data = reader->keys.count;
+        reader->key_depths[entry->data] = 0;
     }
 
-    if (state->timeout_seconds < 0)
+    uint32_t key = entry->data;
+    if (reader->key_depths[key] == reader->object_depth)
     {
-        return;
+        return false;
     }
 
-    PAD_poll();
-
-    bool is_action_button_pressed = false;
-    bool is_confirm_button_pressed = false;
-    bool is_cancel_button_pressed = false;
-    bool is_inaction_button_pressed = false;
-    if (PAD_justReleased(BTN_A))
+    if (reader->key_mark_count == reader->key_mark_capacity)
     {
-        if (strcmp(state->action_button, "A") == 0)
-        {
-            is_action_button_pressed = true;
-        }
-        else if (strcmp(state->confirm_button, "A") == 0)
+        size_t capacity = reader->key_mark_capacity == 0 ? 64 : reader->key_mark_capacity * 2;
+        struct JsonKeyMark *marks = realloc(reader->key_marks, sizeof(struct JsonKeyMark) * capacity);
+        if (marks == NULL)
         {
-            is_confirm_button_pressed = true;
+            return false;
         }
-        else if (strcmp(state->cancel_button, "A") == 0)
+        reader->key_marks = marks;
+        reader->key_mark_capacity = capacity;
+    }
+
+    reader->key_marks[reader->key_mark_count++] = (struct JsonKeyMark){key, reader->key_depths[key]};
+    reader->key_depths[key] = reader->object_depth;
+    return true;
+}
+
+// JsonReader_EndObject stops tracking the keys of the innermost open object
+void JsonReader_EndObject(struct JsonReader *reader, size_t mark)
+{
+    while (reader->key_mark_count > mark)
+    {
+        struct JsonKeyMark *key_mark = &reader->key_marks[--reader->key_mark_count];
+        reader->key_depths[key_mark->key] = key_mark->depth;
+    }
+    reader->object_depth--;
+}
+
+// JsonReader_Append adds bytes to the scratch buffer
+static bool JsonReader_Append(struct JsonReader *reader, const char *bytes, size_t length)
+{
+    if (reader->scratch_length + length + 1 > reader->scratch_capacity)
+    {
+        size_t capacity = reader->scratch_capacity == 0 ? 256 : reader->scratch_capacity;
+        while (reader->scratch_length + length + 1 > capacity)
         {
-            is_cancel_button_pressed = true;
+            capacity *= 2;
         }
-        else if (strcmp(state->inaction_button, "A") == 0)
+
+        char *scratch = realloc(reader->scratch, capacity);
+        if (scratch == NULL)
         {
-            is_inaction_button_pressed = true;
+            return false;
         }
+        reader->scratch = scratch;
+        reader->scratch_capacity = capacity;
     }
-    else if (PAD_justReleased(BTN_B))
+
+    memcpy(reader->scratch + reader->scratch_length, bytes, length);
+    reader->scratch_length += length;
+    reader->scratch[reader->scratch_length] = '\0';
+    return true;
+}
+
+// JsonReader_ReadHex4 reads the four hex digits of a \u escape
+static bool JsonReader_ReadHex4(struct JsonReader *reader, uint32_t *value)
+{
+    *value = 0;
+    for (int i = 0; i < 4; i++)
     {
-        if (strcmp(state->action_button, "B") == 0)
+        int c = JsonReader_Get(reader);
+        *value <<= 4;
+        if (c >= '0' && c <= '9')
         {
-            is_action_button_pressed = true;
+            *value |= c - '0';
         }
-        else if (strcmp(state->confirm_button, "B") == 0)
+        else if (c >= 'a' && c <= 'f')
         {
-            is_confirm_button_pressed = true;
+            *value |= c - 'a' + 10;
         }
-        else if (strcmp(state->cancel_button, "B") == 0)
+        else if (c >= 'A' && c <= 'F')
         {
-            is_cancel_button_pressed = true;
+            *value |= c - 'A' + 10;
         }
-        else if (strcmp(state->inaction_button, "B") == 0)
+        else
         {
-            is_inaction_button_pressed = true;
+            return false;
         }
     }
-    else if (PAD_justReleased(BTN_X))
+    return true;
+}
+
+// JsonReader_AppendCodepoint encodes a unicode codepoint as UTF-8 into the scratch buffer
+static bool JsonReader_AppendCodepoint(struct JsonReader *reader, uint32_t codepoint)
+{
+    char bytes[4];
+    size_t length;
+    if (codepoint < 0x80)
     {
-        if (strcmp(state->action_button, "X") == 0)
+        bytes[0] = codepoint;
+        length = 1;
+    }
+    else if (codepoint < 0x800)
+    {
+        bytes[0] = 0xC0 | (codepoint >> 6);
+        bytes[1] = 0x80 | (codepoint & 0x3F);
+        length = 2;
+    }
+    else if (codepoint < 0x10000)
+    {
+        bytes[0] = 0xE0 | (codepoint >> 12);
+        bytes[1] = 0x80 | ((codepoint >> 6) & 0x3F);
+        bytes[2] = 0x80 | (codepoint & 0x3F);
+        length = 3;
+    }
+    else
+    {
+        bytes[0] = 0xF0 | (codepoint >> 18);
+        bytes[1] = 0x80 | ((codepoint >> 12) & 0x3F);
+        bytes[2] = 0x80 | ((codepoint >> 6) & 0x3F);
+        bytes[3] = 0x80 | (codepoint & 0x3F);
+        length = 4;
+    }
+    return JsonReader_Append(reader, bytes, length);
+}
+
+// JsonReader_ReadString decodes the next string into the scratch buffer
+bool JsonReader_ReadString(struct JsonReader *reader)
+{
+    if (JsonReader_PeekToken(reader) != '"')
+    {
+        return false;
+    }
+    reader->position++;
+
+    reader->scratch_length = 0;
+    if (!JsonReader_Append(reader, "", 0))
+    {
+        return false;
+    }
+
+    for (;;)
+    {
+        // copy runs of plain characters straight out of the chunk
+        size_t start = reader->position;
+        while (reader->position < reader->length)
         {
-            is_action_button_pressed = true;
+            unsigned char c = reader->data[reader->position];
+            if (c == '"' || c == '\\' || c < 0x20)
+            {
+                break;
+            }
+            reader->position++;
         }
-        else if (strcmp(state->confirm_button, "X") == 0)
+        if (reader->position > start && !JsonReader_Append(reader, reader->data + start, reader->position - start))
         {
-            is_confirm_button_pressed = true;
+            return false;
         }
-        else if (strcmp(state->cancel_button, "X") == 0)
+
+        int c = JsonReader_Get(reader);
+        if (c == '"')
         {
-            is_cancel_button_pressed = true;
+            return true;
         }
-        else if (strcmp(state->inaction_button, "X") == 0)
+
+        if (c == JSON_EOF || c < 0x20)
         {
-            is_inaction_button_pressed = true;
+            return false;
         }
-    }
-    else if (PAD_justReleased(BTN_Y))
-    {
-        if (strcmp(state->action_button, "Y") == 0)
+
+        if (c != '\\')
         {
-            is_action_button_pressed = true;
+            char byte = c;
+            if (!JsonReader_Append(reader, &byte, 1))
+            {
+                return false;
+            }
+            continue;
         }
-        else if (strcmp(state->confirm_button, "Y") == 0)
+
+        char escaped;
+        switch (JsonReader_Get(reader))
         {
-            is_confirm_button_pressed = true;
-        }
-        else if (strcmp(state->cancel_button, "Y") == 0)
+        case '"':
+            escaped = '"';
+            break;
+        case '\\':
+            escaped = '\\';
+            break;
+        case '/':
+            escaped = '/';
+            break;
+        case 'b':
+            escaped = '\b';
+            break;
+        case 'f':
+            escaped = '\f';
+            break;
+        case 'n':
+            escaped = '\n';
+            break;
+        case 'r':
+            escaped = '\r';
+            break;
+        case 't':
+            escaped = '\t';
+            break;
+        case 'u':
         {
-            is_cancel_button_pressed = true;
+            uint32_t codepoint;
+            if (!JsonReader_ReadHex4(reader, &codepoint))
+            {
+                return false;
+            }
+
+            // surrogate pairs encode codepoints outside of the basic multilingual plane
+            if (codepoint >= 0xD800 && codepoint <= 0xDBFF)
+            {
+                uint32_t low;
+                if (JsonReader_Get(reader) != '\\' || JsonReader_Get(reader) != 'u' || !JsonReader_ReadHex4(reader, &low) || low < 0xDC00 || low > 0xDFFF)
+                {
+                    return false;
+                }
+                codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+            }
+            else if (codepoint >= 0xDC00 && codepoint <= 0xDFFF)
+            {
+                return false;
+            }
+
+            if (!JsonReader_AppendCodepoint(reader, codepoint))
+            {
+                return false;
+            }
+            continue;
         }
-        else if (strcmp(state->inaction_button, "Y") == 0)
+        default:
+            return false;
+        }
+
+        if (!JsonReader_Append(reader, &escaped, 1))
         {
-            is_inaction_button_pressed = true;
+            return false;
         }
     }
+}
 
-    if (is_action_button_pressed && state->action_show)
+// JsonReader_SkipString consumes the next string without decoding it
+static bool JsonReader_SkipString(struct JsonReader *reader)
+{
+    if (JsonReader_Get(reader) != '"')
     {
-        state->redraw = 0;
-        state->quitting = 1;
-        state->exit_code = ExitCodeActionButton;
-        return;
+        return false;
     }
 
-    if (is_confirm_button_pressed && state->confirm_show)
+    for (;;)
     {
-        state->redraw = 0;
-        state->quitting = 1;
-        state->exit_code = ExitCodeSuccess;
-        return;
+        while (reader->position < reader->length)
+        {
+            unsigned char c = reader->data[reader->position];
+            if (c == '"' || c == '\\' || c < 0x20)
+            {
+                break;
+            }
+            reader->position++;
+        }
+
+        int c = JsonReader_Get(reader);
+        if (c == '"')
+        {
+            return true;
+        }
+
+        if (c == JSON_EOF || c < 0x20)
+        {
+            return false;
+        }
+
+        if (c == '\\' && JsonReader_Get(reader) == JSON_EOF)
+        {
+            return false;
+        }
     }
+}
 
-    if (is_cancel_button_pressed)
+// json_number_valid checks a number against the JSON grammar, which unlike
+// strtod rejects a leading '+', leading zeros and digits missing around '.' or 'e'
+static bool json_number_valid(const char *number)
+{
+    const unsigned char *c = (const unsigned char *)number;
+    if (*c == '-')
     {
-        state->redraw = 0;
-        state->quitting = 1;
-        state->exit_code = ExitCodeCancelButton;
-        return;
+        c++;
     }
 
-    if (is_inaction_button_pressed && state->inaction_show)
+    if (*c == '0')
     {
-        state->redraw = 0;
-        state->quitting = 1;
-        state->exit_code = ExitCodeInactionButton;
-        return;
+        c++;
     }
-
-    if (PAD_justReleased(BTN_START))
+    else if (isdigit(*c))
     {
-        state->redraw = 0;
-        state->quitting = 1;
-        state->exit_code = ExitCodeStartButton;
-        return;
+        while (isdigit(*c))
+        {
+            c++;
+        }
+    }
+    else
+    {
+        return false;
     }
 
-    if (PAD_justRepeated(BTN_LEFT))
+    if (*c == '.')
     {
-        if (state->items_state->selected == 0 && !PAD_justPressed(BTN_LEFT))
+        c++;
+        if (!isdigit(*c))
         {
-            state->redraw = 0;
+            return false;
         }
-        else
+        while (isdigit(*c))
         {
-            state->items_state->selected -= 1;
-            if (state->items_state->selected < 0)
-            {
-                state->items_state->selected = state->items_state->item_count - 1;
-            }
-            state->redraw = 1;
+            c++;
         }
     }
-    else if (PAD_justRepeated(BTN_RIGHT))
+
+    if (*c == 'e' || *c == 'E')
     {
-        if (state->items_state->selected == state->items_state->item_count - 1 && !PAD_justPressed(BTN_RIGHT))
+        c++;
+        if (*c == '+' || *c == '-')
         {
-            state->redraw = 0;
+            c++;
         }
-        else
+        if (!isdigit(*c))
         {
-            state->items_state->selected += 1;
-            if (state->items_state->selected >= state->items_state->item_count)
-            {
-                if (state->quit_after_last_item)
-                {
-                    state->redraw = 0;
-                    state->quitting = 1;
-                    state->exit_code = ExitCodeSuccess;
-                    return;
-                }
-                state->items_state->selected = 0;
-            }
-            state->redraw = 1;
+            return false;
+        }
+        while (isdigit(*c))
+        {
+            c++;
         }
     }
+
+    return *c == '\0';
 }
 
-// turns a hex color (e.g. #000000) into an SDL_Color
-SDL_Color hex_to_sdl_color(const char *hex)
+// JsonReader_ReadNumber reads the next number
+bool JsonReader_ReadNumber(struct JsonReader *reader, double *value)
 {
-    SDL_Color color = {0, 0, 0, 255};
-
-    // Skip # if present
-    if (hex[0] == '#')
+    JsonReader_PeekToken(reader);
+    reader->scratch_length = 0;
+    for (;;)
     {
-        hex++;
+        int c = JsonReader_Peek(reader);
+        if (!(isdigit(c) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E'))
+        {
+            break;
+        }
+
+        char byte = c;
+        if (!JsonReader_Append(reader, &byte, 1))
+        {
+            return false;
+        }
+        reader->position++;
     }
 
-    // Parse RGB values from hex string
-    int r, g, b;
-    if (sscanf(hex, "%02x%02x%02x", &r, &g, &b) == 3)
+    if (reader->scratch_length == 0 || !json_number_valid(reader->scratch))
     {
-        color.r = r;
-        color.g = g;
-        color.b = b;
+        return false;
     }
 
-    return color;
+    // numbers too large for a double are rejected like parson does
+    errno = 0;
+    *value = strtod(reader->scratch, NULL);
+    return errno != ERANGE || (*value > -1 && *value < 1);
 }
 
-// scale_surface manually scales a surface to a new width and height for SDL1
-SDL_Surface *scale_surface(SDL_Surface *surface,
-                           Uint16 width, Uint16 height)
+// JsonReader_ReadLiteral reads the next true, false or null literal
+// returns 1 for true, 0 for false, -1 for null and JSON_INVALID otherwise
+int JsonReader_ReadLiteral(struct JsonReader *reader)
 {
-    SDL_Surface *scaled = SDL_CreateRGBSurface(surface->flags,
-                                               width,
-                                               height,
-                                               surface->format->BitsPerPixel,
-                                               surface->format->Rmask,
-                                               surface->format->Gmask,
-                                               surface->format->Bmask,
-                                               surface->format->Amask);
+    JsonReader_PeekToken(reader);
 
-    int bpp = surface->format->BytesPerPixel;
-    int *v = (int *)malloc(bpp * sizeof(int));
+    char word[6];
+    size_t length = 0;
+    while (length < sizeof(word) - 1 && isalpha(JsonReader_Peek(reader)))
+    {
+        word[length++] = JsonReader_Get(reader);
+    }
+    word[length] = '\0';
 
-    for (int x = 0; x < width; x++)
+    if (strcmp(word, "true") == 0)
     {
-        for (int y = 0; y < height; y++)
-        {
-            int xo1 = x * surface->w / width;
-            int xo2 = MAX((x + 1) * surface->w / width, xo1 + 1);
-            int yo1 = y * surface->h / height;
-            int yo2 = MAX((y + 1) * surface->h / height, yo1 + 1);
-            int n = (xo2 - xo1) * (yo2 - yo1);
-
-            for (int i = 0; i < bpp; i++)
-                v[i] = 0;
-
-            for (int xo = xo1; xo < xo2; xo++)
-                for (int yo = yo1; yo < yo2; yo++)
-                {
-                    Uint8 *ps =
-                        (Uint8 *)surface->pixels + yo * surface->pitch + xo * bpp;
-                    for (int i = 0; i < bpp; i++)
-                        v[i] += ps[i];
-                }
-
-            Uint8 *pd = (Uint8 *)scaled->pixels + y * scaled->pitch + x * bpp;
-            for (int i = 0; i < bpp; i++)
-                pd[i] = v[i] / n;
-        }
+        return 1;
     }
-
-    free(v);
-
-    return scaled;
+    if (strcmp(word, "false") == 0)
+    {
+        return 0;
+    }
+    if (strcmp(word, "null") == 0)
+    {
+        return -1;
+    }
+    return JSON_INVALID;
 }
 
-// draw_screen interprets the app state and draws it to the screen
-void draw_screen(SDL_Surface *screen, struct AppState *state)
+// JsonReader_SkipValue consumes the next value of any type, validating it along the way
+bool JsonReader_SkipValue(struct JsonReader *reader, int depth)
 {
-    // render a background color
-    char hex_color[1024] = "#000000";
-    if (state->items_state->items[state->items_state->selected].background_color != NULL)
+    if (depth > JSON_MAX_NESTING)
     {
-        strncpy(hex_color, state->items_state->items[state->items_state->selected].background_color, sizeof(hex_color));
+        return false;
     }
 
-    SDL_Color background_color = hex_to_sdl_color(hex_color);
-    uint32_t color = SDL_MapRGBA(screen->format, background_color.r, background_color.g, background_color.b, 255);
-    SDL_FillRect(screen, NULL, color);
+    int c = JsonReader_PeekToken(reader);
+    if (c == '"')
+    {
+        return JsonReader_SkipString(reader);
+    }
 
-    // check if there is an image and it is accessible
-    if (state->items_state->items[state->items_state->selected].background_image != NULL)
+    if (c == '{' || c == '[')
     {
-        SDL_Surface *surface = IMG_Load(state->items_state->items[state->items_state->selected].background_image);
-        if (surface)
+        char close = c == '{' ? '}' : ']';
+        reader->position++;
+        if (JsonReader_Expect(reader, close))
         {
-            int imgW = surface->w, imgH = surface->h;
-
-            // Compute scale factor
-            float scaleX = (float)(FIXED_WIDTH - 2 * PADDING) / imgW;
-            float scaleY = (float)(FIXED_HEIGHT - 2 * PADDING) / imgH;
-            float scale = (scaleX < scaleY) ? scaleX : scaleY;
+            return true;
+        }
 
-            // Ensure upscaling only when the image is smaller than the screen
-            if (imgW * scale < FIXED_WIDTH - 2 * PADDING && imgH * scale < FIXED_HEIGHT - 2 * PADDING)
+        // keys are decoded rather than skipped so duplicates are caught
+        size_t mark = c == '{' ? JsonReader_BeginObject(reader) : 0;
+        for (;;)
+        {
+            if (c == '{' && (JsonReader_PeekToken(reader) != '"' || !JsonReader_ReadString(reader) || !JsonReader_AddKey(reader) || !JsonReader_Expect(reader, ':')))
             {
-                scale = (scaleX > scaleY) ? scaleX : scaleY;
+                return false;
             }
 
-            // Compute target dimensions
-            int dstW = imgW * scale;
-            int dstH = imgH * scale;
-
-            int dstX = (FIXED_WIDTH - dstW) / 2;
-            int dstY = (FIXED_HEIGHT - dstH) / 2;
-            if (imgW == FIXED_WIDTH && imgH == FIXED_HEIGHT)
+            if (!JsonReader_SkipValue(reader, depth + 1))
             {
-                dstW = FIXED_WIDTH;
-                dstH = FIXED_HEIGHT;
-                dstX = 0;
-                dstY = 0;
+                return false;
             }
 
-            // Compute destination rectangle
-            SDL_Rect dstRect = {dstX, dstY, dstW, dstH};
-#ifdef USE_SDL2
-            SDL_BlitScaled(surface, NULL, screen, &dstRect);
-#else
-            if (imgW == FIXED_WIDTH && imgH == FIXED_HEIGHT)
+            if (JsonReader_Expect(reader, close))
             {
-                SDL_BlitSurface(surface, NULL, screen, &dstRect);
+                if (c == '{')
+                {
+                    JsonReader_EndObject(reader, mark);
+                }
+                return true;
             }
-            else
+
+            if (!JsonReader_Expect(reader, ','))
             {
-                SDL_Surface *scaled = scale_surface(surface, dstW, dstH);
-                SDL_BlitSurface(scaled, NULL, screen, &dstRect);
-                SDL_FreeSurface(scaled);
+                return false;
             }
-#endif
-            SDL_FreeSurface(surface);
         }
     }
 
-    // draw the button group on the button-right
-    // only two buttons can be displayed at a time
-    if (state->confirm_show && strcmp(state->confirm_button, "") != 0)
-    {
-        if (state->cancel_show && strcmp(state->cancel_button, "") != 0)
-        {
-            GFX_blitButtonGroup((char *[]){state->cancel_button, state->cancel_text, state->confirm_button, state->confirm_text, NULL}, 1, screen, 1);
-        }
-        else
-        {
-            GFX_blitButtonGroup((char *[]){state->confirm_button, state->confirm_text, NULL}, 1, screen, 1);
-        }
-    }
-    else if (state->cancel_show)
+    if (c == '-' || isdigit(c))
     {
-        GFX_blitButtonGroup((char *[]){state->cancel_button, state->cancel_text, NULL}, 1, screen, 1);
+        double number;
+        return JsonReader_ReadNumber(reader, &number);
     }
 
-    int initial_padding = 0;
-    if (state->show_time_left && state->timeout_seconds > 0)
-    {
-        struct timeval current_time;
-        gettimeofday(&current_time, NULL);
+    return JsonReader_ReadLiteral(reader) != JSON_INVALID;
+}
 
-        int time_left = state->timeout_seconds - (current_time.tv_sec - state->start_time.tv_sec);
-        if (time_left <= 0)
-        {
-            time_left = 0;
-        }
+#define PACK_MAGIC "MPPACK\r\n"
+#define PACK_VERSION 1
+// items reference images inside the asset pack with this prefix
+#define PACK_URI_PREFIX "pack://"
+// how much of the pack around the current image is read ahead
+#define PACK_READAHEAD_BYTES (4 * 1024 * 1024)
 
-        char time_left_str[1024];
-        if (time_left == 1)
-        {
-            snprintf(time_left_str, sizeof(time_left_str), "Time left: %d second", time_left);
-        }
-        else
-        {
-            snprintf(time_left_str, sizeof(time_left_str), "Time left: %d seconds", time_left);
-        }
+// PackHeader starts every asset pack
+struct PackHeader
+{
+    // always PACK_MAGIC
+    char magic[8];
+    // the version of the format, always PACK_VERSION
+    uint32_t version;
+    // always DECK_BYTE_ORDER
+    uint32_t byte_order;
+    // number of images in the pack
+    uint32_t entry_count;
+    // number of hash index buckets, always a power of two
+    uint32_t bucket_count;
+    // the screen size raw images were scaled for
+    uint32_t screen_width;
+    uint32_t screen_height;
+    // file offset of the entry table
+    uint64_t entries_offset;
+    // file offset of the hash index, one entry index + 1 per bucket (0 for empty)
+    uint64_t buckets_offset;
+    // file offset of the name pool
+    uint64_t names_offset;
+    // size of the name pool in bytes
+    uint64_t names_size;
+};
 
-        SDL_Surface *text = TTF_RenderUTF8_Blended(state->fonts.small, time_left_str, COLOR_WHITE);
-        SDL_Rect pos = {
-            SCALE1(PADDING),
-            SCALE1(PADDING),
-            text->w,
-            text->h};
-        SDL_BlitSurface(text, NULL, screen, &pos);
+// PackEntry describes a single image of an asset pack
+struct PackEntry
+{
+    // name pool offset of the name
+    uint32_t name_offset;
+    // length of the name
+    uint32_t name_length;
+    // the hash of the name
+    uint32_t hash;
+    // the PackFormat of the data
+    uint32_t format;
+    // file offset of the data
+    uint64_t data_offset;
+    // size of the data in bytes
+    uint64_t data_size;
+    // the size of the image for raw formats
+    uint32_t width;
+    uint32_t height;
+};
 
-        initial_padding = text->h + SCALE1(PADDING);
+// AssetPack is a mapped asset pack
+struct AssetPack
+{
+    // the mapping (NULL when no pack is open)
+    void *data;
+    // size of the mapping
+    size_t size;
+    // the header at the start of the mapping
+    const struct PackHeader *header;
+    // the entry table
+    const struct PackEntry *entries;
+    // the hash index
+    const uint32_t *buckets;
+    // the name pool
+    const char *names;
+};
+
+// the pack opened with --asset-pack
+struct AssetPack asset_pack = {0};
+
+// AssetPack_Open maps an asset pack, only its tables are checked up front
+bool AssetPack_Open(struct AssetPack *pack, const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+    {
+        return false;
     }
 
-    int message_padding = SCALE1(PADDING + BUTTON_PADDING);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct PackHeader))
+    {
+        close(fd);
+        return false;
+    }
 
-    // get the width and height of every word in the message
-    struct Message words[1024];
-    int word_count = 0;
-    char original_message[1024];
-    strncpy(original_message, state->items_state->items[state->items_state->selected].text, sizeof(original_message));
-    char *word = strtok(original_message, " ");
-    int word_height = 0;
-    while (word != NULL)
+    void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
     {
-        int word_width;
-        strtrim(word);
-        if (strcmp(word, "") == 0)
-        {
-            continue;
-        }
+        return false;
+    }
 
-        TTF_SizeUTF8(state->fonts.large, word, &word_width, &word_height);
-        strncpy(words[word_count].message, word, sizeof(words[word_count].message));
-        words[word_count].width = word_width;
-        word_count++;
-        word = strtok(NULL, " ");
+    const struct PackHeader *header = data;
+    size_t size = st.st_size;
+    bool valid = memcmp(header->magic, PACK_MAGIC, sizeof(header->magic)) == 0 &&
+                 header->version == PACK_VERSION &&
+                 header->byte_order == DECK_BYTE_ORDER &&
+                 header->bucket_count > 0 &&
+                 (header->bucket_count & (header->bucket_count - 1)) == 0 &&
+                 header->entries_offset % sizeof(uint64_t) == 0 &&
+                 header->entries_offset <= size &&
+                 header->entry_count <= (size - header->entries_offset) / sizeof(struct PackEntry) &&
+                 header->buckets_offset % sizeof(uint32_t) == 0 &&
+                 header->buckets_offset <= size &&
+                 header->bucket_count <= (size - header->buckets_offset) / sizeof(uint32_t) &&
+                 header->names_offset <= size &&
+                 header->names_size <= size - header->names_offset;
+    if (!valid)
+    {
+        munmap(data, size);
+        return false;
     }
 
-    int letter_width = 0;
-    TTF_SizeUTF8(state->fonts.large, "A", &letter_width, NULL);
+    // images are looked up in navigation order, not file order, so the
+    // kernel's sequential readahead is replaced with AssetPack_Readahead
+    madvise(data, size, MADV_RANDOM);
 
-    // construct a list of messages that can be displayed on a single line
-    // if the message is too long to be displayed on a single line,
-    // the message will be wrapped onto multiple lines
-    struct Message messages[MAIN_ROW_COUNT];
-    for (int i = 0; i < MAIN_ROW_COUNT; i++)
+    pack->data = data;
+    pack->size = size;
+    pack->header = header;
+    pack->entries = (const struct PackEntry *)((const char *)data + header->entries_offset);
+    pack->buckets = (const uint32_t *)((const char *)data + header->buckets_offset);
+    pack->names = (const char *)data + header->names_offset;
+    return true;
+}
+
+// AssetPack_Close unmaps an asset pack
+void AssetPack_Close(struct AssetPack *pack)
+{
+    if (pack->data != NULL)
     {
-        strncpy(messages[i].message, "", sizeof(messages[i].message));
-        messages[i].width = 0;
+        munmap(pack->data, pack->size);
     }
+    memset(pack, 0, sizeof(*pack));
+}
 
-    int message_count = 0;
-    int current_message_index = 0;
-    for (int i = 0; i < word_count; i++)
+// AssetPack_Find looks an image up by name in the hash index
+const struct PackEntry *AssetPack_Find(struct AssetPack *pack, const char *name)
+{
+    if (pack->data == NULL)
     {
-        if (current_message_index >= MAIN_ROW_COUNT)
-        {
-            break;
-        }
+        return NULL;
+    }
 
-        int potential_width = messages[current_message_index].width + words[i].width;
-        if (i > 0)
+    size_t length = strlen(name);
+    uint32_t hash = hash_string(name, length);
+    uint32_t mask = pack->header->bucket_count - 1;
+    for (uint32_t probe = 0; probe <= mask; probe++)
+    {
+        uint32_t index = pack->buckets[(hash + probe) & mask];
+        if (index == 0 || index > pack->header->entry_count)
         {
-            potential_width += letter_width;
+            return NULL;
         }
 
-        if (messages[current_message_index].width == 0)
-        {
-            strncpy(messages[current_message_index].message, words[i].message, sizeof(messages[current_message_index].message));
-            messages[current_message_index].width = words[i].width;
-        }
-        else if (potential_width <= FIXED_WIDTH - 2 * message_padding)
+        const struct PackEntry *entry = &pack->entries[index - 1];
+        if (entry->hash == hash &&
+            entry->name_length == length &&
+            entry->name_offset <= pack->header->names_size &&
+            length <= pack->header->names_size - entry->name_offset &&
+            memcmp(pack->names + entry->name_offset, name, length) == 0)
         {
-            if (messages[current_message_index].width == 0)
-            {
-                strncpy(messages[current_message_index].message, words[i].message, sizeof(messages[current_message_index].message));
-            }
-            else
+            // entries pointing outside of the pack are treated as missing
+            if (entry->data_offset > pack->size || entry->data_size > pack->size - entry->data_offset)
             {
-                char messageBuf[256];
-                snprintf(messageBuf, sizeof(messageBuf), "%s %s", messages[current_message_index].message, words[i].message);
-
-                strncpy(messages[current_message_index].message, messageBuf, sizeof(messages[current_message_index].message));
+                return NULL;
             }
-            messages[current_message_index].width += words[i].width;
-        }
-        else
-        {
-            current_message_index++;
-            message_count++;
-            strncpy(messages[current_message_index].message, words[i].message, sizeof(messages[current_message_index].message));
-            messages[current_message_index].width = words[i].width;
+            return entry;
         }
     }
 
-    int messages_height = (current_message_index + 1) * word_height + (SCALE1(PADDING) * current_message_index);
-    // default to the middle of the screen
-    int current_message_y = (screen->h - messages_height) / 2;
-    if (state->items_state->items[state->items_state->selected].alignment == MessageAlignmentTop)
+    return NULL;
+}
+
+// AssetPack_Readahead asks the kernel to read an image and the images packed
+// around it, so stepping through a gallery in pack order hits the page cache
+void AssetPack_Readahead(struct AssetPack *pack, const struct PackEntry *entry)
+{
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t start = entry->data_offset > PACK_READAHEAD_BYTES / 4 ? entry->data_offset - PACK_READAHEAD_BYTES / 4 : 0;
+    size_t end = entry->data_offset + entry->data_size + PACK_READAHEAD_BYTES;
+    if (end > pack->size)
     {
-        current_message_y = SCALE1(PADDING) + initial_padding;
+        end = pack->size;
     }
-    else if (state->items_state->items[state->items_state->selected].alignment == MessageAlignmentBottom)
+
+    start -= start % page_size;
+    madvise((char *)pack->data + start, end - start, MADV_WILLNEED);
+}
+
+// AssetPack_Load decodes an image of the pack, raw images are used in place
+// prescaled is set when the image already has its on-screen size
+SDL_Surface *AssetPack_Load(struct AssetPack *pack, const struct PackEntry *entry, bool *prescaled)
+{
+    AssetPack_Readahead(pack, entry);
+
+    const char *data = (const char *)pack->data + entry->data_offset;
+    *prescaled = false;
+
+    if (entry->format == PackFormatEncoded)
     {
-        current_message_y = screen->h - messages_height - SCALE1(PADDING) - initial_padding;
+        return IMG_Load_RW(SDL_RWFromConstMem(data, entry->data_size), 1);
     }
 
-    for (int i = 0; i <= message_count; i++)
+    size_t pixels_size = (size_t)entry->width * entry->height * 4;
+    if (entry->width == 0 || entry->height == 0 || entry->width > 16384 || entry->height > 16384)
     {
-        char *message = messages[i].message;
-        if (message == NULL)
-        {
-            continue;
-        }
-
-        int width = messages[i].width;
-        SDL_Surface *text = TTF_RenderUTF8_Blended(state->fonts.large, message, COLOR_WHITE);
-        if (text == NULL)
-        {
-            continue;
-        }
+        return NULL;
+    }
 
-        SDL_Rect pos = {
-            ((screen->w - text->w) / 2),
-            current_message_y + PADDING,
-            text->w,
-            text->h};
+    *prescaled = pack->header->screen_width == FIXED_WIDTH && pack->header->screen_height == FIXED_HEIGHT;
 
-        if (state->items_state->items[state->items_state->selected].show_pill)
+    if (entry->format == PackFormatRaw)
+    {
+        if (entry->data_size != pixels_size)
         {
-            SDL_Rect pill_rect = {
-                pos.x - SCALE1(PADDING * 2),
-                pos.y - SCALE1(PADDING),
-                text->w + SCALE1(PADDING * 4),
-                SCALE1(PILL_SIZE)};
-            GFX_blitPill(ASSET_BLACK_PILL, screen, &pill_rect);
+            return NULL;
         }
 
-        SDL_BlitSurface(text, NULL, screen, &pos);
-        current_message_y += word_height + SCALE1(PADDING);
+        // blits only ever read from the source, so the mapping is used directly
+        return SDL_CreateRGBSurfaceFrom((void *)data, entry->width, entry->height, 32, entry->width * 4, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
     }
-    if (state->action_show && strcmp(state->action_button, "") != 0)
+
+    if (entry->format == PackFormatRawDeflate)
     {
-        if (state->inaction_show && strcmp(state->inaction_button, "") != 0)
+        SDL_Surface *surface = SDL_CreateRGBSurface(0, entry->width, entry->height, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+        if (surface == NULL)
         {
-            GFX_blitButtonGroup((char *[]){state->inaction_button, state->inaction_text, state->action_button, state->action_text, NULL}, 0, screen, 0);
+            return NULL;
         }
-        else
+
+        uLongf length = pixels_size;
+        if (surface->pitch != (int)entry->width * 4 || uncompress(surface->pixels, &length, (const Bytef *)data, entry->data_size) != Z_OK || length != pixels_size)
         {
-            GFX_blitButtonGroup((char *[]){state->action_button, state->action_text, NULL}, 0, screen, 0);
+            SDL_FreeSurface(surface);
+            return NULL;
         }
+        return surface;
     }
-    else if (state->inaction_show && strcmp(state->inaction_button, "") != 0)
+
+    return NULL;
+}
+
+// image_exists checks whether a background image is available, looking
+// pack:// references up in the asset pack instead of on disk
+bool image_exists(const char *path)
+{
+    if (strncmp(path, PACK_URI_PREFIX, strlen(PACK_URI_PREFIX)) == 0)
     {
-        GFX_blitButtonGroup((char *[]){state->inaction_button, state->inaction_text, NULL}, 0, screen, 0);
+        return AssetPack_Find(&asset_pack, path + strlen(PACK_URI_PREFIX)) != NULL;
     }
 
-    // don't forget to reset the should_redraw flag
-    state->redraw = 0;
+    return access(path, F_OK) != -1;
 }
 
-bool open_fonts(struct AppState *state)
+#define PROBE_THREADS 2
+#define PROBE_QUEUE_SIZE 64
+// number of images after the selected one that are read ahead
+#define PROBE_READAHEAD_ITEMS 3
+
+// ProbeKind is the kind of work an ImageProber request asks for
+enum ProbeKind
 {
-    if (state->fonts.font_path == NULL)
+    // check whether the image exists
+    ProbeKindExists,
+    // ask the kernel to start reading the image into the page cache
+    ProbeKindReadahead,
+};
+
+// ProbeRequest is a single image metadata request and its result
+struct ProbeRequest
+{
+    // what to do with the image
+    enum ProbeKind kind;
+    // the item the image belongs to
+    size_t item;
+    // a copy of the path, items may be freed while the request is in flight
+    char *path;
+    // whether the image exists (ProbeKindExists only)
+    bool exists;
+};
+
+// ProbeQueue is a fixed size ring of requests
+struct ProbeQueue
+{
+    struct ProbeRequest requests[PROBE_QUEUE_SIZE];
+    // index of the oldest request
+    size_t head;
+    // number of requests in the ring
+    size_t count;
+};
+
+// ImageProber checks image metadata and issues readahead on worker threads
+// so slow storage never blocks the main loop
+struct ImageProber
+{
+    pthread_t threads[PROBE_THREADS];
+    // number of threads that were started
+    int thread_count;
+    // protects everything below
+    pthread_mutex_t lock;
+    // signalled when requests are queued or the prober stops
+    pthread_cond_t wake;
+    // requests waiting for a worker
+    struct ProbeQueue pending;
+    // exists requests that were answered
+    struct ProbeQueue completed;
+    // whether the workers should exit
+    bool stopping;
+};
+
+struct ImageProber image_prober = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+};
+
+// ProbeQueue_Push appends a request, failing when the ring is full
+static bool ProbeQueue_Push(struct ProbeQueue *queue, struct ProbeRequest *request)
+{
+    if (queue->count == PROBE_QUEUE_SIZE)
     {
-        log_error("No font path provided");
         return false;
     }
 
-    // check if the font path is valid
-    if (access(state->fonts.font_path, F_OK) == -1)
-    {
-        log_error("Invalid font path provided");
+    queue->requests[(queue->head + queue->count) % PROBE_QUEUE_SIZE] = *request;
+    queue->count++;
+    return true;
+}
+
+// ProbeQueue_Pop removes the oldest request, failing when the ring is empty
+static bool ProbeQueue_Pop(struct ProbeQueue *queue, struct ProbeRequest *request)
+{
+    if (queue->count == 0)
+    {
         return false;
     }
 
-    state->fonts.large = TTF_OpenFont(state->fonts.font_path, SCALE1(state->fonts.size));
-    if (state->fonts.large == NULL)
+    *request = queue->requests[queue->head];
+    queue->head = (queue->head + 1) % PROBE_QUEUE_SIZE;
+    queue->count--;
+    return true;
+}
+
+// probe_image answers a single request, without holding the prober lock
+static void probe_image(struct ProbeRequest *request)
+{
+    bool packed = strncmp(request->path, PACK_URI_PREFIX, strlen(PACK_URI_PREFIX)) == 0;
+    if (request->kind == ProbeKindExists)
     {
-        char buff[1024];
-        snprintf(buff, sizeof(buff), "Failed to open large font: %s", TTF_GetError());
-        log_error(buff);
-        return false;
+        request->exists = image_exists(request->path);
+        return;
     }
-    TTF_SetFontStyle(state->fonts.large, TTF_STYLE_BOLD);
 
-    state->fonts.small = TTF_OpenFont(state->fonts.font_path, SCALE1(FONT_SMALL));
-    if (state->fonts.small == NULL)
+    if (packed)
     {
-        char buff[1024];
-        snprintf(buff, sizeof(buff), "Failed to open small font: %s", TTF_GetError());
-        log_error(buff);
-        return false;
+        const struct PackEntry *entry = AssetPack_Find(&asset_pack, request->path + strlen(PACK_URI_PREFIX));
+        if (entry != NULL)
+        {
+            AssetPack_Readahead(&asset_pack, entry);
+        }
+        return;
     }
 
-    return true;
+    int fd = open(request->path, O_RDONLY);
+    if (fd == -1)
+    {
+        return;
+    }
+#ifdef POSIX_FADV_WILLNEED
+    posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+#endif
+    close(fd);
+}
+
+// ImageProber_Worker answers requests in batches until the prober stops
+static void *ImageProber_Worker(void *arg)
+{
+    struct ImageProber *prober = arg;
+    struct ProbeRequest batch[PROBE_QUEUE_SIZE / PROBE_THREADS];
+
+    pthread_mutex_lock(&prober->lock);
+    while (!prober->stopping)
+    {
+        size_t count = 0;
+        while (count < sizeof(batch) / sizeof(batch[0]) && ProbeQueue_Pop(&prober->pending, &batch[count]))
+        {
+            count++;
+        }
+
+        if (count == 0)
+        {
+            pthread_cond_wait(&prober->wake, &prober->lock);
+            continue;
+        }
+
+        pthread_mutex_unlock(&prober->lock);
+        for (size_t i = 0; i < count; i++)
+        {
+            probe_image(&batch[i]);
+        }
+        pthread_mutex_lock(&prober->lock);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            // answers that don't fit are dropped, the item is simply probed again
+            if (batch[i].kind != ProbeKindExists || !ProbeQueue_Push(&prober->completed, &batch[i]))
+            {
+                free(batch[i].path);
+            }
+        }
+    }
+    pthread_mutex_unlock(&prober->lock);
+    return NULL;
+}
+
+// ImageProber_Start starts the worker threads
+bool ImageProber_Start(struct ImageProber *prober)
+{
+    // signals are left to the main thread
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+
+    for (int i = 0; i < PROBE_THREADS; i++)
+    {
+        if (pthread_create(&prober->threads[i], NULL, ImageProber_Worker, prober) != 0)
+        {
+            break;
+        }
+        prober->thread_count++;
+    }
+
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    return prober->thread_count > 0;
+}
+
+// ImageProber_Stop stops the worker threads and drops outstanding requests
+void ImageProber_Stop(struct ImageProber *prober)
+{
+    pthread_mutex_lock(&prober->lock);
+    prober->stopping = true;
+    pthread_cond_broadcast(&prober->wake);
+    pthread_mutex_unlock(&prober->lock);
+
+    for (int i = 0; i < prober->thread_count; i++)
+    {
+        pthread_join(prober->threads[i], NULL);
+    }
+    prober->thread_count = 0;
+
+    struct ProbeRequest request;
+    while (ProbeQueue_Pop(&prober->pending, &request) || ProbeQueue_Pop(&prober->completed, &request))
+    {
+        free(request.path);
+    }
+}
+
+// ImageProber_Submit queues a batch of requests with a single wakeup
+// returns how many requests were queued, the path of dropped requests is set to NULL
+size_t ImageProber_Submit(struct ImageProber *prober, struct ProbeRequest *requests, size_t count)
+{
+    if (prober->thread_count == 0)
+    {
+        return 0;
+    }
+
+    size_t queued = 0;
+    pthread_mutex_lock(&prober->lock);
+    for (size_t i = 0; i < count; i++)
+    {
+        requests[i].path = strdup(requests[i].path);
+        if (requests[i].path == NULL || !ProbeQueue_Push(&prober->pending, &requests[i]))
+        {
+            free(requests[i].path);
+            requests[i].path = NULL;
+            continue;
+        }
+        queued++;
+    }
+    if (queued > 0)
+    {
+        pthread_cond_broadcast(&prober->wake);
+    }
+    pthread_mutex_unlock(&prober->lock);
+    return queued;
+}
+
+// ImageProber_Poll takes the next answered exists request, without blocking
+bool ImageProber_Poll(struct ImageProber *prober, struct ProbeRequest *request)
+{
+    pthread_mutex_lock(&prober->lock);
+    bool found = ProbeQueue_Pop(&prober->completed, request);
+    pthread_mutex_unlock(&prober->lock);
+    return found;
+}
+
+// every how many items the background loader hands them to the display
+#define PROGRESSIVE_BATCH 256
+
+// ItemsProgress parses the items on a thread while the display shows the
+// ones parsed so far, starting with the selected item (--progressive-load)
+// the display copies the published items and blocks only for items that
+// were not parsed yet
+struct ItemsProgress
+{
+    // the parsing thread
+    pthread_t thread;
+    // the display the items are parsed for, only its options are read
+    struct AppState *app;
+    // protects everything up to cancelled
+    pthread_mutex_t lock;
+    // signalled when items are published or parsing ended
+    pthread_cond_t changed;
+    // the state items are parsed into, owned by the thread until it is done
+    struct ItemsState *state;
+    // the items of state, replaced while they are reallocated
+    struct Item *items;
+    // number of items of state the display may copy
+    size_t count;
+    // the index of the item published first, from a "selected" seen before the items
+    size_t target;
+    // whether parsing ended
+    bool done;
+    // whether every item parsed
+    bool ok;
+    // whether the display ended and parsing should stop
+    bool cancelled;
+
+    // the selection the display started on, kept on the main thread
+    int initial;
+    // number of entries the items of the display have room for, kept on the main thread
+    size_t capacity;
+};
+
+// ItemsProgress_Parsed publishes the items parsed so far, the first time
+// once the target is parsed and then every PROGRESSIVE_BATCH items
+// it returns false when the display ended and parsing should stop
+static bool ItemsProgress_Parsed(struct ItemsProgress *progress, struct ItemsState *state)
+{
+    size_t count = state->item_count;
+    if (count != progress->target + 1 && count % PROGRESSIVE_BATCH != 0)
+    {
+        return true;
+    }
+
+    pthread_mutex_lock(&progress->lock);
+    if (count > progress->target)
+    {
+        progress->count = count;
+        pthread_cond_broadcast(&progress->changed);
+    }
+    bool cancelled = progress->cancelled;
+    pthread_mutex_unlock(&progress->lock);
+    return !cancelled;
+}
+
+// ItemsLoader holds the state needed while streaming items out of a JSON document
+struct ItemsLoader
+{
+    // the tokenizer reading the document
+    struct JsonReader reader;
+    // the state items are written into
+    struct ItemsState *state;
+    // the arena item strings are copied into
+    struct Arena *arena;
+    // the table item paths and colors are interned into
+    struct InternTable *strings;
+    // number of entries state->items (or state->offsets when indexing) has room for
+    size_t item_capacity;
+    // the key of the items array in the root object
+    const char *item_key;
+    // the values applied to items that do not set them
+    struct Item defaults;
+    // whether items are only indexed (lazy loading) instead of parsed
+    bool index_only;
+    // whether the document itself was malformed (as opposed to an invalid item)
+    bool syntax_error;
+    // hands the items to the display while they are parsed, NULL unless progressive
+    struct ItemsProgress *progress;
+};
+
+// ItemsLoader_Path interns a path, whether it exists is left to the ImageProber
+static const char *ItemsLoader_Path(struct ItemsLoader *loader, const char *path, size_t length)
+{
+    struct InternedString *entry = InternTable_Intern(loader->strings, loader->arena, path, length);
+    if (entry == NULL)
+    {
+        return NULL;
+    }
+
+    return entry->string;
 }
 
-void signal_handler(int signal)
+// parse_transition reads the name of a transition, returning false when it is unknown
+bool parse_transition(const char *name, enum TransitionKind *transition)
 {
-    // if the signal is a ctrl+c, exit with code 130
-    if (signal == SIGINT)
+    if (strcmp(name, "none") == 0)
     {
-        exit(ExitCodeKeyboardInterrupt);
+        *transition = TransitionKindNone;
     }
-    else if (signal == SIGTERM)
+    else if (strcmp(name, "fade") == 0)
     {
-        exit(ExitCodeSigterm);
+        *transition = TransitionKindFade;
     }
-    else if (signal == SIGUSR1)
+    else if (strcmp(name, "slide") == 0)
     {
-        increment_item_list_index = 1;
+        *transition = TransitionKindSlide;
     }
     else
     {
-        exit(ExitCodeError);
+        return false;
     }
+    return true;
 }
 
-// parse_arguments parses the arguments using getopt and updates the app state
-// supports the following flags:
-// - --action-button <button> (default: "")
-// - --action-text <text> (default: "ACTION")
-// - --action-show (default: false)
-// - --background-image <path> (default: empty string)
-// - --background-color <hex> (default: empty string)
-// - --confirm-button <button> (default: "A")
-// - --confirm-text <text> (default: "SELECT")
-// - --confirm-show (default: false)
-// - --cancel-button <button> (default: "B")
-// - --cancel-text <text> (default: "BACK")
-// - --cancel-show (default: false)
-// - --disable-auto-sleep (default: false)
-// - --inaction-button <button> (default: empty string)
-// - --inaction-text <text> (default: "OTHER")
-// - --inaction-show (default: false)
-// - --file <path> (default: empty string)
-// - --item-key <key> (default: "items")
-// - --message <message> (default: empty string)
-// - --message-alignment <alignment> (default: middle)
-// - --font <path> (default: empty string)
-// - --font-size <size> (default: FONT_LARGE)
-// - --quit-after-last-item (default: false)
-// - --show-hardware-group (default: false)
-// - --show-pill (default: false)
-// - --show-time-left (default: false)
-// - --timeout <seconds> (default: 1)
-bool parse_arguments(struct AppState *state, int argc, char *argv[])
+// ItemsLoader_ParseItem streams a single item object into item
+bool ItemsLoader_ParseItem(struct ItemsLoader *loader, size_t index, struct Item *item)
 {
-    static struct option long_options[] = {
-        {"action-button", required_argument, 0, 'a'},
-        {"action-text", required_argument, 0, 'A'},
-        {"background-image", required_argument, 0, 'b'},
-        {"background-color", required_argument, 0, 'B'},
-        {"confirm-button", required_argument, 0, 'c'},
-        {"confirm-text", required_argument, 0, 'C'},
-        {"cancel-button", required_argument, 0, 'd'},
-        {"cancel-text", required_argument, 0, 'D'},
-        {"inaction-button", required_argument, 0, 'i'},
-        {"inaction-text", required_argument, 0, 'I'},
-        {"file", required_argument, 0, 'E'},
-        {"font-default", required_argument, 0, 'f'},
-        {"font-size-default", required_argument, 0, 'F'},
-        {"item-key", required_argument, 0, 'K'},
-        {"message", required_argument, 0, 'm'},
-        {"message-alignment", required_argument, 0, 'M'},
-        {"quit-after-last-item", no_argument, 0, 'Q'},
-        {"show-pill", no_argument, 0, 'P'},
-        {"show-hardware-group", no_argument, 0, 'S'},
-        {"show-time-left", no_argument, 0, 'T'},
-        {"timeout", required_argument, 0, 't'},
-        {"disable-auto-sleep", no_argument, 0, 'U'},
-        {"confirm-show", no_argument, 0, 'W'},
-        {"cancel-show", no_argument, 0, 'X'},
-        {"action-show", no_argument, 0, 'Y'},
-        {"inaction-show", no_argument, 0, 'Z'},
-        {0, 0, 0, 0}};
+    struct JsonReader *reader = &loader->reader;
+    char buff[1024];
 
-    int opt;
-    char *font_path = NULL;
-    char message[1024];
-    char alignment[1024];
-    while ((opt = getopt_long(argc, argv, "a:A:b:B:c:C:d:D:E:f:F:i:I:K:m:M:t:QPSTUWYXZ", long_options, NULL)) != -1)
+    *item = loader->defaults;
+
+    int c = JsonReader_PeekToken(reader);
+    if (c != '{')
     {
-        switch (opt)
+        if (c < 0 || !JsonReader_SkipValue(reader, 1))
         {
-        case 'a':
-            strncpy(state->action_button, optarg, sizeof(state->action_button));
-            break;
-        case 'A':
-            strncpy(state->action_text, optarg, sizeof(state->action_text));
-            break;
-        case 'b':
-            strncpy(state->background_image, optarg, sizeof(state->background_image));
-            break;
-        case 'B':
-            strncpy(state->background_color, optarg, sizeof(state->background_color));
-            break;
-        case 'c':
-            strncpy(state->confirm_button, optarg, sizeof(state->confirm_button));
-            break;
-        case 'C':
-            strncpy(state->confirm_text, optarg, sizeof(state->confirm_text));
-            break;
-        case 'd':
-            strncpy(state->cancel_button, optarg, sizeof(state->cancel_button));
-            break;
-        case 'D':
-            strncpy(state->cancel_text, optarg, sizeof(state->cancel_text));
-            break;
-        case 'E':
-            strncpy(state->file, optarg, sizeof(state->file));
-            break;
-        case 'f':
-            font_path = optarg;
-            break;
-        case 'F':
-            state->fonts.size = atoi(optarg);
-            break;
-        case 'i':
-            strncpy(state->inaction_button, optarg, sizeof(state->inaction_button));
-            break;
-        case 'I':
-            strncpy(state->inaction_text, optarg, sizeof(state->inaction_text));
-            break;
-        case 'K':
-            strncpy(state->item_key, optarg, sizeof(state->item_key));
-            break;
-        case 'm':
-            strncpy(message, optarg, sizeof(message));
-            break;
-        case 'M':
-            strncpy(alignment, optarg, sizeof(alignment));
-            break;
-        case 'Q':
-            state->quit_after_last_item = true;
-            break;
-        case 'P':
-            state->show_pill = true;
-            break;
-        case 'S':
-            state->show_hardware_group = true;
-            break;
-        case 't':
-            state->timeout_seconds = atoi(optarg);
-            break;
-        case 'T':
-            state->show_time_left = true;
-            break;
-        case 'U':
-            state->disable_auto_sleep = true;
-            break;
-        case 'W':
-            state->confirm_show = true;
-            break;
-        case 'X':
-            state->cancel_show = true;
-            break;
-        case 'Y':
-            state->action_show = true;
-            break;
-        case 'Z':
-            state->inaction_show = true;
-            break;
-        default:
+            loader->syntax_error = true;
             return false;
         }
+
+        snprintf(buff, sizeof(buff), "Failed to get item %zu", index);
+        log_error(buff);
+        return false;
+    }
+    reader->position++;
+
+    size_t mark = JsonReader_BeginObject(reader);
+    bool first = true;
+    while (!JsonReader_Expect(reader, '}'))
+    {
+        if ((!first && !JsonReader_Expect(reader, ',')) || !JsonReader_ReadString(reader) || !JsonReader_AddKey(reader) || !JsonReader_Expect(reader, ':'))
+        {
+            loader->syntax_error = true;
+            return false;
+        }
+        first = false;
+
+        char key[32];
+        strncpy(key, reader->scratch, sizeof(key) - 1);
+        key[sizeof(key) - 1] = '\0';
+
+        bool is_string = JsonReader_PeekToken(reader) == '"';
+
+        if (strcmp(key, "text") == 0 && is_string)
+        {
+            if (!JsonReader_ReadString(reader))
+            {
+                loader->syntax_error = true;
+                return false;
+            }
+            item->text = Arena_StrNDup(loader->arena, reader->scratch, reader->scratch_length);
+        }
+        else if (strcmp(key, "id") == 0 && is_string)
+        {
+            if (!JsonReader_ReadString(reader))
+            {
+                loader->syntax_error = true;
+                return false;
+            }
+            item->id = Arena_StrNDup(loader->arena, reader->scratch, reader->scratch_length);
+        }
+        else if (strcmp(key, "background_image") == 0 && is_string)
+        {
+            if (!JsonReader_ReadString(reader))
+            {
+                loader->syntax_error = true;
+                return false;
+            }
+            item->background_image = (char *)ItemsLoader_Path(loader, reader->scratch, reader->scratch_length);
+        }
+        else if (strcmp(key, "progress") == 0 && is_string)
+        {
+            if (!JsonReader_ReadString(reader))
+            {
+                loader->syntax_error = true;
+                return false;
+            }
+            item->progress = (char *)ItemsLoader_Path(loader, reader->scratch, reader->scratch_length);
+        }
+        else if (strcmp(key, "background_color") == 0 && is_string)
+        {
+            if (!JsonReader_ReadString(reader))
+            {
+                loader->syntax_error = true;
+                return false;
+            }
+            struct InternedString *entry = InternTable_Intern(loader->strings, loader->arena, reader->scratch, reader->scratch_length);
+            item->background_color = entry != NULL ? (char *)entry->string : NULL;
+        }
+        else if (strcmp(key, "alignment") == 0 && is_string)
+        {
+            if (!JsonReader_ReadString(reader))
+            {
+                loader->syntax_error = true;
+                return false;
+            }
+
+            if (strcmp(reader->scratch, "top") == 0)
+            {
+                item->alignment = MessageAlignmentTop;
+            }
+            else if (strcmp(reader->scratch, "bottom") == 0)
+            {
+                item->alignment = MessageAlignmentBottom;
+            }
+            else if (strcmp(reader->scratch, "middle") == 0)
+            {
+                item->alignment = MessageAlignmentMiddle;
+            }
+            else
+            {
+                snprintf(buff, sizeof(buff), "Invalid alignment provided for item %zu", index);
+                log_error(buff);
+                return false;
+            }
+        }
+        else if (strcmp(key, "transition") == 0 && is_string)
+        {
+            if (!JsonReader_ReadString(reader))
+            {
+                loader->syntax_error = true;
+                return false;
+            }
+
+            if (!parse_transition(reader->scratch, &item->transition))
+            {
+                snprintf(buff, sizeof(buff), "Invalid transition provided for item %zu", index);
+                log_error(buff);
+                return false;
+            }
+            loader->state->transitions = true;
+        }
+        else if (strcmp(key, "duration") == 0)
+        {
+            c = JsonReader_PeekToken(reader);
+            double duration = -1;
+            if (c == '-' || isdigit(c) ? !JsonReader_ReadNumber(reader, &duration) : !JsonReader_SkipValue(reader, 1))
+            {
+                loader->syntax_error = true;
+                return false;
+            }
+
+            if (duration < 0 || duration > INT_MAX)
+            {
+                snprintf(buff, sizeof(buff), "Invalid duration provided for item %zu", index);
+                log_error(buff);
+                return false;
+            }
+            item->duration = (int)duration;
+            loader->state->durations = true;
+        }
+        else if (strcmp(key, "show_pill") == 0)
+        {
+            int value = JsonReader_PeekToken(reader) == 't' || JsonReader_PeekToken(reader) == 'f' || JsonReader_PeekToken(reader) == 'n' ? JsonReader_ReadLiteral(reader) : JSON_INVALID;
+            if (value == 1 || value == 0)
+            {
+                item->show_pill = value == 1;
+            }
+            else
+            {
+                if (value == JSON_INVALID && !JsonReader_SkipValue(reader, 1))
+                {
+                    loader->syntax_error = true;
+                    return false;
+                }
+
+                snprintf(buff, sizeof(buff), "Invalid show_pill value provided for item %zu", index);
+                log_error(buff);
+                return false;
+            }
+        }
+        else if (!JsonReader_SkipValue(reader, 1))
+        {
+            loader->syntax_error = true;
+            return false;
+        }
+    }
+    JsonReader_EndObject(reader, mark);
+
+    if (item->text == NULL)
+    {
+        snprintf(buff, sizeof(buff), "Failed to get text for item %zu", index);
+        log_error(buff);
+        return false;
+    }
+
+    return true;
+}
+
+// ItemsLoader_IndexItem records where an item starts and skips over it without parsing it
+static bool ItemsLoader_IndexItem(struct ItemsLoader *loader)
+{
+    struct JsonReader *reader = &loader->reader;
+    struct ItemsState *state = loader->state;
+
+    if (JsonReader_PeekToken(reader) < 0)
+    {
+        loader->syntax_error = true;
+        return false;
+    }
+
+    // only every ITEM_INDEX_STRIDE-th offset is kept, hydration skips forward from there
+    if (state->item_count % ITEM_INDEX_STRIDE == 0)
+    {
+        size_t slot = state->item_count / ITEM_INDEX_STRIDE;
+        if (slot == loader->item_capacity)
+        {
+            size_t capacity = loader->item_capacity == 0 ? 64 : loader->item_capacity * 2;
+            uint64_t *offsets = realloc(state->offsets, sizeof(uint64_t) * capacity);
+            if (offsets == NULL)
+            {
+                log_error("Failed to allocate items");
+                return false;
+            }
+            state->offsets = offsets;
+            loader->item_capacity = capacity;
+        }
+        state->offsets[slot] = JsonReader_Offset(reader);
+    }
+
+    if (!JsonReader_SkipValue(reader, 1))
+    {
+        loader->syntax_error = true;
+        return false;
+    }
+
+    return true;
+}
+
+// ItemsLoader_ParseItems streams every element of the items array into the state
+static bool ItemsLoader_ParseItems(struct ItemsLoader *loader)
+{
+    struct JsonReader *reader = &loader->reader;
+    struct ItemsState *state = loader->state;
+
+    if (JsonReader_Expect(reader, ']'))
+    {
+        return true;
+    }
+
+    for (;;)
+    {
+        if (loader->index_only)
+        {
+            if (!ItemsLoader_IndexItem(loader))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            if (state->item_count == loader->item_capacity)
+            {
+                // the display copies published items, so they can't move while it does
+                if (loader->progress != NULL)
+                {
+                    pthread_mutex_lock(&loader->progress->lock);
+                }
+                size_t capacity = loader->item_capacity == 0 ? 64 : loader->item_capacity * 2;
+                struct Item *items = realloc(state->items, sizeof(struct Item) * capacity);
+                if (items != NULL)
+                {
+                    state->items = items;
+                    loader->item_capacity = capacity;
+                    if (loader->progress != NULL)
+                    {
+                        loader->progress->items = items;
+                    }
+                }
+                if (loader->progress != NULL)
+                {
+                    pthread_mutex_unlock(&loader->progress->lock);
+                }
+                if (items == NULL)
+                {
+                    log_error("Failed to allocate items");
+                    return false;
+                }
+            }
+
+            if (!ItemsLoader_ParseItem(loader, state->item_count, &state->items[state->item_count]))
+            {
+                return false;
+            }
+        }
+        state->item_count++;
+
+        if (loader->progress != NULL && !ItemsProgress_Parsed(loader->progress, state))
+        {
+            return false;
+        }
+
+        if (JsonReader_Expect(reader, ']'))
+        {
+            return true;
+        }
+
+        if (!JsonReader_Expect(reader, ','))
+        {
+            loader->syntax_error = true;
+            return false;
+        }
+    }
+}
+
+// ItemsLoader_ParseRoot streams the root object, loading the items array and the selected index
+static bool ItemsLoader_ParseRoot(struct ItemsLoader *loader)
+{
+    struct JsonReader *reader = &loader->reader;
+    struct ItemsState *state = loader->state;
+
+    int c = JsonReader_PeekToken(reader);
+    if (c != '{')
+    {
+        loader->syntax_error = c < 0 || !JsonReader_SkipValue(reader, 0);
+        return false;
+    }
+    reader->position++;
+
+    size_t mark = JsonReader_BeginObject(reader);
+    bool found_items = false;
+    bool has_selected = false;
+    double selected = 0;
+    bool first = true;
+    while (!JsonReader_Expect(reader, '}'))
+    {
+        if ((!first && !JsonReader_Expect(reader, ',')) || !JsonReader_ReadString(reader) || !JsonReader_AddKey(reader) || !JsonReader_Expect(reader, ':'))
+        {
+            loader->syntax_error = true;
+            return false;
+        }
+        first = false;
+
+        if (strcmp(reader->scratch, loader->item_key) == 0)
+        {
+            found_items = true;
+
+            c = JsonReader_PeekToken(reader);
+            if (c != '[')
+            {
+                loader->syntax_error = c < 0 || !JsonReader_SkipValue(reader, 1);
+                return false;
+            }
+            reader->position++;
+
+            if (!ItemsLoader_ParseItems(loader))
+            {
+                return false;
+            }
+        }
+        else if (strcmp(reader->scratch, "selected") == 0)
+        {
+            has_selected = true;
+            c = JsonReader_PeekToken(reader);
+            if (c == '-' || isdigit(c))
+            {
+                if (!JsonReader_ReadNumber(reader, &selected))
+                {
+                    loader->syntax_error = true;
+                    return false;
+                }
+
+                // a selection known before the items is drawn as soon as it is parsed
+                if (loader->progress != NULL && !found_items)
+                {
+                    loader->progress->target = selected < 0 ? 0 : selected > INT_MAX ? INT_MAX : (size_t)selected;
+                }
+            }
+            else if (!JsonReader_SkipValue(reader, 1))
+            {
+                loader->syntax_error = true;
+                return false;
+            }
+        }
+        else if (!JsonReader_SkipValue(reader, 1))
+        {
+            loader->syntax_error = true;
+            return false;
+        }
+    }
+    JsonReader_EndObject(reader, mark);
+
+    if (!found_items || state->item_count == 0)
+    {
+        return false;
+    }
+
+    state->selected = 0;
+    if (has_selected)
+    {
+        if (selected < 0)
+        {
+            state->selected = 0;
+        }
+        else if (selected >= state->item_count)
+        {
+            state->selected = state->item_count - 1;
+        }
+        else
+        {
+            state->selected = selected;
+        }
+    }
+
+    return true;
+}
+
+// ItemsState_Current returns the selected item
+struct Item *ItemsState_Current(struct ItemsState *state)
+{
+    return &state->items[state->selected - state->window_start];
+}
+
+// ItemsState_ImagePath returns the background image of any item without
+// hydrating it, or NULL when it has none or is outside of the lazy window
+const char *ItemsState_ImagePath(struct ItemsState *state, size_t index)
+{
+    if (state->deck != NULL)
+    {
+        const struct DeckItem *entry = &state->deck_items[index];
+        if (entry->background_image == DECK_NO_STRING || entry->background_image >= state->deck_strings_size)
+        {
+            return NULL;
+        }
+        return state->deck_strings + entry->background_image;
+    }
+
+    if (index < state->window_start || index >= state->window_start + state->window_count)
+    {
+        return NULL;
+    }
+    return state->items[index - state->window_start].background_image;
+}
+
+// ItemsState_DeckItem fills in an item from its entry in a compiled deck,
+// returning false when the entry is invalid
+static bool ItemsState_DeckItem(struct ItemsState *state, size_t index, struct Item *item)
+{
+    const struct DeckItem *entry = &state->deck_items[index];
+    if (entry->text >= state->deck_strings_size || entry->background_image >= state->deck_strings_size || entry->progress >= state->deck_strings_size || entry->alignment > MessageAlignmentBottom || entry->transition > TransitionKindSlide || entry->duration < -1)
+    {
+        return false;
+    }
+
+    item->text = (char *)state->deck_strings + entry->text;
+    item->background_image = entry->background_image == DECK_NO_STRING ? NULL : (char *)state->deck_strings + entry->background_image;
+    item->progress = entry->progress == DECK_NO_STRING ? NULL : (char *)state->deck_strings + entry->progress;
+    item->id = NULL;
+    item->image_exists = false;
+    item->background_color = NULL;
+    item->background_rgb = entry->background_rgb;
+    item->show_pill = entry->show_pill;
+    item->alignment = entry->alignment;
+    item->transition = entry->transition;
+    item->duration = entry->duration;
+    return true;
+}
+
+// ItemsState_Peek copies out any item without hydrating it, returning
+// false when it is outside of the lazy window
+static bool ItemsState_Peek(struct ItemsState *state, size_t index, struct Item *item)
+{
+    if (state->deck != NULL)
+    {
+        return ItemsState_DeckItem(state, index, item);
+    }
+
+    if (index < state->window_start || index >= state->window_start + state->window_count)
+    {
+        return false;
+    }
+    *item = state->items[index - state->window_start];
+    return true;
+}
+
+// ItemsState_Hydrate makes sure the selected item is loaded, parsing the
+// window of items around it from the source when lazily loading
+bool ItemsState_Hydrate(struct ItemsState *state)
+{
+    if (!state->lazy && state->deck == NULL)
+    {
+        return true;
+    }
+
+    size_t selected = state->selected;
+    if (selected >= state->window_start && selected < state->window_start + state->window_count)
+    {
+        return true;
+    }
+
+    // deck items are used in place, only the pointers are filled in
+    if (state->deck != NULL)
+    {
+        if (!ItemsState_DeckItem(state, selected, &state->items[0]))
+        {
+            char buff[1024];
+            snprintf(buff, sizeof(buff), "Invalid deck entry for item %zu", selected);
+            log_error(buff);
+            return false;
+        }
+
+        state->window_start = selected;
+        state->window_count = 1;
+        return true;
+    }
+
+    // the window starts on an indexed item so a single seek reaches it
+    size_t start = selected > ITEM_WINDOW_SIZE / 2 ? selected - ITEM_WINDOW_SIZE / 2 : 0;
+    start -= start % ITEM_INDEX_STRIDE;
+    size_t count = state->item_count - start < ITEM_WINDOW_SIZE ? state->item_count - start : ITEM_WINDOW_SIZE;
+
+    // the previous window is dropped as a whole before the next one is parsed
+    state->window_count = 0;
+    InternTable_Free(&state->window_strings);
+    Arena_Free(&state->window_arena);
+
+    struct ItemsLoader loader = {
+        .state = state,
+        .arena = &state->window_arena,
+        .strings = &state->window_strings,
+        .defaults = state->defaults,
+    };
+    if (!JsonReader_InitFile(&loader.reader, state->source))
+    {
+        log_error("Failed to allocate items");
+        return false;
+    }
+
+    bool ok = JsonReader_Seek(&loader.reader, state->offsets[start / ITEM_INDEX_STRIDE]);
+    loader.syntax_error = !ok;
+    for (size_t i = 0; ok && i < count; i++)
+    {
+        if (i > 0 && !JsonReader_Expect(&loader.reader, ','))
+        {
+            loader.syntax_error = true;
+            ok = false;
+            break;
+        }
+        ok = ItemsLoader_ParseItem(&loader, start + i, &state->items[i]);
+    }
+
+    if (loader.syntax_error)
+    {
+        log_error("Failed to parse JSON file");
+    }
+    JsonReader_Free(&loader.reader);
+
+    if (!ok)
+    {
+        return false;
+    }
+
+    state->window_start = start;
+    state->window_count = count;
+    return true;
+}
+
+// ItemsState_Free releases the items and every string they reference in one go
+void ItemsState_Free(struct ItemsState *state)
+{
+    if (state == NULL)
+    {
+        return;
+    }
+
+    free(state->items);
+    free(state->offsets);
+    if (state->deck != NULL)
+    {
+        munmap(state->deck, state->deck_size);
+    }
+    if (state->source != NULL)
+    {
+        fclose(state->source);
+    }
+    InternTable_Free(&state->window_strings);
+    Arena_Free(&state->window_arena);
+    InternTable_Free(&state->strings);
+    Arena_Free(&state->arena);
+    free(state);
+}
+
+// ItemsState_NewMessage creates the single item state used by --message
+struct ItemsState *ItemsState_NewMessage(const char *message, const char *background_image, const char *background_color, bool show_pill, enum MessageAlignment alignment, const char *progress)
+{
+    struct ItemsState *state = calloc(1, sizeof(struct ItemsState));
+    if (state == NULL)
+    {
+        return NULL;
+    }
+
+    state->items = malloc(sizeof(struct Item));
+    if (state->items == NULL)
+    {
+        ItemsState_Free(state);
+        return NULL;
+    }
+
+    struct Item *item = &state->items[0];
+    item->text = Arena_StrNDup(&state->arena, message, strlen(message));
+    item->background_color = "#000000";
+    item->background_rgb = 0;
+    item->background_image = NULL;
+    item->image_exists = false;
+    item->show_pill = show_pill;
+    item->alignment = alignment;
+    item->progress = NULL;
+    item->id = NULL;
+    item->transition = TransitionKindDefault;
+    item->duration = -1;
+
+    if (strcmp(background_color, "") != 0)
+    {
+        item->background_color = Arena_StrNDup(&state->arena, background_color, strlen(background_color));
+    }
+
+    if (strcmp(background_image, "") != 0)
+    {
+        item->background_image = Arena_StrNDup(&state->arena, background_image, strlen(background_image));
+    }
+
+    if (strcmp(progress, "") != 0)
+    {
+        item->progress = Arena_StrNDup(&state->arena, progress, strlen(progress));
+    }
+
+    // items added by --follow look like the message unless they say otherwise
+    state->defaults = *item;
+    state->defaults.text = NULL;
+
+    state->item_count = 1;
+    state->window_count = 1;
+    state->selected = 0;
+    return state;
+}
+
+// ItemsState_NewDeck maps a compiled deck, only the header is checked up
+// front so opening a deck takes the same time regardless of its size
+struct ItemsState *ItemsState_NewDeck(int fd)
+{
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct DeckHeader))
+    {
+        log_error("Failed to read deck file");
+        return NULL;
+    }
+
+    void *deck = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (deck == MAP_FAILED)
+    {
+        log_error("Failed to read deck file");
+        return NULL;
+    }
+
+    const struct DeckHeader *header = deck;
+    size_t size = st.st_size;
+    bool valid = memcmp(header->magic, DECK_MAGIC, sizeof(header->magic)) == 0 &&
+                 header->byte_order == DECK_BYTE_ORDER;
+    // entries of other versions may have another size, so the version is
+    // checked before the item table is
+    if (valid && header->version != DECK_VERSION)
+    {
+        log_error("Unsupported deck version, recompile it with --compile");
+        munmap(deck, size);
+        return NULL;
+    }
+
+    valid = valid &&
+            header->item_count > 0 &&
+            header->selected < header->item_count &&
+            header->items_offset % sizeof(uint32_t) == 0 &&
+            header->items_offset <= size &&
+            header->item_count <= (size - header->items_offset) / sizeof(struct DeckItem) &&
+            header->strings_offset <= size &&
+            header->strings_size > 0 &&
+            header->strings_size <= size - header->strings_offset;
+
+    // a terminated pool means every in-bounds offset is a terminated string
+    const char *strings = (const char *)deck + (valid ? header->strings_offset : 0);
+    if (!valid || strings[header->strings_size - 1] != '\0')
+    {
+        log_error("Invalid deck file");
+        munmap(deck, size);
+        return NULL;
+    }
+
+    struct ItemsState *state = calloc(1, sizeof(struct ItemsState));
+    if (state == NULL || (state->items = malloc(sizeof(struct Item))) == NULL)
+    {
+        log_error("Failed to allocate items");
+        free(state);
+        munmap(deck, size);
+        return NULL;
+    }
+
+    state->deck = deck;
+    state->deck_size = size;
+    state->deck_items = (const struct DeckItem *)((const char *)deck + header->items_offset);
+    // entries aren't read up front, any of them may set a transition or duration
+    state->transitions = true;
+    state->durations = true;
+    state->deck_strings = strings;
+    state->deck_strings_size = header->strings_size;
+    state->item_count = header->item_count;
+    state->selected = header->selected;
+
+    if (!ItemsState_Hydrate(state))
+    {
+        ItemsState_Free(state);
+        return NULL;
+    }
+
+    return state;
+}
+
+// ItemsState_Load streams the items out of a JSON file (or stdin when filename is "-")
+// when lazy is set only an index of the items is built up front and items
+// are parsed a window at a time as the selection moves. when progress is set
+// the items are published to it while they are parsed, and a state that
+// failed is left to it instead of being freed, as the display may point into it
+static struct ItemsState *ItemsState_Load(const char *filename, const char *item_key, const char *default_background_image, const char *default_background_color, bool default_show_pill, enum MessageAlignment default_alignment, bool lazy, struct ItemsProgress *progress)
+{
+    bool use_stdin = strcmp(filename, "-") == 0;
+    FILE *file = use_stdin ? stdin : fopen(filename, "rb");
+    if (file == NULL)
+    {
+        log_error("Failed to parse JSON file");
+        return NULL;
+    }
+
+    // compiled decks are recognized by their magic bytes rather than their name
+    if (!use_stdin)
+    {
+        char magic[sizeof(((struct DeckHeader *)0)->magic)];
+        if (fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, DECK_MAGIC, sizeof(magic)) == 0)
+        {
+            struct ItemsState *state = ItemsState_NewDeck(fileno(file));
+            fclose(file);
+            return state;
+        }
+        rewind(file);
+    }
+
+    struct ItemsState *state = calloc(1, sizeof(struct ItemsState));
+    struct ItemsLoader loader = {
+        .state = state,
+        .item_key = item_key,
+        .index_only = lazy,
+        .progress = progress,
+        .defaults = {
+            .show_pill = default_show_pill,
+            .alignment = default_alignment,
+            .duration = -1,
+        },
+    };
+    if (state == NULL || !JsonReader_InitFile(&loader.reader, file))
+    {
+        log_error("Failed to allocate items");
+        free(state);
+        if (!use_stdin)
+        {
+            fclose(file);
+        }
+        return NULL;
+    }
+    loader.arena = &state->arena;
+    loader.strings = &state->strings;
+    if (progress != NULL)
+    {
+        progress->state = state;
+    }
+
+    bool ok = JsonReader_Open(&loader.reader);
+    if (!ok)
+    {
+        log_error("Failed to allocate items");
+    }
+
+    if (ok && lazy)
+    {
+        state->lazy = true;
+        // items are only indexed up front, any of them may set a transition or duration
+        state->transitions = true;
+        state->durations = true;
+        if (use_stdin || loader.reader.inflater != NULL)
+        {
+            // stdin can't be seeked and compressed input can't be seeked cheaply,
+            // so the inflated document is copied aside while it is indexed
+            state->source = tmpfile();
+            ok = state->source != NULL && JsonReader_SetSpool(&loader.reader, state->source);
+        }
+        else
+        {
+            state->source = file;
+        }
+    }
+
+    // defaults are interned up front so every item without an override shares them
+    if (ok && default_background_image != NULL && strcmp(default_background_image, "") != 0)
+    {
+        loader.defaults.background_image = (char *)ItemsLoader_Path(&loader, default_background_image, strlen(default_background_image));
+        ok = loader.defaults.background_image != NULL;
+    }
+
+    struct InternedString *color = ok ? InternTable_Intern(&state->strings, &state->arena, default_background_color, strlen(default_background_color)) : NULL;
+    loader.defaults.background_color = color != NULL ? (char *)color->string : NULL;
+    ok = ok && color != NULL;
+
+    if (ok && use_stdin && JsonReader_PeekToken(&loader.reader) == JSON_EOF)
+    {
+        log_error("Failed to read stdin");
+        ok = false;
+    }
+    else if (ok && !ItemsLoader_ParseRoot(&loader))
+    {
+        if (loader.syntax_error)
+        {
+            log_error("Failed to parse JSON file");
+        }
+        ok = false;
+    }
+
+    JsonReader_Free(&loader.reader);
+    if (!use_stdin && state->source != file)
+    {
+        fclose(file);
+    }
+
+    // kept for items parsed later, lazily or from --follow
+    state->defaults = loader.defaults;
+
+    if (ok && lazy)
+    {
+        state->items = malloc(sizeof(struct Item) * ITEM_WINDOW_SIZE);
+        if (state->items == NULL)
+        {
+            log_error("Failed to allocate items");
+            ok = false;
+        }
+        else if (state->source != NULL && fflush(state->source) != 0)
+        {
+            log_error("Failed to read stdin");
+            ok = false;
+        }
+        else
+        {
+            ok = ItemsState_Hydrate(state);
+        }
+    }
+    else if (ok)
+    {
+        state->window_count = state->item_count;
+    }
+
+    if (!ok)
+    {
+        if (progress == NULL)
+        {
+            ItemsState_Free(state);
+        }
+        return NULL;
+    }
+
+    return state;
+}
+
+// ItemsState_New streams the items out of a JSON file (or stdin when filename is "-")
+// when lazy is set only an index of the items is built up front and items
+// are parsed a window at a time as the selection moves
+struct ItemsState *ItemsState_New(const char *filename, const char *item_key, const char *default_background_image, const char *default_background_color, bool default_show_pill, enum MessageAlignment default_alignment, bool lazy)
+{
+    return ItemsState_Load(filename, item_key, default_background_image, default_background_color, default_show_pill, default_alignment, lazy, NULL);
+}
+
+// the most threads a --recursive --directory walk reads directories on
+#define DIRECTORY_MAX_WORKERS 4
+// the files --directory shows unless --directory-filter sets others
+#define DIRECTORY_DEFAULT_FILTER "*.png,*.jpg,*.jpeg,*.bmp,*.gif,*.webp"
+
+// DirectoryScan walks the directory of --directory for images. with
+// --recursive the subdirectories are read by a pool of threads, each keeping
+// the paths it found to itself, so the threads only meet to hand out directories
+struct DirectoryScan
+{
+    // the directory being walked, without a trailing slash
+    const char *root;
+    // comma separated patterns, file names have to match one of them
+    const char *filter;
+    // whether subdirectories are walked too
+    bool recursive;
+    // guards the fields below
+    pthread_mutex_t lock;
+    // signalled when directories are handed out or a thread finished reading one
+    pthread_cond_t changed;
+    // the directories left to read, relative to root ("" for root itself)
+    char **pending;
+    // number of directories left to read
+    size_t pending_count;
+    // number of slots allocated in pending
+    size_t pending_capacity;
+    // number of threads reading a directory, which may hand out more
+    int busy;
+    // whether the walk ran out of memory or couldn't read root
+    bool failed;
+};
+
+// DirectoryWorker is a thread of a DirectoryScan and the paths it found
+struct DirectoryWorker
+{
+    // the thread, unused for the worker run by the caller
+    pthread_t thread;
+    // the walk the worker takes part in
+    struct DirectoryScan *scan;
+    // the files found, relative to the root of the walk
+    char **paths;
+    // number of files found
+    size_t path_count;
+    // number of slots allocated in paths
+    size_t path_capacity;
+    // owns the paths found, including those of the directories handed out
+    struct Arena arena;
+};
+
+// push_string appends a string to a growable array of strings
+static bool push_string(char ***strings, size_t *count, size_t *capacity, char *string)
+{
+    if (*count == *capacity)
+    {
+        size_t grown = *capacity == 0 ? 256 : *capacity * 2;
+        char **resized = realloc(*strings, sizeof(char *) * grown);
+        if (resized == NULL)
+        {
+            return false;
+        }
+        *strings = resized;
+        *capacity = grown;
+    }
+
+    (*strings)[(*count)++] = string;
+    return true;
+}
+
+// directory_matches returns whether a file name matches one of the comma
+// separated patterns of a filter. both are lowercased first, so the default
+// filter matches IMG_0001.JPG too
+static bool directory_matches(const char *filter, const char *name)
+{
+    char lowered[NAME_MAX + 1];
+    size_t name_length = 0;
+    for (; name[name_length] != '\0' && name_length < sizeof(lowered) - 1; name_length++)
+    {
+        lowered[name_length] = tolower((unsigned char)name[name_length]);
+    }
+    lowered[name_length] = '\0';
+
+    char pattern[256];
+    while (*filter != '\0')
+    {
+        size_t length = strcspn(filter, ",");
+        if (length > 0 && length < sizeof(pattern))
+        {
+            for (size_t i = 0; i < length; i++)
+            {
+                pattern[i] = tolower((unsigned char)filter[i]);
+            }
+            pattern[length] = '\0';
+            if (fnmatch(pattern, lowered, 0) == 0)
+            {
+                return true;
+            }
+        }
+
+        filter += length;
+        if (*filter == ',')
+        {
+            filter++;
+        }
+    }
+    return false;
+}
+
+// DirectoryWorker_Read reads a single directory, keeping the files that match
+// the filter and handing the subdirectories out to the other threads. types
+// come from the directory entries, files are only stat'ed on file systems
+// that don't report them
+static void DirectoryWorker_Read(struct DirectoryWorker *worker, const char *directory)
+{
+    struct DirectoryScan *scan = worker->scan;
+    char path[PATH_MAX];
+    if (directory[0] == '\0')
+    {
+        snprintf(path, sizeof(path), "%s", scan->root[0] != '\0' ? scan->root : "/");
+    }
+    else
+    {
+        snprintf(path, sizeof(path), "%s/%s", scan->root, directory);
+    }
+
+    DIR *dir = opendir(path);
+    if (dir == NULL)
+    {
+        char buff[1024];
+        snprintf(buff, sizeof(buff), "Failed to read directory: %s", path);
+        log_error(buff);
+        if (directory[0] == '\0')
+        {
+            pthread_mutex_lock(&scan->lock);
+            scan->failed = true;
+            pthread_mutex_unlock(&scan->lock);
+        }
+        return;
+    }
+
+    char **found = NULL;
+    size_t found_count = 0;
+    size_t found_capacity = 0;
+    bool ok = true;
+    struct dirent *entry;
+    while (ok && (entry = readdir(dir)) != NULL)
+    {
+        // hidden files are left out, along with . and ..
+        const char *name = entry->d_name;
+        if (name[0] == '.')
+        {
+            continue;
+        }
+
+        bool is_directory = entry->d_type == DT_DIR;
+        bool is_file = entry->d_type == DT_REG;
+        if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK)
+        {
+            // links to images are followed, links to directories aren't, so
+            // the walk can't loop
+            struct stat st;
+            if (fstatat(dirfd(dir), name, &st, 0) != 0)
+            {
+                continue;
+            }
+            is_file = S_ISREG(st.st_mode);
+            is_directory = S_ISDIR(st.st_mode) && entry->d_type == DT_UNKNOWN;
+        }
+
+        if (!(is_directory && scan->recursive) && !(is_file && directory_matches(scan->filter, name)))
+        {
+            continue;
+        }
+
+        char relative[PATH_MAX];
+        int length = directory[0] == '\0' ? snprintf(relative, sizeof(relative), "%s", name) : snprintf(relative, sizeof(relative), "%s/%s", directory, name);
+        if (length < 0 || (size_t)length >= sizeof(relative))
+        {
+            continue;
+        }
+
+        char *copy = Arena_StrNDup(&worker->arena, relative, length);
+        ok = copy != NULL && (is_directory ? push_string(&found, &found_count, &found_capacity, copy) : push_string(&worker->paths, &worker->path_count, &worker->path_capacity, copy));
+    }
+    closedir(dir);
+
+    pthread_mutex_lock(&scan->lock);
+    for (size_t i = 0; ok && i < found_count; i++)
+    {
+        ok = push_string(&scan->pending, &scan->pending_count, &scan->pending_capacity, found[i]);
+    }
+    if (!ok)
+    {
+        log_error("Failed to allocate items");
+        scan->failed = true;
+    }
+    pthread_cond_broadcast(&scan->changed);
+    pthread_mutex_unlock(&scan->lock);
+    free(found);
+}
+
+// DirectoryWorker_Main takes directories to read until none are left and
+// no thread is reading one that may hand out more
+static void *DirectoryWorker_Main(void *arg)
+{
+    struct DirectoryWorker *worker = arg;
+    struct DirectoryScan *scan = worker->scan;
+
+    pthread_mutex_lock(&scan->lock);
+    for (;;)
+    {
+        while (scan->pending_count == 0 && scan->busy > 0 && !scan->failed)
+        {
+            pthread_cond_wait(&scan->changed, &scan->lock);
+        }
+        if (scan->pending_count == 0 || scan->failed)
+        {
+            break;
+        }
+
+        char *directory = scan->pending[--scan->pending_count];
+        scan->busy++;
+        pthread_mutex_unlock(&scan->lock);
+
+        DirectoryWorker_Read(worker, directory);
+
+        pthread_mutex_lock(&scan->lock);
+        scan->busy--;
+        pthread_cond_broadcast(&scan->changed);
+    }
+    pthread_mutex_unlock(&scan->lock);
+    return NULL;
+}
+
+// natural_compare orders strings the way people count, so "2.png" comes
+// before "10.png", ignoring case and leading zeros
+int natural_compare(const char *a, const char *b)
+{
+    while (*a != '\0' && *b != '\0')
+    {
+        if (isdigit((unsigned char)*a) && isdigit((unsigned char)*b))
+        {
+            while (*a == '0')
+            {
+                a++;
+            }
+            while (*b == '0')
+            {
+                b++;
+            }
+
+            // the number with more digits is the larger one
+            size_t a_digits = 0;
+            size_t b_digits = 0;
+            while (isdigit((unsigned char)a[a_digits]))
+            {
+                a_digits++;
+            }
+            while (isdigit((unsigned char)b[b_digits]))
+            {
+                b_digits++;
+            }
+            if (a_digits != b_digits)
+            {
+                return a_digits < b_digits ? -1 : 1;
+            }
+
+            int order = strncmp(a, b, a_digits);
+            if (order != 0)
+            {
+                return order;
+            }
+            a += a_digits;
+            b += b_digits;
+            continue;
+        }
+
+        int a_lower = tolower((unsigned char)*a);
+        int b_lower = tolower((unsigned char)*b);
+        if (a_lower != b_lower)
+        {
+            return a_lower < b_lower ? -1 : 1;
+        }
+        a++;
+        b++;
+    }
+
+    return *a == '\0' ? (*b == '\0' ? 0 : -1) : 1;
+}
+
+// compare_paths orders the paths found by a DirectoryScan for qsort, paths
+// that only differ in case or leading zeros keep a stable order
+static int compare_paths(const void *a, const void *b)
+{
+    const char *a_path = *(char *const *)a;
+    const char *b_path = *(char *const *)b;
+    int order = natural_compare(a_path, b_path);
+    return order != 0 ? order : strcmp(a_path, b_path);
+}
+
+// ItemsState_NewDirectory creates an item for every image in a directory
+// (--directory), in natural order, with the path of the image relative to
+// the directory as its text. only the directory entries are read, whether
+// the images exist and their contents are left to the image pipeline, the
+// same as for the images of --file
+struct ItemsState *ItemsState_NewDirectory(const char *directory, const char *filter, bool recursive, const char *background_color, bool show_pill, enum MessageAlignment alignment)
+{
+    char root[PATH_MAX];
+    snprintf(root, sizeof(root), "%s", directory);
+    size_t root_length = strlen(root);
+    while (root_length > 0 && root[root_length - 1] == '/')
+    {
+        root[--root_length] = '\0';
+    }
+
+    struct DirectoryScan scan = {
+        .root = root,
+        .filter = filter[0] != '\0' ? filter : DIRECTORY_DEFAULT_FILTER,
+        .recursive = recursive,
+    };
+    pthread_mutex_init(&scan.lock, NULL);
+    pthread_cond_init(&scan.changed, NULL);
+
+    int worker_count = 1;
+    if (recursive)
+    {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        worker_count = cores < 1 ? 1 : cores > DIRECTORY_MAX_WORKERS ? DIRECTORY_MAX_WORKERS : (int)cores;
+    }
+
+    struct DirectoryWorker *workers = calloc(worker_count, sizeof(struct DirectoryWorker));
+    bool ok = workers != NULL && push_string(&scan.pending, &scan.pending_count, &scan.pending_capacity, (char *)"");
+    if (!ok)
+    {
+        log_error("Failed to allocate items");
+    }
+
+    // the calling thread reads directories too, the others join it as they start
+    int started = 1;
+    if (ok)
+    {
+        sigset_t all, previous;
+        sigfillset(&all);
+        pthread_sigmask(SIG_SETMASK, &all, &previous);
+        for (int i = 0; i < worker_count; i++)
+        {
+            workers[i].scan = &scan;
+        }
+        for (int i = 1; i < worker_count; i++)
+        {
+            if (pthread_create(&workers[i].thread, NULL, DirectoryWorker_Main, &workers[i]) != 0)
+            {
+                break;
+            }
+            started++;
+        }
+        pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+        DirectoryWorker_Main(&workers[0]);
+        for (int i = 1; i < started; i++)
+        {
+            pthread_join(workers[i].thread, NULL);
+        }
+        ok = !scan.failed;
+    }
+
+    size_t count = 0;
+    for (int i = 0; ok && i < started; i++)
+    {
+        count += workers[i].path_count;
+    }
+    if (ok && count == 0)
+    {
+        log_error("No images found in directory");
+        ok = false;
+    }
+
+    char **paths = ok ? malloc(sizeof(char *) * count) : NULL;
+    struct ItemsState *state = ok ? calloc(1, sizeof(struct ItemsState)) : NULL;
+    if (ok && (paths == NULL || state == NULL || (state->items = malloc(sizeof(struct Item) * count)) == NULL))
+    {
+        log_error("Failed to allocate items");
+        ok = false;
+    }
+
+    if (ok)
+    {
+        size_t merged = 0;
+        for (int i = 0; i < started; i++)
+        {
+            memcpy(paths + merged, workers[i].paths, sizeof(char *) * workers[i].path_count);
+            merged += workers[i].path_count;
+        }
+        qsort(paths, count, sizeof(char *), compare_paths);
+
+        struct Item defaults = {
+            .background_color = "#000000",
+            .show_pill = show_pill,
+            .alignment = alignment,
+            .transition = TransitionKindDefault,
+            .duration = -1,
+        };
+        if (strcmp(background_color, "") != 0)
+        {
+            defaults.background_color = Arena_StrNDup(&state->arena, background_color, strlen(background_color));
+            ok = defaults.background_color != NULL;
+        }
+
+        // the text is the tail of the image path, so each item is a single string
+        for (size_t i = 0; ok && i < count; i++)
+        {
+            size_t length = strlen(paths[i]);
+            char *path = Arena_Alloc(&state->arena, root_length + 1 + length + 1);
+            if (path == NULL)
+            {
+                log_error("Failed to allocate items");
+                ok = false;
+                break;
+            }
+            memcpy(path, root, root_length);
+            path[root_length] = '/';
+            memcpy(path + root_length + 1, paths[i], length + 1);
+
+            struct Item *item = &state->items[i];
+            *item = defaults;
+            item->background_image = path;
+            item->text = path + root_length + 1;
+        }
+
+        // items added by --follow look like the images unless they say otherwise
+        state->defaults = defaults;
+        state->item_count = count;
+        state->window_count = count;
+        state->selected = 0;
+    }
+
+    for (int i = 0; workers != NULL && i < worker_count; i++)
+    {
+        free(workers[i].paths);
+        Arena_Free(&workers[i].arena);
+    }
+    free(workers);
+    free(paths);
+    free(scan.pending);
+    pthread_mutex_destroy(&scan.lock);
+    pthread_cond_destroy(&scan.changed);
+
+    if (!ok)
+    {
+        ItemsState_Free(state);
+        return NULL;
+    }
+    return state;
+}
+
+// ItemsProgress_Thread is the body of the parsing thread
+static void *ItemsProgress_Thread(void *arg)
+{
+    struct ItemsProgress *progress = arg;
+    struct AppState *app = progress->app;
+    struct ItemsState *state = ItemsState_Load(app->file, app->item_key, app->background_image, app->background_color, app->show_pill, app->alignment, false, progress);
+
+    pthread_mutex_lock(&progress->lock);
+    if (state != NULL)
+    {
+        progress->state = state;
+    }
+    else if (!progress->cancelled)
+    {
+        log_error("Failed to hydrate display states");
+    }
+    progress->ok = state != NULL;
+    progress->done = true;
+    pthread_cond_broadcast(&progress->changed);
+    pthread_mutex_unlock(&progress->lock);
+    return NULL;
+}
+
+// ItemsProgress_Free releases the loader of a display, stopping and waiting
+// for its thread. the parsed items are released too unless they were taken
+void ItemsProgress_Free(struct AppState *app)
+{
+    struct ItemsProgress *progress = app->items_progress;
+    if (progress == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&progress->lock);
+    progress->cancelled = true;
+    pthread_mutex_unlock(&progress->lock);
+    pthread_join(progress->thread, NULL);
+
+    ItemsState_Free(progress->state);
+    pthread_mutex_destroy(&progress->lock);
+    pthread_cond_destroy(&progress->changed);
+    free(progress);
+    app->items_progress = NULL;
+}
+
+// ItemsProgress_Finish switches the display to the items once every one parsed
+static void ItemsProgress_Finish(struct AppState *app)
+{
+    struct ItemsProgress *progress = app->items_progress;
+    struct ItemsState *state = progress->state;
+    struct ItemsState *view = app->items_state;
+    if (view != NULL)
+    {
+        for (size_t i = 0; i < view->item_count; i++)
+        {
+            state->items[i].image_exists = view->items[i].image_exists;
+        }
+
+        // a "selected" that came after the items only applies if the display didn't move yet
+        if (view->selected != progress->initial)
+        {
+            state->selected = view->selected;
+        }
+        if (state->selected != view->selected)
+        {
+            app->redraw = 1;
+            app->readahead_item = -1;
+        }
+        ItemsState_Free(view);
+    }
+
+    app->items_state = state;
+    progress->state = NULL;
+    ItemsProgress_Free(app);
+}
+
+// ItemsProgress_Wait copies the items published since the last call into the
+// display, first blocking until the item at index parsed or parsing ended
+// (SIZE_MAX waits for every item). once it ended the display switches to the
+// parsed items, or quits with the same exit code as a file that failed up front
+void ItemsProgress_Wait(struct AppState *app, size_t index)
+{
+    struct ItemsProgress *progress = app->items_progress;
+    if (progress == NULL)
+    {
+        return;
+    }
+
+    struct ItemsState *view = app->items_state;
+    pthread_mutex_lock(&progress->lock);
+    while (!progress->done && progress->count <= index)
+    {
+        pthread_cond_wait(&progress->changed, &progress->lock);
+    }
+
+    bool done = progress->done;
+    bool ok = progress->ok;
+    size_t count = progress->count;
+    if (!done && count > progress->capacity)
+    {
+        size_t capacity = progress->capacity * 2 > count ? progress->capacity * 2 : count;
+        struct Item *items = realloc(view->items, sizeof(struct Item) * capacity);
+        if (items != NULL)
+        {
+            view->items = items;
+            progress->capacity = capacity;
+        }
+        else
+        {
+            // the display goes on with the items it has and tries again next time
+            count = view->item_count;
+        }
+    }
+    if (!done && count > view->item_count)
+    {
+        memcpy(view->items + view->item_count, progress->items + view->item_count, sizeof(struct Item) * (count - view->item_count));
+        for (size_t i = view->item_count; i < count; i++)
+        {
+            view->transitions = view->transitions || view->items[i].transition != TransitionKindDefault;
+            view->durations = view->durations || view->items[i].duration != -1;
+        }
+        view->item_count = count;
+        view->window_count = count;
+    }
+    pthread_mutex_unlock(&progress->lock);
+
+    if (done && ok)
+    {
+        ItemsProgress_Finish(app);
+    }
+    else if (done)
+    {
+        // the items displayed so far point into the failed state, which is
+        // only released once the display ended
+        app->redraw = 0;
+        app->quitting = 1;
+        app->exit_code = ExitCodeError;
+    }
+}
+
+// ItemsProgress_Start starts parsing the items of --file on a thread and
+// waits until the selected item parsed, displaying the items parsed so far
+// while the rest are. a "selected" that comes after the items can't be known
+// that early, so the first item is displayed until then
+bool ItemsProgress_Start(struct AppState *app)
+{
+    struct ItemsProgress *progress = calloc(1, sizeof(struct ItemsProgress));
+    if (progress == NULL)
+    {
+        log_error("Failed to allocate items");
+        return false;
+    }
+    pthread_mutex_init(&progress->lock, NULL);
+    pthread_cond_init(&progress->changed, NULL);
+    progress->app = app;
+
+    // signals are left to the main thread
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    bool started = pthread_create(&progress->thread, NULL, ItemsProgress_Thread, progress) == 0;
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+    if (!started)
+    {
+        log_error("Failed to start loader thread, loading every item first");
+        pthread_mutex_destroy(&progress->lock);
+        pthread_cond_destroy(&progress->changed);
+        free(progress);
+        app->items_state = ItemsState_New(app->file, app->item_key, app->background_image, app->background_color, app->show_pill, app->alignment, false);
+        if (app->items_state == NULL)
+        {
+            log_error("Failed to hydrate display states");
+            return false;
+        }
+        return true;
+    }
+    app->items_progress = progress;
+
+    pthread_mutex_lock(&progress->lock);
+    while (!progress->done && progress->count == 0)
+    {
+        pthread_cond_wait(&progress->changed, &progress->lock);
+    }
+
+    bool done = progress->done;
+    struct ItemsState *view = done ? NULL : calloc(1, sizeof(struct ItemsState));
+    if (view != NULL)
+    {
+        view->items = malloc(sizeof(struct Item) * progress->count);
+        if (view->items != NULL)
+        {
+            memcpy(view->items, progress->items, sizeof(struct Item) * progress->count);
+            view->item_count = progress->count;
+            view->window_count = progress->count;
+            view->selected = (int)progress->target;
+            progress->initial = view->selected;
+            progress->capacity = progress->count;
+        }
+    }
+    pthread_mutex_unlock(&progress->lock);
+
+    if (done)
+    {
+        if (!progress->ok)
+        {
+            ItemsProgress_Free(app);
+            return false;
+        }
+        ItemsProgress_Finish(app);
+        return true;
+    }
+
+    if (view == NULL || view->items == NULL)
+    {
+        log_error("Failed to allocate items");
+        free(view);
+        ItemsProgress_Free(app);
+        return false;
+    }
+
+    app->items_state = view;
+    return true;
+}
+
+// probe_images hands image metadata checks to the ImageProber and applies
+// its answers, redrawing once the image of the selected item shows up
+void probe_images(struct AppState *state)
+{
+    struct ItemsState *items_state = state->items_state;
+
+    struct ProbeRequest result;
+    while (ImageProber_Poll(&image_prober, &result))
+    {
+        if (result.item == (size_t)state->probe_item)
+        {
+            state->probe_item = -1;
+        }
+
+        if (result.exists && result.item == (size_t)items_state->selected)
+        {
+            struct Item *item = ItemsState_Current(items_state);
+            if (!item->image_exists && item->background_image != NULL && strcmp(item->background_image, result.path) == 0)
+            {
+                item->image_exists = true;
+                state->redraw = 1;
+            }
+        }
+        free(result.path);
+    }
+
+    struct ProbeRequest requests[PROBE_READAHEAD_ITEMS + 2];
+    size_t count = 0;
+
+    // a missing image is checked again until it appears
+    struct Item *item = ItemsState_Current(items_state);
+    if (image_prober.thread_count == 0)
+    {
+        // without workers the check happens inline, as it always used to
+        if (!item->image_exists && item->background_image != NULL && image_exists(item->background_image))
+        {
+            item->image_exists = true;
+            state->redraw = 1;
+        }
+        return;
+    }
+
+    if (!item->image_exists && item->background_image != NULL && state->probe_item != items_state->selected)
+    {
+        requests[count++] = (struct ProbeRequest){.kind = ProbeKindExists, .item = items_state->selected, .path = item->background_image};
+    }
+
+    // read ahead the images the user is most likely to navigate to next
+    if (state->readahead_item != items_state->selected)
+    {
+        state->readahead_item = items_state->selected;
+        size_t total = items_state->item_count;
+        for (size_t i = 1; i <= PROBE_READAHEAD_ITEMS + 1 && i < total; i++)
+        {
+            size_t index = i <= PROBE_READAHEAD_ITEMS ? (items_state->selected + i) % total : (items_state->selected + total - 1) % total;
+            const char *path = ItemsState_ImagePath(items_state, index);
+            if (path != NULL)
+            {
+                requests[count++] = (struct ProbeRequest){.kind = ProbeKindReadahead, .item = index, .path = (char *)path};
+            }
+        }
+    }
+
+    if (count > 0 && ImageProber_Submit(&image_prober, requests, count) > 0)
+    {
+        if (requests[0].kind == ProbeKindExists && requests[0].path != NULL)
+        {
+            state->probe_item = items_state->selected;
+        }
+    }
+}
+
+// number of commands that can be queued between two frames, a power of two
+#define COMMAND_QUEUE_SIZE 256
+
+// CommandKind is what a queued command does
+enum CommandKind
+{
+    // move the selection by value items, wrapping around
+    CommandMove,
+    // select the item at index value
+    CommandSelect,
+    // reload the items from --file
+    CommandReload,
+};
+
+// Command is a single request to change the display, from any control source
+struct Command
+{
+    // what the command does
+    enum CommandKind kind;
+    // the argument of the command
+    int value;
+};
+
+// CommandSlot is a single entry of a CommandQueue
+struct CommandSlot
+{
+    // equals the position the slot is written at next while free, and
+    // that position + 1 once the command in it can be read
+    _Atomic size_t sequence;
+    // the queued command
+    struct Command command;
+};
+
+// CommandQueue is a bounded lock-free queue with many producers, including
+// signal handlers interrupting the main loop, and the main loop as its only
+// consumer, so commands are never lost to a flag being set twice
+struct CommandQueue
+{
+    // the slots, used as a ring
+    struct CommandSlot slots[COMMAND_QUEUE_SIZE];
+    // the position the next command is written at
+    _Atomic size_t head;
+    // the position the next command is read from, only used by the consumer
+    size_t tail;
+    // number of commands dropped because the queue was full
+    _Atomic unsigned int dropped;
+};
+
+// the commands every control source sends to the display
+struct CommandQueue command_queue;
+
+// whether the display loop is running and picks up exit_signal_code
+static volatile sig_atomic_t display_running = 0;
+// the exit code a signal asked the display to quit with, 0 for none
+static volatile sig_atomic_t exit_signal_code = 0;
+
+// CommandQueue_Init empties the queue
+void CommandQueue_Init(struct CommandQueue *queue)
+{
+    for (size_t i = 0; i < COMMAND_QUEUE_SIZE; i++)
+    {
+        atomic_init(&queue->slots[i].sequence, i);
+    }
+    atomic_init(&queue->head, 0);
+    queue->tail = 0;
+    atomic_init(&queue->dropped, 0);
+}
+
+// CommandQueue_Push queues a command without locking or allocating, so it
+// is safe to call from signal handlers. returns false when the queue is full
+bool CommandQueue_Push(struct CommandQueue *queue, enum CommandKind kind, int value)
+{
+    size_t position = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    for (;;)
+    {
+        struct CommandSlot *slot = &queue->slots[position & (COMMAND_QUEUE_SIZE - 1)];
+        size_t sequence = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+        if (sequence == position)
+        {
+            // claim the slot, then publish the command written into it
+            if (atomic_compare_exchange_weak_explicit(&queue->head, &position, position + 1, memory_order_relaxed, memory_order_relaxed))
+            {
+                slot->command = (struct Command){.kind = kind, .value = value};
+                atomic_store_explicit(&slot->sequence, position + 1, memory_order_release);
+                return true;
+            }
+        }
+        else if ((intptr_t)(sequence - position) < 0)
+        {
+            atomic_fetch_add_explicit(&queue->dropped, 1, memory_order_relaxed);
+            return false;
+        }
+        else
+        {
+            position = atomic_load_explicit(&queue->head, memory_order_relaxed);
+        }
+    }
+}
+
+// CommandQueue_Pop takes the oldest published command, returning false
+// when there is none. only the main loop may call it
+bool CommandQueue_Pop(struct CommandQueue *queue, struct Command *command)
+{
+    struct CommandSlot *slot = &queue->slots[queue->tail & (COMMAND_QUEUE_SIZE - 1)];
+    if (atomic_load_explicit(&slot->sequence, memory_order_acquire) != queue->tail + 1)
+    {
+        return false;
+    }
+
+    *command = slot->command;
+    atomic_store_explicit(&slot->sequence, queue->tail + COMMAND_QUEUE_SIZE, memory_order_release);
+    queue->tail++;
+    return true;
+}
+
+// FrameCache_Init sizes the cache to the frames of the screen that fit in megabytes
+void FrameCache_Init(struct FrameCache *cache, int megabytes, SDL_Surface *screen)
+{
+    size_t frame_size = (size_t)screen->pitch * screen->h;
+    size_t frames = frame_size > 0 ? (size_t)megabytes * 1024 * 1024 / frame_size : 0;
+    if (megabytes > 0 && frames == 0)
+    {
+        log_error("--render-ahead budget is smaller than a frame, not drawing ahead");
+    }
+
+    cache->capacity = frames < RENDER_AHEAD_MAX_FRAMES ? (int)frames : RENDER_AHEAD_MAX_FRAMES;
+    cache->selected = -1;
+    cache->direction = 1;
+    for (int i = 0; i < RENDER_AHEAD_MAX_FRAMES; i++)
+    {
+        cache->frames[i].surface = NULL;
+        cache->frames[i].item = -1;
+    }
+}
+
+// FrameCache_Drop forgets the drawing of an item that changed
+void FrameCache_Drop(struct FrameCache *cache, size_t index)
+{
+    cache->generation++;
+    for (int i = 0; i < cache->capacity; i++)
+    {
+        if (cache->frames[i].item == (long)index)
+        {
+            cache->frames[i].item = -1;
+        }
+    }
+}
+
+// FrameCache_Clear forgets every drawing, for when the items were replaced
+void FrameCache_Clear(struct FrameCache *cache)
+{
+    cache->generation++;
+    for (int i = 0; i < cache->capacity; i++)
+    {
+        cache->frames[i].item = -1;
+    }
+}
+
+// FrameCache_Free releases the drawings
+void FrameCache_Free(struct FrameCache *cache)
+{
+    for (int i = 0; i < cache->capacity; i++)
+    {
+        if (cache->frames[i].surface != NULL)
+        {
+            SDL_FreeSurface(cache->frames[i].surface);
+            cache->frames[i].surface = NULL;
+        }
+        cache->frames[i].item = -1;
+    }
+    cache->capacity = 0;
+}
+
+// the longest command accepted by --follow
+#define FOLLOW_MAX_LINE (64 * 1024)
+// how much of stdin is read per frame, so a flood of commands can't stall drawing
+#define FOLLOW_READ_BUDGET (64 * 1024)
+// how many bytes of replaced strings may pile up in the arena before it is compacted
+#define FOLLOW_COMPACT_BYTES (256 * 1024)
+
+// Follower applies newline delimited JSON commands read from stdin to the
+// items while they are displayed (--follow)
+struct Follower
+{
+    // the descriptor commands are read from
+    int fd;
+    // the line being read
+    char *line;
+    // number of bytes of the line read so far
+    size_t length;
+    // whether the rest of an overly long line is being skipped
+    bool skipping;
+    // whether the producer closed its end
+    bool closed;
+    // number of slots allocated in items
+    size_t item_capacity;
+    // bytes of replaced strings still held by the arena
+    size_t garbage;
+};
+
+// ItemsState_Compact copies the strings of the items into a fresh arena,
+// releasing the ones that were replaced
+static bool ItemsState_Compact(struct ItemsState *state)
+{
+    struct Item *items[2] = {state->items, &state->defaults};
+    size_t counts[2] = {state->item_count, 1};
+
+    // the strings are sized up front and copied into a single allocation,
+    // so nothing points into the new arena unless every copy fits
+    size_t size = 0;
+    for (int i = 0; i < 2; i++)
+    {
+        for (size_t j = 0; j < counts[i]; j++)
+        {
+            const char *strings[5] = {items[i][j].text, items[i][j].background_color, items[i][j].background_image, items[i][j].progress, items[i][j].id};
+            for (int k = 0; k < 5; k++)
+            {
+                if (strings[k] != NULL)
+                {
+                    size += strlen(strings[k]) + 1;
+                }
+            }
+        }
+    }
+
+    struct Arena arena = {0};
+    char *copy = size > 0 ? Arena_Alloc(&arena, size) : NULL;
+    if (size > 0 && copy == NULL)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < 2; i++)
+    {
+        for (size_t j = 0; j < counts[i]; j++)
+        {
+            char **strings[5] = {&items[i][j].text, &items[i][j].background_color, &items[i][j].background_image, &items[i][j].progress, &items[i][j].id};
+            for (int k = 0; k < 5; k++)
+            {
+                if (*strings[k] == NULL)
+                {
+                    continue;
+                }
+
+                size_t length = strlen(*strings[k]) + 1;
+                memcpy(copy, *strings[k], length);
+                *strings[k] = copy;
+                copy += length;
+            }
+        }
+    }
+
+    // the intern table points into the old arena and is only needed while loading
+    InternTable_Free(&state->strings);
+    Arena_Free(&state->arena);
+    state->arena = arena;
+    return true;
+}
+
+// Follower_String copies a string of a command into the arena
+static char *Follower_String(struct ItemsState *state, const char *string)
+{
+    return string != NULL ? Arena_StrNDup(&state->arena, string, strlen(string)) : NULL;
+}
+
+// Follower_Garbage accounts for the strings of an item that is being replaced
+static void Follower_Garbage(struct Follower *follower, struct Item *item)
+{
+    const char *strings[5] = {item->text, item->background_color, item->background_image, item->progress, item->id};
+    for (int i = 0; i < 5; i++)
+    {
+        if (strings[i] != NULL)
+        {
+            follower->garbage += strlen(strings[i]) + 1;
+        }
+    }
+}
+
+// Follower_ParseItem builds an item from a command, applying the defaults
+// to the properties it doesn't set, with the same rules as --file
+static bool Follower_ParseItem(struct ItemsState *state, JSON_Object *object, struct Item *item)
+{
+    if (object == NULL || !json_object_has_value_of_type(object, "text", JSONString))
+    {
+        log_error("Followed item has no text");
+        return false;
+    }
+
+    *item = state->defaults;
+    item->image_exists = false;
+    item->text = Follower_String(state, json_object_get_string(object, "text"));
+    if (json_object_has_value_of_type(object, "background_image", JSONString))
+    {
+        item->background_image = Follower_String(state, json_object_get_string(object, "background_image"));
+    }
+    if (json_object_has_value_of_type(object, "background_color", JSONString))
+    {
+        item->background_color = Follower_String(state, json_object_get_string(object, "background_color"));
+    }
+    if (json_object_has_value_of_type(object, "progress", JSONString))
+    {
+        item->progress = Follower_String(state, json_object_get_string(object, "progress"));
+    }
+    if (json_object_has_value(object, "show_pill"))
+    {
+        if (!json_object_has_value_of_type(object, "show_pill", JSONBoolean))
+        {
+            log_error("Invalid show_pill value provided for followed item");
+            return false;
+        }
+        item->show_pill = json_object_get_boolean(object, "show_pill");
+    }
+    if (json_object_has_value_of_type(object, "alignment", JSONString))
+    {
+        const char *alignment = json_object_get_string(object, "alignment");
+        if (strcmp(alignment, "top") == 0)
+        {
+            item->alignment = MessageAlignmentTop;
+        }
+        else if (strcmp(alignment, "bottom") == 0)
+        {
+            item->alignment = MessageAlignmentBottom;
+        }
+        else if (strcmp(alignment, "middle") == 0)
+        {
+            item->alignment = MessageAlignmentMiddle;
+        }
+        else
+        {
+            log_error("Invalid alignment provided for followed item");
+            return false;
+        }
+    }
+    if (json_object_has_value_of_type(object, "transition", JSONString))
+    {
+        if (!parse_transition(json_object_get_string(object, "transition"), &item->transition))
+        {
+            log_error("Invalid transition provided for followed item");
+            return false;
+        }
+        state->transitions = true;
+    }
+    if (json_object_has_value(object, "duration"))
+    {
+        double duration = json_object_get_number(object, "duration");
+        if (!json_object_has_value_of_type(object, "duration", JSONNumber) || duration < 0 || duration > INT_MAX)
+        {
+            log_error("Invalid duration provided for followed item");
+            return false;
+        }
+        item->duration = (int)duration;
+        state->durations = true;
+    }
+
+    return item->text != NULL;
+}
+
+// Follower_Index reads the item index of a command, defaulting to the selected item
+static bool Follower_Index(struct ItemsState *state, JSON_Object *command, size_t *index)
+{
+    if (!json_object_has_value(command, "index"))
+    {
+        *index = state->selected;
+        return true;
+    }
+
+    double value = json_object_get_number(command, "index");
+    if (!json_object_has_value_of_type(command, "index", JSONNumber) || value < 0 || value >= state->item_count)
+    {
+        log_error("Invalid item index in followed command");
+        return false;
+    }
+
+    *index = (size_t)value;
+    return true;
+}
+
+// Follower_Apply runs a single command, returning whether the screen needs
+// a redraw, as it does when the selected item or the number of items changed
+static bool Follower_Apply(struct Follower *follower, struct AppState *app, const char *line)
+{
+    struct ItemsState *state = app->items_state;
+    JSON_Value *value = json_parse_string(line);
+    JSON_Object *command = json_value_get_object(value);
+    const char *name = json_object_get_string(command, "command");
+    if (name == NULL)
+    {
+        log_error("Invalid followed command");
+        if (value != NULL)
+        {
+            json_value_free(value);
+        }
+        return false;
+    }
+
+    bool changed = false;
+    size_t index;
+    struct Item item;
+    if (strcmp(name, "append") == 0)
+    {
+        if (Follower_ParseItem(state, json_object_get_object(command, "item"), &item))
+        {
+            if (state->item_count == follower->item_capacity)
+            {
+                size_t capacity = follower->item_capacity * 2;
+                struct Item *items = realloc(state->items, sizeof(struct Item) * capacity);
+                if (items == NULL)
+                {
+                    log_error("Failed to allocate items");
+                    json_value_free(value);
+                    return false;
+                }
+                state->items = items;
+                follower->item_capacity = capacity;
+            }
+
+            state->items[state->item_count++] = item;
+            state->window_count = state->item_count;
+            changed = true;
+        }
+    }
+    else if (strcmp(name, "replace") == 0)
+    {
+        if (Follower_Index(state, command, &index) && Follower_ParseItem(state, json_object_get_object(command, "item"), &item))
+        {
+            Follower_Garbage(follower, &state->items[index]);
+            state->items[index] = item;
+            FrameCache_Drop(&app->frame_cache, index);
+            changed = index == (size_t)state->selected;
+        }
+    }
+    else if (strcmp(name, "set_text") == 0)
+    {
+        const char *text = json_object_get_string(command, "text");
+        if (text == NULL)
+        {
+            log_error("Followed set_text command has no text");
+        }
+        else if (Follower_Index(state, command, &index))
+        {
+            char *copy = Follower_String(state, text);
+            if (copy != NULL)
+            {
+                follower->garbage += strlen(state->items[index].text) + 1;
+                state->items[index].text = copy;
+                FrameCache_Drop(&app->frame_cache, index);
+                changed = index == (size_t)state->selected;
+            }
+        }
+    }
+    else if (strcmp(name, "select") == 0)
+    {
+        double selected = json_object_get_number(command, "selected");
+        if (!json_object_has_value_of_type(command, "selected", JSONNumber) || selected < 0 || selected >= state->item_count)
+        {
+            log_error("Invalid selected index in followed command");
+        }
+        else
+        {
+            CommandQueue_Push(&command_queue, CommandSelect, (int)selected);
+        }
+    }
+    else
+    {
+        char buff[1024];
+        snprintf(buff, sizeof(buff), "Unknown followed command: %s", name);
+        log_error(buff);
+    }
+
+    json_value_free(value);
+    return changed;
+}
+
+// Follower_New starts following a descriptor
+struct Follower *Follower_New(int fd, struct ItemsState *state)
+{
+    if (state->lazy || state->deck != NULL)
+    {
+        log_error("--follow can not be combined with --lazy-load or compiled decks");
+        return NULL;
+    }
+
+    struct Follower *follower = calloc(1, sizeof(struct Follower));
+    if (follower == NULL)
+    {
+        return NULL;
+    }
+
+    follower->line = malloc(FOLLOW_MAX_LINE + 1);
+    if (follower->line == NULL)
+    {
+        free(follower);
+        return NULL;
+    }
+
+    follower->fd = fd;
+    follower->item_capacity = state->item_count;
+    return follower;
+}
+
+// Follower_Free stops following
+void Follower_Free(struct Follower *follower)
+{
+    if (follower == NULL)
+    {
+        return;
+    }
+
+    free(follower->line);
+    free(follower);
+}
+
+// Follower_Poll applies the commands that arrived since the last frame,
+// without blocking. however many arrive, they cause at most one redraw
+void Follower_Poll(struct Follower *follower, struct AppState *app)
+{
+    char chunk[4096];
+    size_t budget = FOLLOW_READ_BUDGET;
+    bool changed = false;
+
+    while (!follower->closed && budget > 0)
+    {
+        struct pollfd fd = {.fd = follower->fd, .events = POLLIN};
+        if (poll(&fd, 1, 0) <= 0)
+        {
+            break;
+        }
+
+        ssize_t n = read(follower->fd, chunk, sizeof(chunk) < budget ? sizeof(chunk) : budget);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            // the display stays up once the producer is done
+            follower->closed = true;
+            break;
+        }
+        budget -= n;
+
+        for (ssize_t i = 0; i < n; i++)
+        {
+            if (chunk[i] != '\n')
+            {
+                if (follower->length < FOLLOW_MAX_LINE)
+                {
+                    follower->line[follower->length++] = chunk[i];
+                }
+                else if (!follower->skipping)
+                {
+                    log_error("Followed command is too long, skipping it");
+                    follower->skipping = true;
+                }
+                continue;
+            }
+
+            if (!follower->skipping && follower->length > 0)
+            {
+                follower->line[follower->length] = '\0';
+                changed = Follower_Apply(follower, app, follower->line) || changed;
+            }
+            follower->length = 0;
+            follower->skipping = false;
+        }
+    }
+
+    if (follower->garbage > FOLLOW_COMPACT_BYTES && ItemsState_Compact(app->items_state))
+    {
+        follower->garbage = 0;
+    }
+
+    if (changed)
+    {
+        app->redraw = 1;
+        app->readahead_item = -1;
+    }
+}
+
+// every how many frames --watch checks the file where inotify isn't available
+#define WATCH_POLL_FRAMES 30
+
+// FileWatcher notices when the file given to --file is rewritten or replaced (--watch)
+struct FileWatcher
+{
+    // the watched path
+    const char *path;
+#ifdef __linux__
+    // the inotify descriptor watching the directory of the file, so a
+    // file replaced by renaming another one over it is noticed too
+    int fd;
+    // the name of the file within its directory
+    char name[256];
+#else
+    // the modification time of the file when it was last checked
+    time_t mtime;
+    // frames left before the file is checked again
+    int frames;
+#endif
+};
+
+// FileWatcher_New starts watching a file
+struct FileWatcher *FileWatcher_New(const char *path)
+{
+    struct FileWatcher *watcher = calloc(1, sizeof(struct FileWatcher));
+    if (watcher == NULL)
+    {
+        return NULL;
+    }
+    watcher->path = path;
+
+#ifdef __linux__
+    char directory[1024] = "";
+    strncpy(directory, path, sizeof(directory) - 1);
+    char *slash = strrchr(directory, '/');
+    strncpy(watcher->name, slash != NULL ? path + (slash - directory) + 1 : path, sizeof(watcher->name) - 1);
+    if (slash == NULL)
+    {
+        strcpy(directory, ".");
+    }
+    else
+    {
+        // keeps the root directory as "/"
+        slash[slash == directory ? 1 : 0] = '\0';
+    }
+
+    watcher->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watcher->fd == -1 || inotify_add_watch(watcher->fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO) == -1)
+    {
+        if (watcher->fd != -1)
+        {
+            close(watcher->fd);
+        }
+        free(watcher);
+        return NULL;
+    }
+#else
+    struct stat st;
+    if (stat(path, &st) == 0)
+    {
+        watcher->mtime = st.st_mtime;
+    }
+#endif
+
+    return watcher;
+}
+
+// FileWatcher_Free stops watching
+void FileWatcher_Free(struct FileWatcher *watcher)
+{
+    if (watcher == NULL)
+    {
+        return;
+    }
+
+#ifdef __linux__
+    close(watcher->fd);
+#endif
+    free(watcher);
+}
+
+// FileWatcher_Changed returns whether the file was written or replaced
+// since the last call, without blocking
+bool FileWatcher_Changed(struct FileWatcher *watcher)
+{
+#ifdef __linux__
+    char events[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool changed = false;
+    ssize_t n;
+    while ((n = read(watcher->fd, events, sizeof(events))) > 0)
+    {
+        const struct inotify_event *event;
+        for (char *p = events; p < events + n; p += sizeof(struct inotify_event) + event->len)
+        {
+            event = (const struct inotify_event *)p;
+            if (event->len > 0 && strcmp(event->name, watcher->name) == 0)
+            {
+                changed = true;
+            }
+        }
+    }
+    return changed;
+#else
+    if (watcher->frames > 0)
+    {
+        watcher->frames--;
+        return false;
+    }
+    watcher->frames = WATCH_POLL_FRAMES;
+
+    struct stat st;
+    if (stat(watcher->path, &st) != 0 || st.st_mtime == watcher->mtime)
+    {
+        return false;
+    }
+    watcher->mtime = st.st_mtime;
+    return true;
+#endif
+}
+
+// Item_Equal returns whether two items are displayed the same way
+static bool Item_Equal(const struct Item *a, const struct Item *b)
+{
+    const char *strings[2][4] = {
+        {a->text, a->background_color, a->background_image, a->progress},
+        {b->text, b->background_color, b->background_image, b->progress},
+    };
+    for (int i = 0; i < 4; i++)
+    {
+        if ((strings[0][i] == NULL) != (strings[1][i] == NULL) || (strings[0][i] != NULL && strcmp(strings[0][i], strings[1][i]) != 0))
+        {
+            return false;
+        }
+    }
+
+    return a->background_rgb == b->background_rgb && a->show_pill == b->show_pill && a->alignment == b->alignment;
+}
+
+// ItemsState_Reload parses the file again after it changed and swaps in the
+// new items. items are matched by id when they have one and by index
+// otherwise, unchanged items keep what was learned about them, the
+// selection follows its item, and the screen is only redrawn when the
+// selected item looks different
+void ItemsState_Reload(struct AppState *app)
+{
+    struct ItemsState *old = app->items_state;
+    struct ItemsState *state = ItemsState_New(app->file, app->item_key, app->background_image, app->background_color, old->defaults.show_pill, old->defaults.alignment, false);
+    if (state == NULL)
+    {
+        // most likely a file caught halfway through being written, the
+        // write that completes it triggers another reload
+        log_error("Failed to reload items, keeping the current ones");
+        return;
+    }
+    if (state->deck != NULL)
+    {
+        log_error("Reloaded file is a compiled deck, keeping the current items");
+        ItemsState_Free(state);
+        return;
+    }
+
+    // the index + 1 of every old item is attached to its id
+    struct Arena arena = {0};
+    struct InternTable ids = {0};
+    for (size_t i = 0; i < old->item_count; i++)
+    {
+        const char *id = old->items[i].id;
+        struct InternedString *entry = id != NULL ? InternTable_Intern(&ids, &arena, id, strlen(id)) : NULL;
+        if (entry != NULL && entry->data == 0)
+        {
+            entry->data = i + 1;
+        }
+    }
+
+    struct Item *current = ItemsState_Current(old);
+    size_t selected = (size_t)old->selected < state->item_count ? (size_t)old->selected : state->item_count - 1;
+    size_t changed = 0;
+    for (size_t i = 0; i < state->item_count; i++)
+    {
+        struct Item *item = &state->items[i];
+        const struct Item *previous = NULL;
+        if (item->id != NULL)
+        {
+            struct InternedString *entry = InternTable_Intern(&ids, &arena, item->id, strlen(item->id));
+            previous = entry != NULL && entry->data != 0 ? &old->items[entry->data - 1] : NULL;
+            if (previous == current)
+            {
+                selected = i;
+            }
+        }
+        else if (i < old->item_count && old->items[i].id == NULL)
+        {
+            previous = &old->items[i];
+        }
+
+        if (previous != NULL && Item_Equal(previous, item))
+        {
+            item->image_exists = previous->image_exists;
+        }
+        else
+        {
+            changed++;
+        }
+    }
+    state->selected = selected;
+
+    if (!Item_Equal(current, ItemsState_Current(state)))
+    {
+        app->redraw = 1;
+    }
+    if (changed > 0)
+    {
+        app->readahead_item = -1;
+    }
+
+    InternTable_Free(&ids);
+    Arena_Free(&arena);
+    app->items_state = state;
+    ItemsState_Free(old);
+
+    // items drawn ahead of time may have moved to other indexes
+    FrameCache_Clear(&app->frame_cache);
+}
+
+// run_commands applies every command queued since the last frame in one
+// batch, in the order they were sent, redrawing at most once
+void run_commands(struct AppState *state)
+{
+    unsigned int dropped = atomic_exchange_explicit(&command_queue.dropped, 0, memory_order_relaxed);
+    if (dropped > 0)
+    {
+        char buff[1024];
+        snprintf(buff, sizeof(buff), "Command queue full, dropped %u commands", dropped);
+        log_error(buff);
+    }
+
+    if (exit_signal_code != 0)
+    {
+        state->redraw = 0;
+        state->quitting = 1;
+        state->exit_code = exit_signal_code;
+        return;
+    }
+
+    int selected = state->items_state->selected;
+    struct Command command;
+    while (!state->quitting && CommandQueue_Pop(&command_queue, &command))
+    {
+        // commands reaching past the items parsed so far wait for them, and
+        // moving back past the first item wraps around to the last of them all
+        if (state->items_progress != NULL && command.kind != CommandReload)
+        {
+            int64_t reach = command.kind == CommandMove ? (int64_t)state->items_state->selected + command.value : command.value;
+            ItemsProgress_Wait(state, reach >= 0 ? (size_t)reach : command.kind == CommandMove ? SIZE_MAX : 0);
+            if (state->quitting)
+            {
+                return;
+            }
+        }
+
+        struct ItemsState *items_state = state->items_state;
+        int64_t count = (int64_t)items_state->item_count;
+        if (command.kind == CommandMove)
+        {
+            // the value comes from any process able to signal us, so the
+            // arithmetic is done in 64 bits, where it can't overflow even on
+            // the 32-bit devices long is as narrow as int on
+            int64_t target = (int64_t)items_state->selected + command.value;
+
+            // moving past the last item quits instead of wrapping when asked to
+            if (command.value > 0 && target >= count && state->quit_after_last_item)
+            {
+                state->redraw = 0;
+                state->quitting = 1;
+                state->exit_code = ExitCodeSuccess;
+                return;
+            }
+
+            int64_t moved = target % count;
+            items_state->selected = (int)(moved < 0 ? moved + count : moved);
+        }
+        else if (command.kind == CommandSelect)
+        {
+            if (command.value < 0 || command.value >= count)
+            {
+                char buff[1024];
+                snprintf(buff, sizeof(buff), "Invalid item index received: %d", command.value);
+                log_error(buff);
+                continue;
+            }
+            items_state->selected = command.value;
+        }
+        else if (command.kind == CommandReload)
+        {
+            // a reload keeping the selected item on screen redraws only if it changed
+            bool moved = items_state->selected != selected;
+            ItemsState_Reload(state);
+            if (!moved)
+            {
+                selected = state->items_state->selected;
+            }
+        }
+    }
+
+    if (state->items_state->selected != selected)
+    {
+        state->redraw = 1;
+    }
+}
+
+// the time between frames assumed until it was measured, in nanoseconds
+#define SLIDESHOW_FRAME_NS 16666667ULL
+// how long before its deadline the next item is drawn ahead even while the
+// frames are kept busy, in milliseconds
+#define SLIDESHOW_PREFETCH_MS 1000
+
+// monotonic_ns returns the time of the monotonic clock in nanoseconds
+static uint64_t monotonic_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+// Slideshow_Init starts a slideshow that has yet to see its first frame
+void Slideshow_Init(struct Slideshow *slideshow)
+{
+    *slideshow = (struct Slideshow){
+        .item = -1,
+        .frame_time = SLIDESHOW_FRAME_NS,
+    };
+}
+
+// Slideshow_Tick is run at the start of every frame. it measures the frames
+// and queues the change to the next item on the frame whose flip lands
+// closest to the deadline, taking the time changes took to reach the screen
+// into account. the change goes through the same path as SIGUSR1, so it
+// respects --quit-after-last-item
+void Slideshow_Tick(struct Slideshow *slideshow)
+{
+    uint64_t now = monotonic_ns();
+    if (slideshow->frame_start != 0)
+    {
+        // a frame that stalled, such as one spent asleep, isn't counted
+        uint64_t frame = now - slideshow->frame_start;
+        if (frame < 4 * SLIDESHOW_FRAME_NS)
+        {
+            slideshow->frame_time = (slideshow->frame_time * 7 + frame) / 8;
+        }
+    }
+    slideshow->frame_start = now;
+
+    if (slideshow->deadline == 0 || slideshow->paused || slideshow->advancing)
+    {
+        return;
+    }
+
+    if (now + slideshow->latency + slideshow->frame_time / 2 >= slideshow->deadline)
+    {
+        // a full queue drops the change, it is queued again next frame
+        slideshow->advancing = CommandQueue_Push(&command_queue, CommandMove, 1);
+        slideshow->queued = now;
+    }
+}
+
+// Slideshow_Schedule sets the deadline of the selected item once the
+// selection changed. a change made for a deadline times the next item from
+// that deadline, so the slideshow doesn't drift, unless it was late. any
+// other change, such as LEFT, RIGHT or a signal, gives the new item its full time
+void Slideshow_Schedule(struct Slideshow *slideshow, struct AppState *state)
+{
+    bool advanced = slideshow->advancing;
+    slideshow->advancing = false;
+
+    struct ItemsState *items_state = state->items_state;
+    if (slideshow->item == items_state->selected)
+    {
+        return;
+    }
+    slideshow->item = items_state->selected;
+
+    uint64_t now = monotonic_ns();
+    uint64_t start = now;
+    if (advanced && slideshow->deadline != 0)
+    {
+        slideshow->advances++;
+        slideshow->landing = slideshow->deadline;
+        if (now <= slideshow->deadline + slideshow->frame_time)
+        {
+            start = slideshow->deadline;
+        }
+    }
+
+    struct Item *item = ItemsState_Current(items_state);
+    int duration = item->duration >= 0 ? item->duration : state->slide_duration_ms;
+    uint64_t length = (uint64_t)duration * 1000000ULL;
+    if (slideshow->paused)
+    {
+        slideshow->remaining = length;
+        slideshow->deadline = 0;
+    }
+    else
+    {
+        slideshow->deadline = length > 0 ? start + length : 0;
+    }
+}
+
+// Slideshow_Pause pauses a running slideshow and resumes a paused one. the
+// selected item keeps the time it had left when the slideshow was paused
+void Slideshow_Pause(struct Slideshow *slideshow)
+{
+    uint64_t now = monotonic_ns();
+    if (slideshow->paused)
+    {
+        slideshow->paused = false;
+        slideshow->deadline = slideshow->remaining > 0 ? now + slideshow->remaining : 0;
+        return;
+    }
+
+    slideshow->paused = true;
+    slideshow->remaining = 0;
+    if (slideshow->deadline != 0)
+    {
+        // an item that was already due changes as soon as the slideshow resumes
+        slideshow->remaining = slideshow->deadline > now ? slideshow->deadline - now : 1;
+    }
+    slideshow->deadline = 0;
+}
+
+// Slideshow_Soon returns whether the selected item is due to change within
+// SLIDESHOW_PREFETCH_MS, so the next one should be drawn ahead now
+bool Slideshow_Soon(struct Slideshow *slideshow)
+{
+    return slideshow->deadline != 0 && !slideshow->paused && slideshow->deadline <= monotonic_ns() + SLIDESHOW_PREFETCH_MS * 1000000ULL;
+}
+
+// Slideshow_Shown is run once a frame was flipped onto the screen, counting
+// a change that reached the screen a frame or more after its deadline as missed
+void Slideshow_Shown(struct Slideshow *slideshow, long shown)
+{
+    if (slideshow->landing == 0 || shown != slideshow->item)
+    {
+        return;
+    }
+
+    uint64_t now = monotonic_ns();
+    slideshow->latency = (slideshow->latency + (now - slideshow->queued)) / 2;
+    if (now > slideshow->landing + slideshow->frame_time)
+    {
+        slideshow->missed++;
+        if (now - slideshow->landing > slideshow->worst)
+        {
+            slideshow->worst = now - slideshow->landing;
+        }
+    }
+    slideshow->landing = 0;
+}
+
+// Slideshow_Report logs how many changes missed their deadline
+void Slideshow_Report(struct Slideshow *slideshow)
+{
+    if (slideshow->missed == 0)
+    {
+        return;
+    }
+
+    char buff[1024];
+    snprintf(buff, sizeof(buff), "Slideshow missed %lu of %lu deadlines, by up to %llu ms",
+             slideshow->missed, slideshow->advances, (unsigned long long)(slideshow->worst / 1000000ULL));
+    log_error(buff);
+}
+
+// handle_input interprets input events and mutates app state
+void handle_input(struct AppState *state)
+{
+    if (state->timeout_seconds < 0)
+    {
+        return;
+    }
+
+    PAD_poll();
+
+    bool is_action_button_pressed = false;
+    bool is_confirm_button_pressed = false;
+    bool is_cancel_button_pressed = false;
+    bool is_inaction_button_pressed = false;
+    if (PAD_justReleased(BTN_A))
+    {
+        if (strcmp(state->action_button, "A") == 0)
+        {
+            is_action_button_pressed = true;
+        }
+        else if (strcmp(state->confirm_button, "A") == 0)
+        {
+            is_confirm_button_pressed = true;
+        }
+        else if (strcmp(state->cancel_button, "A") == 0)
+        {
+            is_cancel_button_pressed = true;
+        }
+        else if (strcmp(state->inaction_button, "A") == 0)
+        {
+            is_inaction_button_pressed = true;
+        }
+    }
+    else if (PAD_justReleased(BTN_B))
+    {
+        if (strcmp(state->action_button, "B") == 0)
+        {
+            is_action_button_pressed = true;
+        }
+        else if (strcmp(state->confirm_button, "B") == 0)
+        {
+            is_confirm_button_pressed = true;
+        }
+        else if (strcmp(state->cancel_button, "B") == 0)
+        {
+            is_cancel_button_pressed = true;
+        }
+        else if (strcmp(state->inaction_button, "B") == 0)
+        {
+            is_inaction_button_pressed = true;
+        }
+    }
+    else if (PAD_justReleased(BTN_X))
+    {
+        if (strcmp(state->action_button, "X") == 0)
+        {
+            is_action_button_pressed = true;
+        }
+        else if (strcmp(state->confirm_button, "X") == 0)
+        {
+            is_confirm_button_pressed = true;
+        }
+        else if (strcmp(state->cancel_button, "X") == 0)
+        {
+            is_cancel_button_pressed = true;
+        }
+        else if (strcmp(state->inaction_button, "X") == 0)
+        {
+            is_inaction_button_pressed = true;
+        }
+    }
+    else if (PAD_justReleased(BTN_Y))
+    {
+        if (strcmp(state->action_button, "Y") == 0)
+        {
+            is_action_button_pressed = true;
+        }
+        else if (strcmp(state->confirm_button, "Y") == 0)
+        {
+            is_confirm_button_pressed = true;
+        }
+        else if (strcmp(state->cancel_button, "Y") == 0)
+        {
+            is_cancel_button_pressed = true;
+        }
+        else if (strcmp(state->inaction_button, "Y") == 0)
+        {
+            is_inaction_button_pressed = true;
+        }
+    }
+
+    if (is_action_button_pressed && state->action_show)
+    {
+        state->redraw = 0;
+        state->quitting = 1;
+        state->exit_code = ExitCodeActionButton;
+        return;
+    }
+
+    if (is_confirm_button_pressed && state->confirm_show)
+    {
+        state->redraw = 0;
+        state->quitting = 1;
+        state->exit_code = ExitCodeSuccess;
+        return;
+    }
+
+    if (is_cancel_button_pressed)
+    {
+        state->redraw = 0;
+        state->quitting = 1;
+        state->exit_code = ExitCodeCancelButton;
+        return;
+    }
+
+    if (is_inaction_button_pressed && state->inaction_show)
+    {
+        state->redraw = 0;
+        state->quitting = 1;
+        state->exit_code = ExitCodeInactionButton;
+        return;
+    }
+
+    if (PAD_justReleased(BTN_START))
+    {
+        state->redraw = 0;
+        state->quitting = 1;
+        state->exit_code = ExitCodeStartButton;
+        return;
+    }
+
+    if (PAD_justReleased(BTN_SELECT))
+    {
+        Slideshow_Pause(&state->slideshow);
+    }
+
+    // R1 changes between the selected item and the grid of items around it
+    if (state->grid_columns > 0 && PAD_justReleased(BTN_R1))
+    {
+        state->grid_shown = !state->grid_shown;
+        state->redraw = 1;
+    }
+
+    // in the grid UP and DOWN move by a row, stopping at the first and last ones
+    if (state->grid_shown && PAD_justRepeated(BTN_UP))
+    {
+        if (state->items_state->selected >= state->grid_columns)
+        {
+            state->items_state->selected -= state->grid_columns;
+            state->redraw = 1;
+        }
+    }
+    else if (state->grid_shown && PAD_justRepeated(BTN_DOWN))
+    {
+        ItemsProgress_Wait(state, state->items_state->selected + state->grid_columns);
+        if (state->quitting)
+        {
+            return;
+        }
+
+        // moving down into a shorter last row stops at its last item
+        int last = state->items_state->item_count - 1;
+        if (state->items_state->selected / state->grid_columns < last / state->grid_columns)
+        {
+            state->items_state->selected = MIN(state->items_state->selected + state->grid_columns, last);
+            state->redraw = 1;
+        }
+    }
+    else if (PAD_justRepeated(BTN_LEFT))
+    {
+        // wrapping around to the last item waits for every item to be parsed
+        if (state->items_state->selected == 0 && PAD_justPressed(BTN_LEFT))
+        {
+            ItemsProgress_Wait(state, SIZE_MAX);
+            if (state->quitting)
+            {
+                return;
+            }
+        }
+
+        if (state->items_state->selected == 0 && !PAD_justPressed(BTN_LEFT))
+        {
+            state->redraw = 0;
+        }
+        else
+        {
+            state->items_state->selected -= 1;
+            if (state->items_state->selected < 0)
+            {
+                state->items_state->selected = state->items_state->item_count - 1;
+            }
+            state->redraw = 1;
+        }
+    }
+    else if (PAD_justRepeated(BTN_RIGHT))
+    {
+        ItemsProgress_Wait(state, state->items_state->selected + 1);
+        if (state->quitting)
+        {
+            return;
+        }
+
+        if (state->items_state->selected == state->items_state->item_count - 1 && !PAD_justPressed(BTN_RIGHT))
+        {
+            state->redraw = 0;
+        }
+        else
+        {
+            state->items_state->selected += 1;
+            if (state->items_state->selected >= state->items_state->item_count)
+            {
+                if (state->quit_after_last_item)
+                {
+                    state->redraw = 0;
+                    state->quitting = 1;
+                    state->exit_code = ExitCodeSuccess;
+                    return;
+                }
+                state->items_state->selected = 0;
+            }
+            state->redraw = 1;
+        }
+    }
+}
+
+// turns a hex color (e.g. #000000) into an SDL_Color
+SDL_Color hex_to_sdl_color(const char *hex)
+{
+    SDL_Color color = {0, 0, 0, 255};
+
+    // Skip # if present
+    if (hex[0] == '#')
+    {
+        hex++;
+    }
+
+    // Parse RGB values from hex string
+    int r, g, b;
+    if (sscanf(hex, "%02x%02x%02x", &r, &g, &b) == 3)
+    {
+        color.r = r;
+        color.g = g;
+        color.b = b;
+    }
+
+    return color;
+}
+
+// scale_surface manually scales a surface to a new width and height for SDL1
+SDL_Surface *scale_surface(SDL_Surface *surface,
+                           Uint16 width, Uint16 height)
+{
+    SDL_Surface *scaled = SDL_CreateRGBSurface(surface->flags,
+                                               width,
+                                               height,
+                                               surface->format->BitsPerPixel,
+                                               surface->format->Rmask,
+                                               surface->format->Gmask,
+                                               surface->format->Bmask,
+                                               surface->format->Amask);
+
+    int bpp = surface->format->BytesPerPixel;
+    int *v = (int *)malloc(bpp * sizeof(int));
+
+    for (int x = 0; x < width; x++)
+    {
+        for (int y = 0; y < height; y++)
+        {
+            int xo1 = x * surface->w / width;
+            int xo2 = MAX((x + 1) * surface->w / width, xo1 + 1);
+            int yo1 = y * surface->h / height;
+            int yo2 = MAX((y + 1) * surface->h / height, yo1 + 1);
+            int n = (xo2 - xo1) * (yo2 - yo1);
+
+            for (int i = 0; i < bpp; i++)
+                v[i] = 0;
+
+            for (int xo = xo1; xo < xo2; xo++)
+                for (int yo = yo1; yo < yo2; yo++)
+                {
+                    Uint8 *ps =
+                        (Uint8 *)surface->pixels + yo * surface->pitch + xo * bpp;
+                    for (int i = 0; i < bpp; i++)
+                        v[i] += ps[i];
+                }
+
+            Uint8 *pd = (Uint8 *)scaled->pixels + y * scaled->pitch + x * bpp;
+            for (int i = 0; i < bpp; i++)
+                pd[i] = v[i] / n;
+        }
+    }
+
+    free(v);
+
+    return scaled;
+}
+
+// layout_message splits text into words and greedily wraps them into at most
+// MAIN_ROW_COUNT lines that fit within the screen width
+// returns the index of the last line used and stores the line height in line_height
+int layout_message(TTF_Font *font, const char *text, struct Message messages[MAIN_ROW_COUNT], int *line_height)
+{
+    int message_padding = SCALE1(PADDING + BUTTON_PADDING);
+
+    // get the width and height of every word in the message
+    struct Message words[1024];
+    int word_count = 0;
+    char original_message[1024];
+    strncpy(original_message, text, sizeof(original_message));
+    original_message[sizeof(original_message) - 1] = '\0';
+    char *word = strtok(original_message, " ");
+    int word_height = 0;
+    while (word != NULL && word_count < 1024)
+    {
+        int word_width;
+        strtrim(word);
+        if (strcmp(word, "") == 0)
+        {
+            word = strtok(NULL, " ");
+            continue;
+        }
+
+        TTF_SizeUTF8(font, word, &word_width, &word_height);
+        strncpy(words[word_count].message, word, sizeof(words[word_count].message));
+        words[word_count].width = word_width;
+        word_count++;
+        word = strtok(NULL, " ");
+    }
+
+    int letter_width = 0;
+    TTF_SizeUTF8(font, "A", &letter_width, NULL);
+
+    // construct a list of messages that can be displayed on a single line
+    // if the message is too long to be displayed on a single line,
+    // the message will be wrapped onto multiple lines
+    for (int i = 0; i < MAIN_ROW_COUNT; i++)
+    {
+        strncpy(messages[i].message, "", sizeof(messages[i].message));
+        messages[i].width = 0;
+    }
+
+    int current_message_index = 0;
+    for (int i = 0; i < word_count; i++)
+    {
+        int potential_width = messages[current_message_index].width + words[i].width;
+        if (i > 0)
+        {
+            potential_width += letter_width;
+        }
+
+        if (messages[current_message_index].width == 0)
+        {
+            strncpy(messages[current_message_index].message, words[i].message, sizeof(messages[current_message_index].message));
+            messages[current_message_index].width = words[i].width;
+        }
+        else if (potential_width <= FIXED_WIDTH - 2 * message_padding)
+        {
+            char messageBuf[256];
+            snprintf(messageBuf, sizeof(messageBuf), "%s %s", messages[current_message_index].message, words[i].message);
+
+            strncpy(messages[current_message_index].message, messageBuf, sizeof(messages[current_message_index].message));
+            messages[current_message_index].width += words[i].width;
+        }
+        else
+        {
+            // stop once every available line has been used
+            if (current_message_index + 1 >= MAIN_ROW_COUNT)
+            {
+                break;
+            }
+
+            current_message_index++;
+            strncpy(messages[current_message_index].message, words[i].message, sizeof(messages[current_message_index].message));
+            messages[current_message_index].width = words[i].width;
+        }
+    }
+
+    if (line_height != NULL)
+    {
+        *line_height = word_height;
+    }
+
+    return current_message_index;
+}
+
+// background_rect computes where a background image of the given size is drawn
+SDL_Rect background_rect(int imgW, int imgH)
+{
+    // Compute scale factor
+    float scaleX = (float)(FIXED_WIDTH - 2 * PADDING) / imgW;
+    float scaleY = (float)(FIXED_HEIGHT - 2 * PADDING) / imgH;
+    float scale = (scaleX < scaleY) ? scaleX : scaleY;
+
+    // Ensure upscaling only when the image is smaller than the screen
+    if (imgW * scale < FIXED_WIDTH - 2 * PADDING && imgH * scale < FIXED_HEIGHT - 2 * PADDING)
+    {
+        scale = (scaleX > scaleY) ? scaleX : scaleY;
+    }
+
+    // Compute target dimensions
+    int dstW = imgW * scale;
+    int dstH = imgH * scale;
+
+    int dstX = (FIXED_WIDTH - dstW) / 2;
+    int dstY = (FIXED_HEIGHT - dstH) / 2;
+    if (imgW == FIXED_WIDTH && imgH == FIXED_HEIGHT)
+    {
+        dstW = FIXED_WIDTH;
+        dstH = FIXED_HEIGHT;
+        dstX = 0;
+        dstY = 0;
+    }
+
+    SDL_Rect rect = {dstX, dstY, dstW, dstH};
+    return rect;
+}
+
+// load_background_image loads a background image from disk or from the asset pack
+// prescaled is set when the image already has its on-screen size
+SDL_Surface *load_background_image(const char *path, bool *prescaled)
+{
+    *prescaled = false;
+    if (strncmp(path, PACK_URI_PREFIX, strlen(PACK_URI_PREFIX)) == 0)
+    {
+        const struct PackEntry *entry = AssetPack_Find(&asset_pack, path + strlen(PACK_URI_PREFIX));
+        return entry != NULL ? AssetPack_Load(&asset_pack, entry, prescaled) : NULL;
+    }
+
+    return IMG_Load(path);
+}
+
+// release_preloaded_image frees the image decoded while starting up
+void release_preloaded_image(struct AppState *state)
+{
+    if (state->preloaded_image != NULL)
+    {
+        SDL_FreeSurface(state->preloaded_image);
+    }
+    free(state->preloaded_path);
+    state->preloaded_image = NULL;
+    state->preloaded_path = NULL;
+}
+
+// take_preloaded_image hands over the image decoded while starting up when
+// it is the one asked for. either way it is only offered once
+static SDL_Surface *take_preloaded_image(struct AppState *state, const char *path, bool *prescaled)
+{
+    SDL_Surface *surface = NULL;
+    if (state->preloaded_image != NULL && strcmp(state->preloaded_path, path) == 0)
+    {
+        surface = state->preloaded_image;
+        *prescaled = state->preloaded_prescaled;
+        state->preloaded_image = NULL;
+    }
+
+    release_preloaded_image(state);
+    return surface;
+}
+
+// ProgressSegment_Read copies the progress out of a segment, returning
+// false when every attempt raced a write of the producer
+static bool ProgressSegment_Read(struct ProgressSegment *segment, uint32_t *value, uint32_t *total)
+{
+    for (int attempt = 0; attempt < PROGRESS_READ_ATTEMPTS; attempt++)
+    {
+        uint32_t sequence = atomic_load_explicit(&segment->sequence, memory_order_acquire);
+        if (sequence & 1)
+        {
+            continue;
+        }
+
+        uint32_t read_value = atomic_load_explicit(&segment->value, memory_order_relaxed);
+        uint32_t read_total = atomic_load_explicit(&segment->total, memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&segment->sequence, memory_order_relaxed) == sequence)
+        {
+            *value = read_value;
+            *total = read_total;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// ProgressBar_Close stops following the segment
+void ProgressBar_Close(struct ProgressBar *bar)
+{
+    if (bar->segment != NULL)
+    {
+        munmap(bar->segment, sizeof(struct ProgressSegment));
+    }
+    if (bar->under != NULL)
+    {
+        SDL_FreeSurface(bar->under);
+    }
+
+    *bar = (struct ProgressBar){0};
+}
+
+// ProgressBar_Open maps the segment, failing until the producer created it
+static bool ProgressBar_Open(struct ProgressBar *bar)
+{
+    int fd = open(bar->path, O_RDONLY);
+    if (fd == -1)
+    {
+        return false;
+    }
+
+    struct stat st;
+    void *segment = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(struct ProgressSegment))
+    {
+        segment = mmap(NULL, sizeof(struct ProgressSegment), PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    if (segment == MAP_FAILED)
+    {
+        return false;
+    }
+
+    bar->segment = segment;
+    return true;
+}
+
+// ProgressBar_Filled returns the width of the filled part of the bar,
+// quantized to whole pixels so progress too small to see draws nothing
+static int ProgressBar_Filled(struct ProgressBar *bar)
+{
+    if (bar->total == 0 || bar->rect.w <= 0)
+    {
+        return 0;
+    }
+
+    uint32_t value = bar->value < bar->total ? bar->value : bar->total;
+    int filled = (int)((uint64_t)bar->rect.w * value / bar->total);
+
+    // the rounded ends of the pill need at least its height
+    if (filled > 0 && filled < bar->rect.h)
+    {
+        filled = bar->rect.h;
+    }
+    return filled;
+}
+
+// ProgressBar_Update follows the segment of the selected item and reads it
+// once per frame, returning whether the bar on screen is out of date
+bool ProgressBar_Update(struct ProgressBar *bar, const char *path)
+{
+    if (path == NULL)
+    {
+        path = "";
+    }
+
+    if (strncmp(bar->path, path, sizeof(bar->path) - 1) != 0)
+    {
+        ProgressBar_Close(bar);
+        strncpy(bar->path, path, sizeof(bar->path) - 1);
+    }
+
+    if (strcmp(bar->path, "") == 0)
+    {
+        return false;
+    }
+
+    if (bar->segment == NULL)
+    {
+        if (bar->retry_frames > 0)
+        {
+            bar->retry_frames--;
+            return false;
+        }
+        if (!ProgressBar_Open(bar))
+        {
+            bar->retry_frames = PROGRESS_RETRY_FRAMES;
+            return false;
+        }
+    }
+
+    // a read that raced the producer keeps the last value until the next frame
+    ProgressSegment_Read(bar->segment, &bar->value, &bar->total);
+    return bar->under != NULL && ProgressBar_Filled(bar) != bar->filled;
+}
+
+// ProgressBar_Draw draws the bar at its rect. after a full redraw the screen
+// under it is kept, otherwise it is restored so the bar can be drawn alone
+void ProgressBar_Draw(struct ProgressBar *bar, SDL_Surface *screen, bool full)
+{
+    SDL_Rect rect = bar->rect;
+    if (full)
+    {
+        if (bar->under != NULL && (bar->under->w != rect.w || bar->under->h != rect.h))
+        {
+            SDL_FreeSurface(bar->under);
+            bar->under = NULL;
+        }
+        if (bar->under == NULL)
+        {
+            SDL_PixelFormat *format = screen->format;
+            bar->under = SDL_CreateRGBSurface(0, rect.w, rect.h, format->BitsPerPixel, format->Rmask, format->Gmask, format->Bmask, format->Amask);
+#ifdef USE_SDL2
+            SDL_SetSurfaceBlendMode(bar->under, SDL_BLENDMODE_NONE);
+#else
+            SDL_SetAlpha(bar->under, 0, SDL_ALPHA_OPAQUE);
+#endif
+        }
+        if (bar->under != NULL)
+        {
+            SDL_BlitSurface(screen, &rect, bar->under, NULL);
+        }
+    }
+    else if (bar->under != NULL)
+    {
+        SDL_BlitSurface(bar->under, NULL, screen, &rect);
+    }
+
+    pthread_mutex_lock(&gfx_lock);
+    GFX_blitPill(ASSET_BAR_BG, screen, &(SDL_Rect){bar->rect.x, bar->rect.y, bar->rect.w, bar->rect.h});
+    bar->filled = ProgressBar_Filled(bar);
+    if (bar->filled > 0)
+    {
+        GFX_blitPill(ASSET_BAR, screen, &(SDL_Rect){bar->rect.x, bar->rect.y, bar->filled, bar->rect.h});
+    }
+    pthread_mutex_unlock(&gfx_lock);
+}
+
+// item_background_color maps the background color of an item to the
+// screen, compiled decks carry it already resolved
+static uint32_t item_background_color(SDL_Surface *screen, struct Item *item)
+{
+    SDL_Color background_color = {(item->background_rgb >> 16) & 0xFF, (item->background_rgb >> 8) & 0xFF, item->background_rgb & 0xFF, 255};
+    if (item->background_color != NULL)
+    {
+        background_color = hex_to_sdl_color(item->background_color);
+    }
+    return SDL_MapRGBA(screen->format, background_color.r, background_color.g, background_color.b, 255);
+}
+
+// draw_item draws an item and the buttons around it, everything but its
+// progress bar, returning where the bar goes. it doesn't need the item to be
+// the selected one, so items can be drawn ahead of time
+static SDL_Rect draw_item(SDL_Surface *screen, struct AppState *state, struct Item *item)
+{
+    // render a background color
+    SDL_FillRect(screen, NULL, item_background_color(screen, item));
+
+    // check if there is an image and it is accessible
+    if (item->background_image != NULL)
+    {
+        bool prescaled = false;
+        SDL_Surface *surface = take_preloaded_image(state, item->background_image, &prescaled);
+        if (surface == NULL)
+        {
+            surface = load_background_image(item->background_image, &prescaled);
+        }
+        item->image_exists = surface != NULL;
+        if (surface)
+        {
+            int imgW = surface->w, imgH = surface->h;
+
+            // images prescaled into the asset pack are only centered
+            SDL_Rect dstRect = {(FIXED_WIDTH - imgW) / 2, (FIXED_HEIGHT - imgH) / 2, imgW, imgH};
+            if (!prescaled)
+            {
+                dstRect = background_rect(imgW, imgH);
+            }
+            int dstW = dstRect.w;
+            int dstH = dstRect.h;
+
+            if (imgW == dstW && imgH == dstH)
+            {
+                SDL_BlitSurface(surface, NULL, screen, &dstRect);
+            }
+            else
+            {
+#ifdef USE_SDL2
+                SDL_BlitScaled(surface, NULL, screen, &dstRect);
+#else
+                SDL_Surface *scaled = scale_surface(surface, dstW, dstH);
+                SDL_BlitSurface(scaled, NULL, screen, &dstRect);
+                SDL_FreeSurface(scaled);
+#endif
+            }
+            SDL_FreeSurface(surface);
+        }
+    }
+
+    // draw the button group on the button-right
+    // only two buttons can be displayed at a time
+    pthread_mutex_lock(&gfx_lock);
+    if (state->confirm_show && strcmp(state->confirm_button, "") != 0)
+    {
+        if (state->cancel_show && strcmp(state->cancel_button, "") != 0)
+        {
+            GFX_blitButtonGroup((char *[]){state->cancel_button, state->cancel_text, state->confirm_button, state->confirm_text, NULL}, 1, screen, 1);
+        }
+        else
+        {
+            GFX_blitButtonGroup((char *[]){state->confirm_button, state->confirm_text, NULL}, 1, screen, 1);
+        }
+    }
+    else if (state->cancel_show)
+    {
+        GFX_blitButtonGroup((char *[]){state->cancel_button, state->cancel_text, NULL}, 1, screen, 1);
+    }
+    pthread_mutex_unlock(&gfx_lock);
+
+    int initial_padding = 0;
+    if (state->show_time_left && state->timeout_seconds > 0)
+    {
+        struct timeval current_time;
+        gettimeofday(&current_time, NULL);
+
+        int time_left = state->timeout_seconds - (current_time.tv_sec - state->start_time.tv_sec);
+        if (time_left <= 0)
+        {
+            time_left = 0;
+        }
+
+        char time_left_str[1024];
+        if (time_left == 1)
+        {
+            snprintf(time_left_str, sizeof(time_left_str), "Time left: %d second", time_left);
+        }
+        else
+        {
+            snprintf(time_left_str, sizeof(time_left_str), "Time left: %d seconds", time_left);
+        }
+
+        SDL_Surface *text = TTF_RenderUTF8_Blended(state->fonts.small, time_left_str, COLOR_WHITE);
+        SDL_Rect pos = {
+            SCALE1(PADDING),
+            SCALE1(PADDING),
+            text->w,
+            text->h};
+        SDL_BlitSurface(text, NULL, screen, &pos);
+
+        initial_padding = text->h + SCALE1(PADDING);
+        SDL_FreeSurface(text);
+    }
+
+    // wrap the message into as many lines as fit on the screen
+    struct Message messages[MAIN_ROW_COUNT];
+    int word_height = 0;
+    int message_count = layout_message(state->fonts.large, item->text, messages, &word_height);
+
+    int messages_height = (message_count + 1) * word_height + (SCALE1(PADDING) * message_count);
+    if (item->progress != NULL)
+    {
+        messages_height += SCALE1(PADDING + PROGRESS_BAR_HEIGHT);
+    }
+    // default to the middle of the screen
+    int current_message_y = (screen->h - messages_height) / 2;
+    if (item->alignment == MessageAlignmentTop)
+    {
+        current_message_y = SCALE1(PADDING) + initial_padding;
+    }
+    else if (item->alignment == MessageAlignmentBottom)
+    {
+        current_message_y = screen->h - messages_height - SCALE1(PADDING) - initial_padding;
+    }
+
+    for (int i = 0; i <= message_count; i++)
+    {
+        char *message = messages[i].message;
+        if (message == NULL)
+        {
+            continue;
+        }
+
+        SDL_Surface *text = TTF_RenderUTF8_Blended(state->fonts.large, message, COLOR_WHITE);
+        if (text == NULL)
+        {
+            continue;
+        }
+
+        SDL_Rect pos = {
+            ((screen->w - text->w) / 2),
+            current_message_y + PADDING,
+            text->w,
+            text->h};
+
+        if (item->show_pill)
+        {
+            SDL_Rect pill_rect = {
+                pos.x - SCALE1(PADDING * 2),
+                pos.y - SCALE1(PADDING),
+                text->w + SCALE1(PADDING * 4),
+                SCALE1(PILL_SIZE)};
+            pthread_mutex_lock(&gfx_lock);
+            GFX_blitPill(ASSET_BLACK_PILL, screen, &pill_rect);
+            pthread_mutex_unlock(&gfx_lock);
+        }
+
+        SDL_BlitSurface(text, NULL, screen, &pos);
+        SDL_FreeSurface(text);
+        current_message_y += word_height + SCALE1(PADDING);
+    }
+
+    // the progress bar goes under the text, but is drawn last so the
+    // copy of the screen under it holds everything else
+    SDL_Rect bar_rect = {
+        SCALE1(PADDING * 4),
+        current_message_y + SCALE1(PADDING),
+        screen->w - SCALE1(PADDING * 8),
+        SCALE1(PROGRESS_BAR_HEIGHT)};
+
+    pthread_mutex_lock(&gfx_lock);
+    if (state->action_show && strcmp(state->action_button, "") != 0)
+    {
+        if (state->inaction_show && strcmp(state->inaction_button, "") != 0)
+        {
+            GFX_blitButtonGroup((char *[]){state->inaction_button, state->inaction_text, state->action_button, state->action_text, NULL}, 0, screen, 0);
+        }
+        else
+        {
+            GFX_blitButtonGroup((char *[]){state->action_button, state->action_text, NULL}, 0, screen, 0);
+        }
+    }
+    else if (state->inaction_show && strcmp(state->inaction_button, "") != 0)
+    {
+        GFX_blitButtonGroup((char *[]){state->inaction_button, state->inaction_text, NULL}, 0, screen, 0);
+    }
+    pthread_mutex_unlock(&gfx_lock);
+
+    return bar_rect;
+}
+
+// the most columns and rows the grid view can have
+#define GRID_MAX_SIZE 8
+// how many screens of thumbnails are kept in memory
+#define THUMBNAIL_CACHE_SCREENS 3
+// the most threads thumbnails are made on
+#define THUMBNAIL_MAX_THREADS 4
+#define THUMBNAIL_MAGIC "MPTHUMB\n"
+#define THUMBNAIL_VERSION 1
+
+// ThumbnailHeader starts a thumbnail kept in the --thumbnail-cache
+// directory, it is followed by the deflated ARGB8888 pixels
+struct ThumbnailHeader
+{
+    // always THUMBNAIL_MAGIC
+    char magic[8];
+    // the version of the format, always THUMBNAIL_VERSION
+    uint32_t version;
+    // always DECK_BYTE_ORDER
+    uint32_t byte_order;
+    // the size of the thumbnail
+    uint32_t width;
+    uint32_t height;
+    // size of the deflated pixels in bytes
+    uint64_t data_size;
+};
+
+// Thumbnail is a slot of the thumbnails kept in memory
+struct Thumbnail
+{
+    // the item the slot holds the thumbnail of, -1 for free slots
+    long item;
+    // a copy of the image the thumbnail is made of, items may change while it is made
+    char *path;
+    // the thumbnail, NULL until it is made or when the image can't be loaded
+    SDL_Surface *surface;
+    // whether the thumbnail was made, even when the image couldn't be loaded
+    bool done;
+    // whether a worker is making the thumbnail, the slot is not reused until it is done
+    bool loading;
+    // the grid draw the slot was last wanted in, the one wanted longest ago is reused first
+    unsigned long used;
+};
+
+// ThumbnailPool makes the thumbnails of the grid view on worker threads,
+// keeping the ones of the last few screens in memory
+struct ThumbnailPool
+{
+    pthread_t threads[THUMBNAIL_MAX_THREADS];
+    // number of threads that were started
+    int thread_count;
+    // the size thumbnails are fit into
+    int width;
+    int height;
+    // where thumbnails are kept between runs, NULL to keep them in memory only
+    char *cache_directory;
+    // protects everything below
+    pthread_mutex_t lock;
+    // signalled when thumbnails are wanted or the pool stops
+    pthread_cond_t wake;
+    // the slots
+    struct Thumbnail *slots;
+    // number of slots
+    size_t slot_count;
+    // the slots of the cells on screen waiting for a worker, in drawing order
+    size_t wanted[GRID_MAX_SIZE * GRID_MAX_SIZE];
+    // number of wanted slots
+    size_t wanted_count;
+    // number of wanted slots already taken by a worker
+    size_t wanted_taken;
+    // number of grid draws so far
+    unsigned long draws;
+    // whether a thumbnail of a cell on screen was made since the grid was last drawn
+    bool fresh;
+    // whether the workers should exit
+    bool stopping;
+};
+
+// thumbnail_cache_path names the file the thumbnail of an image is kept in,
+// returning false for images that aren't kept on disk
+static bool thumbnail_cache_path(struct ThumbnailPool *pool, const char *path, char *cache_path, size_t size)
+{
+    // images of asset packs are stored ready to be drawn already
+    if (pool->cache_directory == NULL || strncmp(path, PACK_URI_PREFIX, strlen(PACK_URI_PREFIX)) == 0)
+    {
+        return false;
+    }
+
+    char resolved[PATH_MAX];
+    struct stat st;
+    if (realpath(path, resolved) == NULL || stat(resolved, &st) != 0)
+    {
+        return false;
+    }
+
+    // a changed image or a grid with other cells gets a file of its own
+    char key[PATH_MAX + 128];
+    int length = snprintf(key, sizeof(key), "%s\n%lld\n%lld\n%dx%d", resolved, (long long)st.st_mtime, (long long)st.st_size, pool->width, pool->height);
+    uint64_t hash = 14695981039346656037ULL;
+    for (int i = 0; i < length && i < (int)sizeof(key); i++)
+    {
+        hash ^= (unsigned char)key[i];
+        hash *= 1099511628211ULL;
+    }
+
+    snprintf(cache_path, size, "%s/%016llx.thumb", pool->cache_directory, (unsigned long long)hash);
+    return true;
+}
+
+// thumbnail_read loads a thumbnail kept on disk, NULL when there is none
+static SDL_Surface *thumbnail_read(const char *cache_path)
+{
+    FILE *file = fopen(cache_path, "rb");
+    if (file == NULL)
+    {
+        return NULL;
+    }
+
+    struct ThumbnailHeader header;
+    SDL_Surface *surface = NULL;
+    Bytef *data = NULL;
+    if (fread(&header, sizeof(header), 1, file) == 1 &&
+        memcmp(header.magic, THUMBNAIL_MAGIC, sizeof(header.magic)) == 0 &&
+        header.version == THUMBNAIL_VERSION &&
+        header.byte_order == DECK_BYTE_ORDER &&
+        header.width > 0 && header.width <= FIXED_WIDTH &&
+        header.height > 0 && header.height <= FIXED_HEIGHT &&
+        header.data_size <= compressBound((uLong)header.width * header.height * 4))
+    {
+        size_t pixels_size = (size_t)header.width * header.height * 4;
+        uLongf length = pixels_size;
+        data = malloc(header.data_size);
+        surface = SDL_CreateRGBSurface(0, header.width, header.height, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+        if (data == NULL || surface == NULL || surface->pitch != (int)header.width * 4 ||
+            fread(data, 1, header.data_size, file) != header.data_size ||
+            uncompress(surface->pixels, &length, data, header.data_size) != Z_OK || length != pixels_size)
+        {
+            if (surface != NULL)
+            {
+                SDL_FreeSurface(surface);
+            }
+            surface = NULL;
+        }
+    }
+
+    free(data);
+    fclose(file);
+    return surface;
+}
+
+// thumbnail_write keeps a thumbnail on disk. it is written to a temporary
+// file first, so other processes never read half of it
+static void thumbnail_write(const char *cache_path, const char *directory, SDL_Surface *surface)
+{
+    size_t pixels_size = (size_t)surface->w * surface->h * 4;
+    uLongf length = compressBound(pixels_size);
+    Bytef *data = surface->pitch == surface->w * 4 ? malloc(length) : NULL;
+    if (data == NULL || compress2(data, &length, surface->pixels, pixels_size, Z_BEST_SPEED) != Z_OK)
+    {
+        free(data);
+        return;
+    }
+
+    char temporary[PATH_MAX];
+    snprintf(temporary, sizeof(temporary), "%s/.thumbnail-XXXXXX", directory);
+    int fd = mkstemp(temporary);
+    FILE *file = fd == -1 ? NULL : fdopen(fd, "wb");
+    if (file == NULL)
+    {
+        if (fd != -1)
+        {
+            close(fd);
+            unlink(temporary);
+        }
+        free(data);
+        return;
+    }
+
+    struct ThumbnailHeader header = {
+        .version = THUMBNAIL_VERSION,
+        .byte_order = DECK_BYTE_ORDER,
+        .width = surface->w,
+        .height = surface->h,
+        .data_size = length,
+    };
+    memcpy(header.magic, THUMBNAIL_MAGIC, sizeof(header.magic));
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(data, 1, length, file) == length;
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(temporary, cache_path) != 0)
+    {
+        unlink(temporary);
+    }
+    free(data);
+}
+
+// make_thumbnail decodes an image and shrinks it to fit within width x height
+// right away, so only the thumbnail is kept around
+static SDL_Surface *make_thumbnail(const char *path, int width, int height)
+{
+    bool prescaled;
+    SDL_Surface *image = load_background_image(path, &prescaled);
+    if (image == NULL)
+    {
+        return NULL;
+    }
+
+    // small images aren't blown up, they are centered in their cell
+    float scale = MIN(MIN((float)width / image->w, (float)height / image->h), 1.0f);
+    int thumbnail_w = MAX((int)(image->w * scale), 1);
+    int thumbnail_h = MAX((int)(image->h * scale), 1);
+
+    // averaging needs a byte per channel, other images are converted first
+    SDL_Surface *source = image;
+    if (image->format->BytesPerPixel < 3)
+    {
+        source = SDL_CreateRGBSurface(0, image->w, image->h, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+        if (source != NULL)
+        {
+#ifdef USE_SDL2
+            SDL_SetSurfaceBlendMode(image, SDL_BLENDMODE_NONE);
+#else
+            SDL_SetAlpha(image, 0, SDL_ALPHA_OPAQUE);
+#endif
+            SDL_BlitSurface(image, NULL, source, NULL);
+        }
+    }
+
+    SDL_Surface *shrunk = source;
+    if (source != NULL && (source->w != thumbnail_w || source->h != thumbnail_h))
+    {
+        shrunk = scale_surface(source, thumbnail_w, thumbnail_h);
+    }
+
+    SDL_Surface *thumbnail = NULL;
+    if (shrunk != NULL)
+    {
+        thumbnail = SDL_CreateRGBSurface(0, thumbnail_w, thumbnail_h, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+    }
+    if (thumbnail != NULL)
+    {
+#ifdef USE_SDL2
+        SDL_SetSurfaceBlendMode(shrunk, SDL_BLENDMODE_NONE);
+#else
+        SDL_SetAlpha(shrunk, 0, SDL_ALPHA_OPAQUE);
+#endif
+        SDL_BlitSurface(shrunk, NULL, thumbnail, NULL);
+    }
+
+    if (shrunk != NULL && shrunk != source)
+    {
+        SDL_FreeSurface(shrunk);
+    }
+    if (source != NULL && source != image)
+    {
+        SDL_FreeSurface(source);
+    }
+    SDL_FreeSurface(image);
+    return thumbnail;
+}
+
+// ThumbnailPool_Make makes a thumbnail, taking it from the cache on disk when it is there
+static SDL_Surface *ThumbnailPool_Make(struct ThumbnailPool *pool, const char *path)
+{
+    char cache_path[PATH_MAX + 32];
+    bool cached = thumbnail_cache_path(pool, path, cache_path, sizeof(cache_path));
+    SDL_Surface *thumbnail = cached ? thumbnail_read(cache_path) : NULL;
+    if (thumbnail == NULL)
+    {
+        thumbnail = make_thumbnail(path, pool->width, pool->height);
+        if (thumbnail != NULL && cached)
+        {
+            thumbnail_write(cache_path, pool->cache_directory, thumbnail);
+        }
+    }
+    return thumbnail;
+}
+
+// ThumbnailPool_Worker makes the wanted thumbnails until the pool stops
+static void *ThumbnailPool_Worker(void *arg)
+{
+    struct ThumbnailPool *pool = arg;
+
+    pthread_mutex_lock(&pool->lock);
+    while (!pool->stopping)
+    {
+        if (pool->wanted_taken == pool->wanted_count)
+        {
+            pthread_cond_wait(&pool->wake, &pool->lock);
+            continue;
+        }
+
+        // the path of a slot being made stays put, the slot isn't reused until it is done
+        struct Thumbnail *slot = &pool->slots[pool->wanted[pool->wanted_taken++]];
+        slot->loading = true;
+        pthread_mutex_unlock(&pool->lock);
+        SDL_Surface *surface = ThumbnailPool_Make(pool, slot->path);
+        pthread_mutex_lock(&pool->lock);
+
+        slot->surface = surface;
+        slot->loading = false;
+        slot->done = true;
+        if (slot->used == pool->draws)
+        {
+            pool->fresh = true;
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
+
+// ThumbnailPool_Free stops the workers and frees the thumbnails
+void ThumbnailPool_Free(struct ThumbnailPool *pool)
+{
+    if (pool == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->thread_count; i++)
+    {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    for (size_t i = 0; i < pool->slot_count; i++)
+    {
+        if (pool->slots[i].surface != NULL)
+        {
+            SDL_FreeSurface(pool->slots[i].surface);
+        }
+        free(pool->slots[i].path);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->wake);
+    free(pool->slots);
+    free(pool->cache_directory);
+    free(pool);
+}
+
+// ThumbnailPool_New starts making thumbnails that fit within width x height
+// for a grid of cells, kept on disk in cache_directory unless it is empty
+struct ThumbnailPool *ThumbnailPool_New(int width, int height, int cells, const char *cache_directory)
+{
+    struct ThumbnailPool *pool = calloc(1, sizeof(struct ThumbnailPool));
+    if (pool == NULL)
+    {
+        return NULL;
+    }
+
+    // a slot is left for every worker on top of the screens kept, so the
+    // cells on screen always find one that isn't being made
+    pool->slot_count = (size_t)cells * THUMBNAIL_CACHE_SCREENS + THUMBNAIL_MAX_THREADS;
+    pool->slots = calloc(pool->slot_count, sizeof(struct Thumbnail));
+    if (pool->slots == NULL)
+    {
+        free(pool);
+        return NULL;
+    }
+    for (size_t i = 0; i < pool->slot_count; i++)
+    {
+        pool->slots[i].item = -1;
+    }
+
+    pool->width = width;
+    pool->height = height;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+
+    if (strcmp(cache_directory, "") != 0)
+    {
+        if (mkdir(cache_directory, 0755) != 0 && errno != EEXIST)
+        {
+            log_error("Failed to create thumbnail cache directory, keeping thumbnails in memory only");
+        }
+        else
+        {
+            pool->cache_directory = strdup(cache_directory);
+        }
+    }
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int thread_count = cores < 1 ? 1 : cores > THUMBNAIL_MAX_THREADS ? THUMBNAIL_MAX_THREADS : (int)cores;
+
+    // signals are left to the main thread
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    for (int i = 0; i < thread_count; i++)
+    {
+        if (pthread_create(&pool->threads[i], NULL, ThumbnailPool_Worker, pool) != 0)
+        {
+            break;
+        }
+        pool->thread_count++;
+    }
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+    if (pool->thread_count == 0)
+    {
+        log_error("Failed to start thumbnail threads, making thumbnails inline");
+    }
+    return pool;
+}
+
+// ThumbnailPool_Want looks up the thumbnails of the cells on screen, filling
+// in NULL for the ones that aren't made yet. the missing ones replace the
+// ones wanted before, so cells scrolled past are never made
+void ThumbnailPool_Want(struct ThumbnailPool *pool, long first, int count, char **paths, SDL_Surface **thumbnails)
+{
+    pthread_mutex_lock(&pool->lock);
+    unsigned long draw = ++pool->draws;
+    pool->fresh = false;
+    pool->wanted_count = 0;
+    pool->wanted_taken = 0;
+
+    for (int i = 0; i < count; i++)
+    {
+        thumbnails[i] = NULL;
+        if (paths[i] == NULL)
+        {
+            continue;
+        }
+
+        struct Thumbnail *slot = NULL;
+        struct Thumbnail *oldest = NULL;
+        for (size_t j = 0; j < pool->slot_count && slot == NULL; j++)
+        {
+            struct Thumbnail *candidate = &pool->slots[j];
+            if (candidate->item == first + i && strcmp(candidate->path, paths[i]) == 0)
+            {
+                slot = candidate;
+            }
+            else if (!candidate->loading && candidate->used != draw && (oldest == NULL || candidate->used < oldest->used))
+            {
+                oldest = candidate;
+            }
+        }
+
+        if (slot == NULL)
+        {
+            char *path = strdup(paths[i]);
+            if (path == NULL || oldest == NULL)
+            {
+                free(path);
+                continue;
+            }
+
+            if (oldest->surface != NULL)
+            {
+                SDL_FreeSurface(oldest->surface);
+            }
+            free(oldest->path);
+            slot = oldest;
+            *slot = (struct Thumbnail){.item = first + i, .path = path};
+        }
+        slot->used = draw;
+
+        // without workers the thumbnails are made as the grid is drawn
+        if (!slot->done && pool->thread_count == 0)
+        {
+            slot->surface = ThumbnailPool_Make(pool, slot->path);
+            slot->done = true;
+        }
+
+        if (slot->done)
+        {
+            thumbnails[i] = slot->surface;
+        }
+        else if (!slot->loading)
+        {
+            pool->wanted[pool->wanted_count++] = slot - pool->slots;
+        }
+    }
+
+    if (pool->wanted_count > 0)
+    {
+        pthread_cond_broadcast(&pool->wake);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// ThumbnailPool_Fresh returns whether thumbnails of the cells on screen were
+// made since the grid was last drawn
+bool ThumbnailPool_Fresh(struct ThumbnailPool *pool)
+{
+    pthread_mutex_lock(&pool->lock);
+    bool fresh = pool->fresh;
+    pthread_mutex_unlock(&pool->lock);
+    return fresh;
+}
+
+// grid_cell returns where a cell of the grid view goes on the screen,
+// counting the cells from the top left one, row by row
+static SDL_Rect grid_cell(struct AppState *state, int cell)
+{
+    int gap = SCALE1(PADDING);
+    int width = (FIXED_WIDTH - gap) / state->grid_columns - gap;
+    int height = (FIXED_HEIGHT - gap) / state->grid_rows - gap;
+    SDL_Rect rect = {
+        gap + (cell % state->grid_columns) * (width + gap),
+        gap + (cell / state->grid_columns) * (height + gap),
+        width,
+        height};
+    return rect;
+}
+
+// draw_grid draws the rows of items around the selected one as thumbnails
+// with their text over them. only the items on screen are looked at, cells
+// whose thumbnail isn't made yet show their background color until it is
+static void draw_grid(SDL_Surface *screen, struct AppState *state)
+{
+    struct ItemsState *items_state = state->items_state;
+    int columns = state->grid_columns;
+    int cells = columns * state->grid_rows;
+
+    // the grid scrolls by whole rows to keep the selection on screen
+    long row = items_state->selected / columns;
+    if (row < state->grid_top)
+    {
+        state->grid_top = row;
+    }
+    else if (row >= state->grid_top + state->grid_rows)
+    {
+        state->grid_top = row - state->grid_rows + 1;
+    }
+
+    long first = state->grid_top * columns;
+    long remaining = (long)items_state->item_count - first;
+    int count = remaining < cells ? (int)remaining : cells;
+
+    struct Item items[GRID_MAX_SIZE * GRID_MAX_SIZE];
+    char *paths[GRID_MAX_SIZE * GRID_MAX_SIZE];
+    SDL_Surface *thumbnails[GRID_MAX_SIZE * GRID_MAX_SIZE];
+    for (int i = 0; i < count; i++)
+    {
+        if (!ItemsState_Peek(items_state, first + i, &items[i]))
+        {
+            items[i] = (struct Item){0};
+        }
+        paths[i] = items[i].background_image;
+    }
+    ThumbnailPool_Want(state->thumbnails, first, count, paths, thumbnails);
+
+    SDL_FillRect(screen, NULL, SDL_MapRGBA(screen->format, 0, 0, 0, 255));
+    int padding = SCALE1(PADDING);
+    for (int i = 0; i < count; i++)
+    {
+        struct Item *item = &items[i];
+        SDL_Rect rect = grid_cell(state, i);
+
+        // the selected cell is framed
+        if (first + i == items_state->selected)
+        {
+            int border = SCALE1(2);
+            SDL_Rect frame = {rect.x - border, rect.y - border, rect.w + border * 2, rect.h + border * 2};
+            SDL_FillRect(screen, &frame, SDL_MapRGBA(screen->format, 255, 255, 255, 255));
+        }
+        SDL_FillRect(screen, &rect, item_background_color(screen, item));
+
+        SDL_Surface *thumbnail = thumbnails[i];
+        if (thumbnail != NULL)
+        {
+            SDL_Rect position = {rect.x + (rect.w - thumbnail->w) / 2, rect.y + (rect.h - thumbnail->h) / 2, thumbnail->w, thumbnail->h};
+            SDL_BlitSurface(thumbnail, NULL, screen, &position);
+        }
+
+        if (item->text == NULL || item->text[0] == '\0')
+        {
+            continue;
+        }
+
+        SDL_Surface *text = TTF_RenderUTF8_Blended(state->fonts.small, item->text, COLOR_WHITE);
+        if (text == NULL)
+        {
+            continue;
+        }
+
+        // text wider than the cell is cut off at its end
+        SDL_Rect clip = {0, 0, MIN(text->w, rect.w - padding * 2), text->h};
+
+        SDL_Rect pill_rect = {rect.x + (rect.w - clip.w) / 2 - padding, rect.y + (rect.h - SCALE1(PILL_SIZE)) / 2, clip.w + padding * 2, SCALE1(PILL_SIZE)};
+        if (item->alignment == MessageAlignmentTop)
+        {
+            pill_rect.y = rect.y + padding / 2;
+        }
+        else if (item->alignment == MessageAlignmentBottom)
+        {
+            pill_rect.y = rect.y + rect.h - pill_rect.h - padding / 2;
+        }
+
+        if (item->show_pill)
+        {
+            pthread_mutex_lock(&gfx_lock);
+            GFX_blitPill(ASSET_BLACK_PILL, screen, &pill_rect);
+            pthread_mutex_unlock(&gfx_lock);
+        }
+
+        SDL_Rect position = {pill_rect.x + padding, pill_rect.y + (pill_rect.h - clip.h) / 2, clip.w, clip.h};
+        SDL_BlitSurface(text, &clip, screen, &position);
+        SDL_FreeSurface(text);
+    }
+}
+
+// draw_screen interprets the app state and draws it to the screen
+void draw_screen(SDL_Surface *screen, struct AppState *state)
+{
+    if (state->grid_shown)
+    {
+        draw_grid(screen, state);
+    }
+    else
+    {
+        struct Item *item = ItemsState_Current(state->items_state);
+        state->progress_bar.rect = draw_item(screen, state, item);
+        if (item->progress != NULL)
+        {
+            ProgressBar_Draw(&state->progress_bar, screen, true);
+        }
+    }
+
+    // don't forget to reset the should_redraw flag
+    state->redraw = 0;
+}
+
+// FrameCache_Wanted returns whether index is one of count wanted items
+static bool FrameCache_Wanted(long index, const long *wanted, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (wanted[i] == index)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// FrameCache_Plan lists the items the selection is likely to move to next,
+// most likely first, returning how many it listed
+int FrameCache_Plan(struct FrameCache *cache, struct AppState *state, long *wanted)
+{
+    struct ItemsState *items_state = state->items_state;
+    long count = (long)items_state->item_count;
+
+    // a countdown changes the whole screen every second, nothing can be drawn ahead of it
+    if (cache->capacity == 0 || count < 2 || (state->show_time_left && state->timeout_seconds > 0))
+    {
+        return 0;
+    }
+
+    long selected = items_state->selected;
+    if (cache->selected != -1 && selected != cache->selected)
+    {
+        if (selected == (cache->selected + 1) % count)
+        {
+            cache->direction = 1;
+        }
+        else if (selected == (cache->selected + count - 1) % count)
+        {
+            cache->direction = -1;
+        }
+    }
+    cache->selected = selected;
+
+    // the next item in the direction of the last step comes first, then the
+    // previous one, then the ones further ahead, so repeated SIGUSR1 or
+    // SIGUSR2 keep finding their items drawn. a running slideshow moves
+    // forwards whichever way the last step went. while items are still parsed
+    // in the background the last one isn't known, so nothing wraps around
+    int direction = state->slideshow.deadline != 0 ? 1 : cache->direction;
+    bool wrap = state->items_progress == NULL;
+    int wanted_count = 0;
+    for (int i = 0; i < cache->capacity; i++)
+    {
+        long index = selected + (i == 0 ? 1 : i == 1 ? -1 : i) * direction;
+        if (wrap)
+        {
+            index = (index % count + count) % count;
+        }
+        if (index >= 0 && index < count && index != selected && !FrameCache_Wanted(index, wanted, wanted_count))
+        {
+            wanted[wanted_count++] = index;
+        }
+    }
+
+    return wanted_count;
+}
+
+// FrameCache_Find returns the drawing of an item, NULL when it wasn't drawn
+struct CachedFrame *FrameCache_Find(struct FrameCache *cache, long index)
+{
+    for (int i = 0; i < cache->capacity; i++)
+    {
+        if (cache->frames[i].item == index)
+        {
+            return &cache->frames[i];
+        }
+    }
+    return NULL;
+}
+
+// FrameCache_Fill draws an item into the slot of one that is no longer wanted
+bool FrameCache_Fill(struct FrameCache *cache, SDL_Surface *screen, struct AppState *state, long index, struct Item *item, const long *wanted, int wanted_count)
+{
+    struct CachedFrame *frame = NULL;
+    for (int i = 0; i < cache->capacity && frame == NULL; i++)
+    {
+        if (!FrameCache_Wanted(cache->frames[i].item, wanted, wanted_count))
+        {
+            frame = &cache->frames[i];
+        }
+    }
+    if (frame == NULL)
+    {
+        return false;
+    }
+
+    if (frame->surface == NULL)
+    {
+        SDL_PixelFormat *format = screen->format;
+        frame->surface = SDL_CreateRGBSurface(0, screen->w, screen->h, format->BitsPerPixel, format->Rmask, format->Gmask, format->Bmask, format->Amask);
+        if (frame->surface == NULL)
+        {
+            log_error("Failed to allocate frame, not drawing ahead");
+            FrameCache_Free(cache);
+            return false;
+        }
+#ifdef USE_SDL2
+        SDL_SetSurfaceBlendMode(frame->surface, SDL_BLENDMODE_NONE);
+#else
+        SDL_SetAlpha(frame->surface, 0, SDL_ALPHA_OPAQUE);
+#endif
+    }
+
+    frame->item = -1;
+    frame->bar_rect = draw_item(frame->surface, state, item);
+    frame->image_drawn = item->background_image != NULL && item->image_exists;
+    frame->item = index;
+    return true;
+}
+
+// FrameCache_Build draws one of the items the selection is likely to move to
+// next into the cache, returning whether it drew one. it is run on frames
+// that are otherwise idle, so it never draws more than a single item
+bool FrameCache_Build(struct FrameCache *cache, SDL_Surface *screen, struct AppState *state)
+{
+    long wanted[RENDER_AHEAD_MAX_FRAMES];
+    int wanted_count = FrameCache_Plan(cache, state, wanted);
+    for (int i = 0; i < wanted_count; i++)
+    {
+        // lazily loaded items outside of the parsed window are left for later
+        struct Item item;
+        if (FrameCache_Find(cache, wanted[i]) != NULL || !ItemsState_Peek(state->items_state, wanted[i], &item))
+        {
+            continue;
+        }
+
+        return FrameCache_Fill(cache, screen, state, wanted[i], &item, wanted, wanted_count);
+    }
+
+    return false;
+}
+
+// FrameCache_Usable returns whether the drawing of an item can be shown as
+// it is. an image that was missing when the item was drawn may be there now
+static bool FrameCache_Usable(struct CachedFrame *frame, struct Item *item)
+{
+    return item->background_image == NULL || frame->image_drawn;
+}
+
+// FrameCache_Draw draws the selected item by copying it from the cache,
+// returning false when it wasn't drawn ahead of time. its progress bar is
+// drawn over it, just like draw_screen would
+bool FrameCache_Draw(struct FrameCache *cache, SDL_Surface *screen, struct AppState *state)
+{
+    struct ItemsState *items_state = state->items_state;
+    struct Item *item = ItemsState_Current(items_state);
+    struct CachedFrame *frame = FrameCache_Find(cache, items_state->selected);
+    if (frame == NULL)
+    {
+        return false;
+    }
+    if (!FrameCache_Usable(frame, item))
+    {
+        frame->item = -1;
+        return false;
+    }
+
+    SDL_BlitSurface(frame->surface, NULL, screen, NULL);
+    if (item->background_image != NULL)
+    {
+        item->image_exists = true;
+    }
+
+    state->progress_bar.rect = frame->bar_rect;
+    if (item->progress != NULL)
+    {
+        ProgressBar_Draw(&state->progress_bar, screen, true);
+    }
+
+    state->redraw = 0;
+    return true;
+}
+
+// the length of a transition unless --transition-duration sets it, in milliseconds
+#define TRANSITION_DEFAULT_MS 250
+// the time a transition frame may take to compose, in microseconds. a frame
+// taking longer would miss the refresh, so the transition is cut short instead
+#define TRANSITION_FRAME_BUDGET_US 12000
+// the final frame of a transition is shown this many times, so screens that
+// flip between two buffers hold it in both
+#define TRANSITION_FINAL_FRAMES 2
+
+// Transition animates the change from one item to the next (--transition).
+// the frame on screen and the composed frame of the next item are kept, and
+// every frame of the transition blends or slides between the two, so the
+// item is drawn once however long the transition runs
+struct Transition
+{
+    // how the running transition animates, TransitionKindNone when none is running
+    enum TransitionKind kind;
+    // the frame shown before the change
+    SDL_Surface *previous;
+    // the frame being changed to
+    SDL_Surface *next;
+    // the item previous shows, -1 while it holds no frame
+    long item;
+    // the item next shows
+    long target;
+    // 1 when the next item comes after the previous one, -1 when before it
+    int direction;
+    // number of times the final frame was shown
+    int final_frames;
+    // when the running transition started
+    struct timespec start;
+};
+
+// blend_rgb565 mixes count RGB565 pixels of a and b into dst, weight 0
+// giving a and 32 giving b. the vector paths compute exactly what the
+// scalar one does, eight pixels at a time
+static void blend_rgb565(uint16_t *dst, const uint16_t *a, const uint16_t *b, size_t count, unsigned weight)
+{
+    size_t i = 0;
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    uint16x8_t weight_a = vdupq_n_u16(32 - weight);
+    uint16x8_t weight_b = vdupq_n_u16(weight);
+    uint16x8_t mask6 = vdupq_n_u16(0x3F);
+    uint16x8_t mask5 = vdupq_n_u16(0x1F);
+    for (; i + 8 <= count; i += 8)
+    {
+        uint16x8_t pa = vld1q_u16(a + i);
+        uint16x8_t pb = vld1q_u16(b + i);
+        uint16x8_t r = vshrq_n_u16(vmlaq_u16(vmulq_u16(vshrq_n_u16(pa, 11), weight_a), vshrq_n_u16(pb, 11), weight_b), 5);
+        uint16x8_t g = vshrq_n_u16(vmlaq_u16(vmulq_u16(vandq_u16(vshrq_n_u16(pa, 5), mask6), weight_a), vandq_u16(vshrq_n_u16(pb, 5), mask6), weight_b), 5);
+        uint16x8_t bl = vshrq_n_u16(vmlaq_u16(vmulq_u16(vandq_u16(pa, mask5), weight_a), vandq_u16(pb, mask5), weight_b), 5);
+        vst1q_u16(dst + i, vorrq_u16(vorrq_u16(vshlq_n_u16(r, 11), vshlq_n_u16(g, 5)), bl));
+    }
+#elif defined(__SSE2__)
+    __m128i weight_a = _mm_set1_epi16(32 - weight);
+    __m128i weight_b = _mm_set1_epi16(weight);
+    __m128i mask6 = _mm_set1_epi16(0x3F);
+    __m128i mask5 = _mm_set1_epi16(0x1F);
+    for (; i + 8 <= count; i += 8)
+    {
+        __m128i pa = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i pb = _mm_loadu_si128((const __m128i *)(b + i));
+        __m128i r = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_srli_epi16(pa, 11), weight_a), _mm_mullo_epi16(_mm_srli_epi16(pb, 11), weight_b)), 5);
+        __m128i g = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(pa, 5), mask6), weight_a), _mm_mullo_epi16(_mm_and_si128(_mm_srli_epi16(pb, 5), mask6), weight_b)), 5);
+        __m128i bl = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_and_si128(pa, mask5), weight_a), _mm_mullo_epi16(_mm_and_si128(pb, mask5), weight_b)), 5);
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(_mm_or_si128(_mm_slli_epi16(r, 11), _mm_slli_epi16(g, 5)), bl));
+    }
+#endif
+
+    // the channels are spread over a 32 bit word with room to multiply each in place
+    for (; i < count; i++)
+    {
+        uint32_t pa = a[i];
+        uint32_t pb = b[i];
+        pa = (pa | pa << 16) & 0x07E0F81F;
+        pb = (pb | pb << 16) & 0x07E0F81F;
+        uint32_t mixed = ((pa * (32 - weight) + pb * weight) >> 5) & 0x07E0F81F;
+        dst[i] = (uint16_t)(mixed | mixed >> 16);
+    }
+}
+
+// blend_8888 mixes count 32 bit pixels of a and b into dst, weight 0 giving
+// a and 256 giving b. two channels are mixed per multiplication
+static void blend_8888(uint32_t *dst, const uint32_t *a, const uint32_t *b, size_t count, unsigned weight)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32_t odd = ((a[i] & 0x00FF00FF) * (256 - weight) + (b[i] & 0x00FF00FF) * weight) >> 8;
+        uint32_t even = ((a[i] >> 8) & 0x00FF00FF) * (256 - weight) + ((b[i] >> 8) & 0x00FF00FF) * weight;
+        dst[i] = (odd & 0x00FF00FF) | (even & 0xFF00FF00);
+    }
+}
+
+// copy_frame copies the pixels of a frame into another of the same size and format
+static void copy_frame(SDL_Surface *dst, SDL_Surface *src)
+{
+    size_t row = (size_t)src->w * src->format->BytesPerPixel;
+    for (int y = 0; y < src->h; y++)
+    {
+        memcpy((uint8_t *)dst->pixels + y * dst->pitch, (const uint8_t *)src->pixels + y * src->pitch, row);
+    }
+}
+
+// Transition_Free releases the frames of the transitions
+void Transition_Free(struct Transition *transition)
+{
+    SDL_Surface *frames[2] = {transition->previous, transition->next};
+    for (int i = 0; i < 2; i++)
+    {
+        if (frames[i] != NULL)
+        {
+            SDL_FreeSurface(frames[i]);
+        }
+    }
+    transition->previous = NULL;
+    transition->next = NULL;
+    transition->kind = TransitionKindNone;
+    transition->item = -1;
+}
+
+// Transition_Compose draws the frame of the running transition that is
+// progress (0 to 1) of the way through onto the screen
+static void Transition_Compose(struct Transition *transition, SDL_Surface *screen, double progress)
+{
+    SDL_Surface *previous = transition->previous;
+    SDL_Surface *next = transition->next;
+    int bytes = screen->format->BytesPerPixel;
+
+    if (transition->kind == TransitionKindSlide)
+    {
+        // the next frame pushes the previous one out, from the right when moving forwards
+        int offset = (int)(screen->w * progress);
+        int kept = screen->w - offset;
+        for (int y = 0; y < screen->h; y++)
+        {
+            uint8_t *row = (uint8_t *)screen->pixels + y * screen->pitch;
+            const uint8_t *row_previous = (const uint8_t *)previous->pixels + y * previous->pitch;
+            const uint8_t *row_next = (const uint8_t *)next->pixels + y * next->pitch;
+            if (transition->direction > 0)
+            {
+                memcpy(row, row_previous + (size_t)offset * bytes, (size_t)kept * bytes);
+                memcpy(row + (size_t)kept * bytes, row_next, (size_t)offset * bytes);
+            }
+            else
+            {
+                memcpy(row, row_next + (size_t)kept * bytes, (size_t)offset * bytes);
+                memcpy(row + (size_t)offset * bytes, row_previous, (size_t)kept * bytes);
+            }
+        }
+        return;
+    }
+
+    for (int y = 0; y < screen->h; y++)
+    {
+        void *row = (uint8_t *)screen->pixels + y * screen->pitch;
+        const void *row_previous = (const uint8_t *)previous->pixels + y * previous->pitch;
+        const void *row_next = (const uint8_t *)next->pixels + y * next->pitch;
+        if (bytes == 2)
+        {
+            blend_rgb565(row, row_previous, row_next, screen->w, (unsigned)(progress * 32));
+        }
+        else
+        {
+            blend_8888(row, row_previous, row_next, screen->w, (unsigned)(progress * 256));
+        }
+    }
+}
+
+// Transition_Begin starts animating the change to the item just drawn onto
+// the screen, returning whether it did. the screen then shows the first
+// frame of the transition. a change that isn't animated only keeps the
+// frame for the next change. shown is the index of the item drawn, which
+// lags behind the selection while a render thread catches up
+bool Transition_Begin(struct Transition *transition, SDL_Surface *screen, struct AppState *state, long shown)
+{
+    struct ItemsState *items_state = state->items_state;
+    if (state->transition == TransitionKindNone && !items_state->transitions)
+    {
+        return false;
+    }
+
+    SDL_Surface **frames[2] = {&transition->previous, &transition->next};
+    for (int i = 0; i < 2; i++)
+    {
+        if (*frames[i] == NULL)
+        {
+            SDL_PixelFormat *format = screen->format;
+            *frames[i] = SDL_CreateRGBSurface(0, screen->w, screen->h, format->BitsPerPixel, format->Rmask, format->Gmask, format->Bmask, format->Amask);
+            if (*frames[i] == NULL)
+            {
+                log_error("Failed to allocate transition frames, changing items at once");
+                Transition_Free(transition);
+                state->transition = TransitionKindNone;
+                items_state->transitions = false;
+                return false;
+            }
+        }
+    }
+
+    // a change while a transition runs starts from the item it was changing to
+    if (transition->kind != TransitionKindNone)
+    {
+        SDL_Surface *previous = transition->previous;
+        transition->previous = transition->next;
+        transition->next = previous;
+        transition->item = transition->target;
+        transition->kind = TransitionKindNone;
+    }
+
+    enum TransitionKind kind = shown == items_state->selected ? ItemsState_Current(items_state)->transition : TransitionKindDefault;
+    if (kind == TransitionKindDefault)
+    {
+        kind = state->transition;
+    }
+
+    // blending needs 16 or 32 bit pixels, other screens change items at once
+    int bytes = screen->format->BytesPerPixel;
+    if (kind == TransitionKindNone || kind == TransitionKindDefault || (kind == TransitionKindFade && bytes != 2 && bytes != 4) || transition->item == -1 || transition->item == shown)
+    {
+        copy_frame(transition->previous, screen);
+        transition->item = shown;
+        return false;
+    }
+
+    long count = (long)items_state->item_count;
+    transition->direction = shown > transition->item ? 1 : -1;
+    if (transition->item == count - 1 && shown == 0)
+    {
+        transition->direction = 1;
+    }
+    else if (transition->item == 0 && shown == count - 1)
+    {
+        transition->direction = -1;
+    }
+
+    copy_frame(transition->next, screen);
+    transition->kind = kind;
+    transition->target = shown;
+    transition->final_frames = 0;
+    clock_gettime(CLOCK_MONOTONIC, &transition->start);
+    Transition_Compose(transition, screen, 0);
+    return true;
+}
+
+// Transition_Step draws the next frame of the running transition onto the
+// screen. once the transition is over, or a frame can't be composed in time,
+// the screen shows the item it changed to, with its progress bar as it is now
+void Transition_Step(struct Transition *transition, SDL_Surface *screen, struct AppState *state)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double elapsed_ms = (now.tv_sec - transition->start.tv_sec) * 1000.0 + (now.tv_nsec - transition->start.tv_nsec) / 1e6;
+    double progress = state->transition_ms > 0 ? elapsed_ms / state->transition_ms : 1;
+
+    if (transition->final_frames == 0 && progress < 1)
+    {
+        // ease out, the change slows down as it settles
+        progress = 1 - (1 - progress) * (1 - progress);
+        Transition_Compose(transition, screen, progress);
+
+        struct timespec end;
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        long compose_us = (end.tv_sec - now.tv_sec) * 1000000L + (end.tv_nsec - now.tv_nsec) / 1000;
+        if (compose_us <= TRANSITION_FRAME_BUDGET_US)
+        {
+            return;
+        }
+    }
+
+    copy_frame(screen, transition->next);
+    struct Item *item = ItemsState_Current(state->items_state);
+    if (item->progress != NULL && transition->target == state->items_state->selected)
+    {
+        ProgressBar_Draw(&state->progress_bar, screen, false);
+    }
+
+    transition->final_frames++;
+    if (transition->final_frames >= TRANSITION_FINAL_FRAMES)
+    {
+        SDL_Surface *previous = transition->previous;
+        transition->previous = transition->next;
+        transition->next = previous;
+        transition->item = transition->target;
+        transition->kind = TransitionKindNone;
+    }
+}
+
+bool open_fonts(struct AppState *state)
+{
+    if (state->fonts.font_path == NULL)
+    {
+        log_error("No font path provided");
+        return false;
+    }
+
+    // check if the font path is valid
+    if (access(state->fonts.font_path, F_OK) == -1)
+    {
+        log_error("Invalid font path provided");
+        return false;
+    }
+
+    state->fonts.large = TTF_OpenFont(state->fonts.font_path, SCALE1(state->fonts.size));
+    if (state->fonts.large == NULL)
+    {
+        char buff[1024];
+        snprintf(buff, sizeof(buff), "Failed to open large font: %s", TTF_GetError());
+        log_error(buff);
+        return false;
+    }
+    TTF_SetFontStyle(state->fonts.large, TTF_STYLE_BOLD);
+
+    state->fonts.small = TTF_OpenFont(state->fonts.font_path, SCALE1(FONT_SMALL));
+    if (state->fonts.small == NULL)
+    {
+        char buff[1024];
+        snprintf(buff, sizeof(buff), "Failed to open small font: %s", TTF_GetError());
+        log_error(buff);
+        return false;
+    }
+
+    return true;
+}
+
+#define HANDOFF_MAGIC "MPHF"
+#define HANDOFF_VERSION 1
+
+// HandoffHeader starts a --handoff file, followed by the rows of the frame
+struct HandoffHeader
+{
+    // HANDOFF_MAGIC
+    char magic[4];
+    // HANDOFF_VERSION
+    uint32_t version;
+    // the size of the frame in pixels
+    uint32_t width;
+    uint32_t height;
+    // the bytes per row of the frame
+    uint32_t pitch;
+    // the bits per pixel of the frame
+    uint32_t bits_per_pixel;
+};
+
+// Handoff keeps the last frame drawn so it can be left to the next process
+// displaying on the same screen (--handoff). frames are copied right before
+// they are flipped, as the screen may be swapped with another buffer by it
+struct Handoff
+{
+    // the file the frame is written to, empty when not handing off
+    char path[1024];
+    // the file the frame is written to before it is renamed over path
+    char temporary_path[1024 + 8];
+    // the header written in front of the frame
+    struct HandoffHeader header;
+    // two copies of the frame, one is written while the other is complete
+    char *frames[2];
+    // the copy holding the last complete frame, -1 until one is drawn
+    _Atomic int ready;
+};
+
+struct Handoff handoff = {.ready = -1};
+
+// Handoff_Show draws the frame a previous process left at path, removing it
+// so a later process doesn't show a stale frame. frames drawn for another
+// screen size or format are ignored
+bool Handoff_Show(const char *path, SDL_Surface *surface)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+    {
+        return false;
+    }
+    unlink(path);
+
+    struct stat st;
+    size_t size = sizeof(struct HandoffHeader) + (size_t)surface->pitch * surface->h;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size == size)
+    {
+        map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        return false;
+    }
+
+    const struct HandoffHeader *header = map;
+    bool matches = memcmp(header->magic, HANDOFF_MAGIC, sizeof(header->magic)) == 0 &&
+                   header->version == HANDOFF_VERSION &&
+                   header->width == (uint32_t)surface->w &&
+                   header->height == (uint32_t)surface->h &&
+                   header->pitch == (uint32_t)surface->pitch &&
+                   header->bits_per_pixel == surface->format->BitsPerPixel;
+    if (matches)
+    {
+        memcpy(surface->pixels, (const char *)map + sizeof(struct HandoffHeader), (size_t)surface->pitch * surface->h);
+        GFX_flip(surface);
+    }
+
+    munmap(map, size);
+    return matches;
+}
+
+// Handoff_Start starts keeping the frames drawn on surface for path
+bool Handoff_Start(struct Handoff *handoff, const char *path, SDL_Surface *surface)
+{
+    size_t size = (size_t)surface->pitch * surface->h;
+    handoff->frames[0] = malloc(size);
+    handoff->frames[1] = malloc(size);
+    if (handoff->frames[0] == NULL || handoff->frames[1] == NULL)
+    {
+        free(handoff->frames[0]);
+        free(handoff->frames[1]);
+        handoff->frames[0] = handoff->frames[1] = NULL;
+        return false;
+    }
+
+    strncpy(handoff->path, path, sizeof(handoff->path) - 1);
+    snprintf(handoff->temporary_path, sizeof(handoff->temporary_path), "%s.tmp", handoff->path);
+    memcpy(handoff->header.magic, HANDOFF_MAGIC, sizeof(handoff->header.magic));
+    handoff->header.version = HANDOFF_VERSION;
+    handoff->header.width = surface->w;
+    handoff->header.height = surface->h;
+    handoff->header.pitch = surface->pitch;
+    handoff->header.bits_per_pixel = surface->format->BitsPerPixel;
+    return true;
+}
+
+// Handoff_Capture copies a frame that is about to be flipped
+void Handoff_Capture(struct Handoff *handoff, SDL_Surface *surface)
+{
+    if (handoff->frames[0] == NULL)
+    {
+        return;
+    }
+
+    int next = atomic_load(&handoff->ready) == 0 ? 1 : 0;
+    memcpy(handoff->frames[next], surface->pixels, (size_t)handoff->header.pitch * handoff->header.height);
+    atomic_store(&handoff->ready, next);
+}
+
+// Handoff_Write writes the last complete frame for the next process. it
+// only uses async-signal-safe calls, so it also runs when a signal ends
+// the display
+bool Handoff_Write(struct Handoff *handoff)
+{
+    int ready = atomic_load(&handoff->ready);
+    if (ready < 0)
+    {
+        return false;
+    }
+
+    int fd = open(handoff->temporary_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1)
+    {
+        return false;
+    }
+
+    const char *parts[2] = {(const char *)&handoff->header, handoff->frames[ready]};
+    size_t lengths[2] = {sizeof(handoff->header), (size_t)handoff->header.pitch * handoff->header.height};
+    bool ok = true;
+    for (int i = 0; i < 2 && ok; i++)
+    {
+        size_t written = 0;
+        while (written < lengths[i])
+        {
+            ssize_t n = write(fd, parts[i] + written, lengths[i] - written);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                ok = false;
+                break;
+            }
+            written += n;
+        }
+    }
+    close(fd);
+
+    // the next process only ever sees a whole frame
+    if (!ok || rename(handoff->temporary_path, handoff->path) != 0)
+    {
+        unlink(handoff->temporary_path);
+        return false;
+    }
+    return true;
+}
+
+// signal_handler queues the commands sent as signals, SIGRTMIN and
+// SIGRTMIN + 1 carry their argument sent with sigqueue. signals that end
+// the app only record their exit code, the display loop quits with it and
+// writes the handoff frame on its way out
+void signal_handler(int signal, siginfo_t *info, void *context)
+{
+    if (signal == SIGUSR1)
+    {
+        CommandQueue_Push(&command_queue, CommandMove, 1);
+    }
+    else if (signal == SIGUSR2)
+    {
+        CommandQueue_Push(&command_queue, CommandMove, -1);
+    }
+#ifdef SIGRTMIN
+    else if (signal == SIGRTMIN)
+    {
+        CommandQueue_Push(&command_queue, CommandSelect, info->si_value.sival_int);
+    }
+    else if (signal == SIGRTMIN + 1)
+    {
+        CommandQueue_Push(&command_queue, CommandMove, info->si_value.sival_int);
+    }
+#endif
+    else
+    {
+        // if the signal is a ctrl+c, exit with code 130
+        int exit_code = signal == SIGINT ? ExitCodeKeyboardInterrupt : signal == SIGTERM ? ExitCodeSigterm : ExitCodeError;
+
+        // before the display loop runs there is no frame to hand off and
+        // nothing waiting on the exit code, so the process ends at once
+        if (!display_running)
+        {
+            _exit(exit_code);
+        }
+        exit_signal_code = exit_code;
+    }
+}
+
+// DeckStrings collects the string pool of a deck being compiled
+struct DeckStrings
+{
+    // the pool itself
+    char *data;
+    // number of bytes used
+    size_t size;
+    // number of bytes allocated
+    size_t capacity;
+    // maps every string already in the pool to its offset
+    struct InternTable table;
+    // owns the keys of table
+    struct Arena arena;
+};
+
+// DeckStrings_Add returns the pool offset of a string, appending it the first time it is seen
+static bool DeckStrings_Add(struct DeckStrings *strings, const char *string, uint32_t *offset)
+{
+    size_t length = strlen(string);
+    if (length == 0)
+    {
+        *offset = DECK_NO_STRING;
+        return true;
+    }
+
+    struct InternedString *entry = InternTable_Intern(&strings->table, &strings->arena, string, length);
+    if (entry == NULL)
+    {
+        return false;
+    }
+
+    if (entry->data != 0)
+    {
+        *offset = entry->data;
+        return true;
+    }
+
+    if (strings->size + length + 1 > UINT32_MAX)
+    {
+        return false;
+    }
+
+    if (strings->size + length + 1 > strings->capacity)
+    {
+        size_t capacity = strings->capacity == 0 ? 64 * 1024 : strings->capacity;
+        while (strings->size + length + 1 > capacity)
+        {
+            capacity *= 2;
+        }
+
+        char *data = realloc(strings->data, capacity);
+        if (data == NULL)
+        {
+            return false;
+        }
+        strings->data = data;
+        strings->capacity = capacity;
+    }
+
+    memcpy(strings->data + strings->size, string, length + 1);
+    entry->data = strings->size;
+    *offset = strings->size;
+    strings->size += length + 1;
+    return true;
+}
+
+// compile_deck writes the items to a compiled deck file that --file can map
+// directly: a header, a fixed size item table and a deduplicated string pool
+bool compile_deck(struct ItemsState *items_state, const char *path)
+{
+    if (items_state->item_count > UINT32_MAX)
+    {
+        log_error("Too many items to compile");
+        return false;
+    }
+
+    struct DeckItem *entries = calloc(items_state->item_count, sizeof(struct DeckItem));
+
+    // offset 0 holds the empty string so it can stand in for "no string"
+    struct DeckStrings strings = {
+        .data = calloc(1, 64 * 1024),
+        .size = 1,
+        .capacity = 64 * 1024,
+    };
+    bool ok = entries != NULL && strings.data != NULL;
+
+    int selected = items_state->selected;
+    for (size_t i = 0; ok && i < items_state->item_count; i++)
+    {
+        items_state->selected = i;
+        if (!ItemsState_Hydrate(items_state))
+        {
+            ok = false;
+            break;
+        }
+
+        struct Item *item = ItemsState_Current(items_state);
+        struct DeckItem *entry = &entries[i];
+        ok = DeckStrings_Add(&strings, item->text, &entry->text) &&
+             DeckStrings_Add(&strings, item->background_image != NULL ? item->background_image : "", &entry->background_image) &&
+             DeckStrings_Add(&strings, item->progress != NULL ? item->progress : "", &entry->progress);
+
+        entry->background_rgb = item->background_rgb;
+        if (item->background_color != NULL)
+        {
+            SDL_Color color = hex_to_sdl_color(item->background_color);
+            entry->background_rgb = (color.r << 16) | (color.g << 8) | color.b;
+        }
+        entry->show_pill = item->show_pill;
+        entry->alignment = item->alignment;
+        entry->transition = item->transition;
+        entry->duration = item->duration;
+    }
+    items_state->selected = selected;
+
+    struct DeckHeader header = {
+        .version = DECK_VERSION,
+        .byte_order = DECK_BYTE_ORDER,
+        .item_count = items_state->item_count,
+        .selected = selected,
+        .items_offset = sizeof(struct DeckHeader),
+        .strings_offset = sizeof(struct DeckHeader) + sizeof(struct DeckItem) * items_state->item_count,
+        .strings_size = strings.size,
+    };
+    memcpy(header.magic, DECK_MAGIC, sizeof(header.magic));
+
+    if (!ok)
+    {
+        log_error("Failed to compile items");
+    }
+    else
+    {
+        FILE *file = fopen(path, "wb");
+        ok = file != NULL &&
+             fwrite(&header, sizeof(header), 1, file) == 1 &&
+             fwrite(entries, sizeof(struct DeckItem), items_state->item_count, file) == items_state->item_count &&
+             fwrite(strings.data, 1, strings.size, file) == strings.size;
+        if (file != NULL && fclose(file) != 0)
+        {
+            ok = false;
+        }
+
+        if (!ok)
+        {
+            log_error("Failed to write deck file");
+        }
+    }
+
+    free(entries);
+    free(strings.data);
+    InternTable_Free(&strings.table);
+    Arena_Free(&strings.arena);
+    return ok;
+}
+
+// write_pack_padding pads the pack being written to a multiple of alignment
+static bool write_pack_padding(FILE *file, size_t alignment)
+{
+    static const char zeros[16] = {0};
+    long position = ftell(file);
+    size_t padding = position < 0 ? 0 : (alignment - position % alignment) % alignment;
+    return position >= 0 && fwrite(zeros, 1, padding, file) == padding;
+}
+
+// write_pack_image writes the data of a single image and fills in its entry
+static bool write_pack_image(FILE *file, const char *path, enum PackFormat format, struct PackEntry *entry)
+{
+    entry->format = format;
+    entry->data_offset = ftell(file);
+
+    if (format == PackFormatEncoded)
+    {
+        FILE *image = fopen(path, "rb");
+        if (image == NULL)
+        {
+            return false;
+        }
+
+        char buffer[65536];
+        size_t bytes_read;
+        bool ok = true;
+        while (ok && (bytes_read = fread(buffer, 1, sizeof(buffer), image)) > 0)
+        {
+            ok = fwrite(buffer, 1, bytes_read, file) == bytes_read;
+            entry->data_size += bytes_read;
+        }
+        fclose(image);
+        return ok;
+    }
+
+    // raw images are scaled exactly as draw_screen would scale them
+    SDL_Surface *surface = IMG_Load(path);
+    if (surface == NULL)
+    {
+        return false;
+    }
+
+    SDL_Rect rect = background_rect(surface->w, surface->h);
+    SDL_Surface *scaled = SDL_CreateRGBSurface(0, rect.w, rect.h, 32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+    if (scaled == NULL)
+    {
+        SDL_FreeSurface(surface);
+        return false;
+    }
+
+#ifdef USE_SDL2
+    SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_NONE);
+    SDL_BlitScaled(surface, NULL, scaled, NULL);
+#else
+    SDL_SetAlpha(surface, 0, SDL_ALPHA_OPAQUE);
+    if (surface->w == rect.w && surface->h == rect.h)
+    {
+        SDL_BlitSurface(surface, NULL, scaled, NULL);
+    }
+    else
+    {
+        SDL_Surface *resized = scale_surface(surface, rect.w, rect.h);
+        SDL_SetAlpha(resized, 0, SDL_ALPHA_OPAQUE);
+        SDL_BlitSurface(resized, NULL, scaled, NULL);
+        SDL_FreeSurface(resized);
+    }
+#endif
+    SDL_FreeSurface(surface);
+
+    entry->width = scaled->w;
+    entry->height = scaled->h;
+    size_t pixels_size = (size_t)scaled->w * scaled->h * 4;
+    bool ok = scaled->pitch == scaled->w * 4;
+
+    if (ok && format == PackFormatRaw)
+    {
+        ok = fwrite(scaled->pixels, 1, pixels_size, file) == pixels_size;
+        entry->data_size = pixels_size;
+    }
+    else if (ok)
+    {
+        uLongf length = compressBound(pixels_size);
+        Bytef *compressed = malloc(length);
+        ok = compressed != NULL &&
+             compress2(compressed, &length, scaled->pixels, pixels_size, Z_BEST_COMPRESSION) == Z_OK &&
+             fwrite(compressed, 1, length, file) == length;
+        entry->data_size = length;
+        free(compressed);
+    }
+
+    SDL_FreeSurface(scaled);
+    return ok;
+}
+
+// write_asset_pack builds an asset pack out of image files, every image is
+// named after the path it was given as so items can refer to pack://<path>
+bool write_asset_pack(const char *output, char **paths, int path_count, enum PackFormat format)
+{
+    if (path_count <= 0)
+    {
+        log_error("No images provided for --pack");
+        return false;
+    }
+
+    uint32_t bucket_count = 1;
+    while (bucket_count < (uint32_t)path_count * 2)
+    {
+        bucket_count <<= 1;
+    }
+
+    struct PackEntry *entries = calloc(path_count, sizeof(struct PackEntry));
+    uint32_t *buckets = calloc(bucket_count, sizeof(uint32_t));
+    struct DeckStrings names = {
+        .data = calloc(1, 64 * 1024),
+        .size = 1,
+        .capacity = 64 * 1024,
+    };
+    FILE *file = fopen(output, "wb");
+    struct PackHeader header = {
+        .version = PACK_VERSION,
+        .byte_order = DECK_BYTE_ORDER,
+        .entry_count = path_count,
+        .bucket_count = bucket_count,
+        .screen_width = FIXED_WIDTH,
+        .screen_height = FIXED_HEIGHT,
+    };
+    memcpy(header.magic, PACK_MAGIC, sizeof(header.magic));
+
+    // the header is rewritten once the offsets of the tables are known
+    bool ok = entries != NULL && buckets != NULL && names.data != NULL && file != NULL &&
+              fwrite(&header, sizeof(header), 1, file) == 1;
+    if (!ok)
+    {
+        log_error("Failed to write asset pack");
+    }
+
+    char buff[1024];
+    for (int i = 0; ok && i < path_count; i++)
+    {
+        const char *name = paths[i];
+        if (strncmp(name, "./", 2) == 0)
+        {
+            name += 2;
+        }
+
+        struct PackEntry *entry = &entries[i];
+        entry->name_length = strlen(name);
+        entry->hash = hash_string(name, entry->name_length);
+        if (!DeckStrings_Add(&names, name, &entry->name_offset))
+        {
+            log_error("Failed to write asset pack");
+            ok = false;
+            break;
+        }
+
+        uint32_t bucket = entry->hash & (bucket_count - 1);
+        while (buckets[bucket] != 0)
+        {
+            if (entries[buckets[bucket] - 1].name_offset == entry->name_offset)
+            {
+                snprintf(buff, sizeof(buff), "Duplicate image provided for --pack: %s", name);
+                log_error(buff);
+                ok = false;
+                break;
+            }
+            bucket = (bucket + 1) & (bucket_count - 1);
+        }
+        buckets[bucket] = i + 1;
+
+        // pixels are aligned so raw images can be used straight from the mapping
+        if (ok && (!write_pack_padding(file, 16) || !write_pack_image(file, paths[i], format, entry)))
+        {
+            snprintf(buff, sizeof(buff), "Failed to add image to asset pack: %s", paths[i]);
+            log_error(buff);
+            ok = false;
+        }
+    }
+
+    if (ok)
+    {
+        ok = write_pack_padding(file, sizeof(uint64_t));
+        header.entries_offset = ftell(file);
+        ok = ok && fwrite(entries, sizeof(struct PackEntry), path_count, file) == (size_t)path_count;
+        header.buckets_offset = ftell(file);
+        ok = ok && fwrite(buckets, sizeof(uint32_t), bucket_count, file) == bucket_count;
+        header.names_offset = ftell(file);
+        header.names_size = names.size;
+        ok = ok && fwrite(names.data, 1, names.size, file) == names.size;
+        ok = ok && fseek(file, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, file) == 1;
+        if (!ok)
+        {
+            log_error("Failed to write asset pack");
+        }
+    }
+
+    if (file != NULL && fclose(file) != 0)
+    {
+        ok = false;
+    }
+    if (!ok)
+    {
+        unlink(output);
+    }
+
+    free(entries);
+    free(buckets);
+    free(names.data);
+    InternTable_Free(&names.table);
+    Arena_Free(&names.arena);
+    return ok;
+}
+
+// parse_arguments parses the arguments using getopt and updates the app state
+// supports the following flags:
+// - --action-button <button> (default: "")
+// - --action-text <text> (default: "ACTION")
+// - --action-show (default: false)
+// - --background-image <path> (default: empty string)
+// - --background-color <hex> (default: empty string)
+// - --confirm-button <button> (default: "A")
+// - --confirm-text <text> (default: "SELECT")
+// - --confirm-show (default: false)
+// - --cancel-button <button> (default: "B")
+// - --cancel-text <text> (default: "BACK")
+// - --cancel-show (default: false)
+// - --disable-auto-sleep (default: false)
+// - --inaction-button <button> (default: empty string)
+// - --inaction-text <text> (default: "OTHER")
+// - --inaction-show (default: false)
+// - --file <path> (default: empty string)
+// - --item-key <key> (default: "items")
+// - --message <message> (default: empty string)
+// - --message-alignment <alignment> (default: middle)
+// - --font <path> (default: empty string)
+// - --font-size <size> (default: FONT_LARGE)
+// - --quit-after-last-item (default: false)
+// - --render-ahead <megabytes> (default: 0)
+// - --render-thread (default: false)
+// - --transition <none|fade|slide> (default: none)
+// - --transition-duration <milliseconds> (default: TRANSITION_DEFAULT_MS)
+// - --slide-duration <milliseconds> (default: 0)
+// - --directory <path> (default: empty string)
+// - --directory-filter <patterns> (default: DIRECTORY_DEFAULT_FILTER)
+// - --recursive (default: false)
+// - --grid <columns>x<rows> (default: none)
+// - --thumbnail-cache <path> (default: empty string)
+// - --show-hardware-group (default: false)
+// - --show-pill (default: false)
+// - --show-time-left (default: false)
+// - --timeout <seconds> (default: 1)
+bool parse_arguments(struct AppState *state, int argc, char *argv[])
+{
+    static struct option long_options[] = {
+        {"action-button", required_argument, 0, 'a'},
+        {"action-text", required_argument, 0, 'A'},
+        {"asset-pack", required_argument, 0, 'k'},
+        {"background-image", required_argument, 0, 'b'},
+        {"background-color", required_argument, 0, 'B'},
+        {"confirm-button", required_argument, 0, 'c'},
+        {"confirm-text", required_argument, 0, 'C'},
+        {"cancel-button", required_argument, 0, 'd'},
+        {"cancel-text", required_argument, 0, 'D'},
+        {"compile", required_argument, 0, 'O'},
+        {"inaction-button", required_argument, 0, 'i'},
+        {"inaction-text", required_argument, 0, 'I'},
+        {"file", required_argument, 0, 'E'},
+        {"handoff", required_argument, 0, 'H'},
+        {"font-default", required_argument, 0, 'f'},
+        {"follow", no_argument, 0, 'w'},
+        {"font-size-default", required_argument, 0, 'F'},
+        {"item-key", required_argument, 0, 'K'},
+        {"lazy-load", no_argument, 0, 'L'},
+        {"progressive-load", no_argument, 0, 'l'},
+        {"render-ahead", required_argument, 0, 'e'},
+        {"render-thread", no_argument, 0, 'G'},
+        {"transition", required_argument, 0, 'x'},
+        {"transition-duration", required_argument, 0, 'j'},
+        {"slide-duration", required_argument, 0, 's'},
+        {"directory", required_argument, 0, 'u'},
+        {"directory-filter", required_argument, 0, 'z'},
+        {"recursive", no_argument, 0, 'V'},
+        {"grid", required_argument, 0, 'y'},
+        {"thumbnail-cache", required_argument, 0, 'o'},
+        {"render-all", required_argument, 0, 'n'},
+        {"render-format", required_argument, 0, 'N'},
+        {"render-workers", required_argument, 0, 'J'},
+        {"message", required_argument, 0, 'm'},
+        {"message-alignment", required_argument, 0, 'M'},
+        {"pack", required_argument, 0, 'p'},
+        {"pack-format", required_argument, 0, 'g'},
+        {"progress", required_argument, 0, 'r'},
+        {"quit-after-last-item", no_argument, 0, 'Q'},
+        {"show-pill", no_argument, 0, 'P'},
+        {"show-hardware-group", no_argument, 0, 'S'},
+        {"show-time-left", no_argument, 0, 'T'},
+        {"timeout", required_argument, 0, 't'},
+        {"watch", no_argument, 0, 'R'},
+        {"disable-auto-sleep", no_argument, 0, 'U'},
+        {"confirm-show", no_argument, 0, 'W'},
+        {"cancel-show", no_argument, 0, 'X'},
+        {"action-show", no_argument, 0, 'Y'},
+        {"inaction-show", no_argument, 0, 'Z'},
+        {0, 0, 0, 0}};
+
+    int opt;
+    bool compile = false;
+    char *font_path = NULL;
+    char alignment[1024] = "";
+    while ((opt = getopt_long(argc, argv, "a:A:b:B:c:C:d:D:e:E:f:F:g:H:i:I:j:J:k:K:m:M:n:N:o:O:p:r:s:t:u:x:y:z:GlLQPRSTUVwWYXZ", long_options, NULL)) != -1)
+    {
+        switch (opt)
+        {
+        case 'a':
+            strncpy(state->action_button, optarg, sizeof(state->action_button));
+            break;
+        case 'A':
+            strncpy(state->action_text, optarg, sizeof(state->action_text));
+            break;
+        case 'b':
+            strncpy(state->background_image, optarg, sizeof(state->background_image));
+            break;
+        case 'B':
+            strncpy(state->background_color, optarg, sizeof(state->background_color));
+            break;
+        case 'c':
+            strncpy(state->confirm_button, optarg, sizeof(state->confirm_button));
+            break;
+        case 'C':
+            strncpy(state->confirm_text, optarg, sizeof(state->confirm_text));
+            break;
+        case 'd':
+            strncpy(state->cancel_button, optarg, sizeof(state->cancel_button));
+            break;
+        case 'D':
+            strncpy(state->cancel_text, optarg, sizeof(state->cancel_text));
+            break;
+        case 'E':
+            strncpy(state->file, optarg, sizeof(state->file));
+            break;
+        case 'f':
+            font_path = optarg;
+            break;
+        case 'F':
+            state->fonts.size = atoi(optarg);
+            break;
+        case 'i':
+            strncpy(state->inaction_button, optarg, sizeof(state->inaction_button));
+            break;
+        case 'I':
+            strncpy(state->inaction_text, optarg, sizeof(state->inaction_text));
+            break;
+        case 'K':
+            strncpy(state->item_key, optarg, sizeof(state->item_key));
+            break;
+        case 'm':
+            strncpy(state->message, optarg, sizeof(state->message));
+            break;
+        case 'M':
+            strncpy(alignment, optarg, sizeof(alignment));
+            break;
+        case 'g':
+            if (strcmp(optarg, "encoded") == 0)
+            {
+                state->pack_format = PackFormatEncoded;
+            }
+            else if (strcmp(optarg, "raw") == 0)
+            {
+                state->pack_format = PackFormatRaw;
+            }
+            else if (strcmp(optarg, "raw-deflate") == 0)
+            {
+                state->pack_format = PackFormatRawDeflate;
+            }
+            else
+            {
+                log_error("Invalid pack format provided");
+                return false;
+            }
+            break;
+        case 'H':
+            strncpy(state->handoff, optarg, sizeof(state->handoff) - 1);
+            break;
+        case 'k':
+            strncpy(state->asset_pack, optarg, sizeof(state->asset_pack));
+            break;
+        case 'L':
+            state->lazy_load = true;
+            break;
+        case 'l':
+            state->progressive_load = true;
+            break;
+        case 'e':
+            state->render_ahead = atoi(optarg);
+            if (state->render_ahead < 0)
+            {
+                log_error("Invalid render ahead budget provided");
+                return false;
+            }
+            break;
+        case 'G':
+            state->render_thread = true;
+            break;
+        case 'x':
+            if (!parse_transition(optarg, &state->transition))
+            {
+                log_error("Invalid transition provided");
+                return false;
+            }
+            break;
+        case 'j':
+            state->transition_ms = atoi(optarg);
+            if (state->transition_ms < 0)
+            {
+                log_error("Invalid transition duration provided");
+                return false;
+            }
+            break;
+        case 'u':
+            strncpy(state->directory, optarg, sizeof(state->directory) - 1);
+            break;
+        case 'z':
+            strncpy(state->directory_filter, optarg, sizeof(state->directory_filter) - 1);
+            break;
+        case 'V':
+            state->recursive = true;
+            break;
+        case 'y':
+        {
+            char rest;
+            if (sscanf(optarg, "%dx%d%c", &state->grid_columns, &state->grid_rows, &rest) != 2 ||
+                state->grid_columns < 1 || state->grid_columns > GRID_MAX_SIZE ||
+                state->grid_rows < 1 || state->grid_rows > GRID_MAX_SIZE)
+            {
+                log_error("Invalid grid provided, expected <columns>x<rows> of 1 to 8 each");
+                return false;
+            }
+            break;
+        }
+        case 'o':
+            strncpy(state->thumbnail_cache, optarg, sizeof(state->thumbnail_cache) - 1);
+            break;
+        case 's':
+            state->slide_duration_ms = atoi(optarg);
+            if (state->slide_duration_ms < 0)
+            {
+                log_error("Invalid slide duration provided");
+                return false;
+            }
+            break;
+        case 'n':
+            strncpy(state->render_output, optarg, sizeof(state->render_output) - 1);
+            break;
+        case 'J':
+            state->render_workers = atoi(optarg);
+            if (state->render_workers <= 0)
+            {
+                log_error("Invalid number of render workers provided");
+                return false;
+            }
+            break;
+        case 'N':
+            if (strcmp(optarg, "png") == 0)
+            {
+                state->render_format = RenderFormatPNG;
+            }
+            else if (strcmp(optarg, "raw") == 0)
+            {
+                state->render_format = RenderFormatRaw;
+            }
+            else
+            {
+                log_error("Invalid render format provided");
+                return false;
+            }
+            break;
+        case 'p':
+            strncpy(state->pack_output, optarg, sizeof(state->pack_output));
+            break;
+        case 'O':
+            strncpy(state->file, optarg, sizeof(state->file));
+            compile = true;
+            break;
+        case 'r':
+            strncpy(state->progress, optarg, sizeof(state->progress));
+            break;
+        case 'R':
+            state->watch = true;
+            break;
+        case 'Q':
+            state->quit_after_last_item = true;
+            break;
+        case 'P':
+            state->show_pill = true;
+            break;
+        case 'S':
+            state->show_hardware_group = true;
+            break;
+        case 't':
+            state->timeout_seconds = atoi(optarg);
+            break;
+        case 'T':
+            state->show_time_left = true;
+            break;
+        case 'U':
+            state->disable_auto_sleep = true;
+            break;
+        case 'w':
+            state->follow = true;
+            break;
+        case 'W':
+            state->confirm_show = true;
+            break;
+        case 'X':
+            state->cancel_show = true;
+            break;
+        case 'Y':
+            state->action_show = true;
+            break;
+        case 'Z':
+            state->inaction_show = true;
+            break;
+        default:
+            return false;
+        }
+    }
+
+    if (compile)
+    {
+        if (optind >= argc)
+        {
+            log_error("No output path provided for --compile");
+            return false;
+        }
+
+        strncpy(state->compile_output, argv[optind], sizeof(state->compile_output));
+    }
+
+    if (strcmp(state->pack_output, "") != 0)
+    {
+        state->pack_inputs = argv + optind;
+        state->pack_input_count = argc - optind;
+        return true;
+    }
+
+    if (strcmp(state->asset_pack, "") != 0 && !AssetPack_Open(&asset_pack, state->asset_pack))
+    {
+        log_error("Failed to open asset pack");
+        return false;
+    }
+
+    if (strcmp(alignment, "top") == 0)
+    {
+        state->alignment = MessageAlignmentTop;
+    }
+    else if (strcmp(alignment, "bottom") == 0)
+    {
+        state->alignment = MessageAlignmentBottom;
+    }
+    else if (strcmp(alignment, "middle") == 0 || strcmp(alignment, "") == 0)
+    {
+        state->alignment = MessageAlignmentMiddle;
+    }
+    else
+    {
+        log_error("Invalid message alignment provided");
+        return false;
+    }
+
+    if (state->follow && strlen(state->message) == 0 && strcmp(state->file, "-") == 0)
+    {
+        log_error("--follow reads commands from stdin and can not be combined with --file -");
+        return false;
+    }
+
+    if (state->watch && (strlen(state->message) > 0 || strcmp(state->file, "-") == 0 || state->lazy_load || state->follow))
+    {
+        log_error("--watch only applies to --file <path>, and can not be combined with --lazy-load or --follow");
+        return false;
+    }
+
+    if (state->progressive_load && (strlen(state->message) > 0 || strcmp(state->compile_output, "") != 0 || strcmp(state->render_output, "") != 0 || state->lazy_load || state->follow || state->watch))
+    {
+        log_error("--progressive-load only applies to displaying --file, and can not be combined with --lazy-load, --follow or --watch");
+        return false;
+    }
+
+    if (strcmp(state->render_output, "") != 0 && (state->lazy_load || state->follow || state->watch))
+    {
+        log_error("--render-all draws every item, and can not be combined with --lazy-load, --follow or --watch");
+        return false;
+    }
+
+    if (strlen(state->message) == 0 && strcmp(state->progress, "") != 0)
+    {
+        log_error("--progress only applies to --message, items set their own progress");
+        return false;
+    }
+
+    if (strcmp(state->directory, "") != 0 && (strlen(state->message) > 0 || strcmp(state->file, "") != 0 || state->lazy_load || state->progressive_load || state->watch))
+    {
+        log_error("--directory can not be combined with --message, --file, --compile, --lazy-load, --progressive-load or --watch");
+        return false;
+    }
+
+    if (strcmp(state->directory, "") == 0 && (strcmp(state->directory_filter, "") != 0 || state->recursive))
+    {
+        log_error("--directory-filter and --recursive only apply to --directory");
+        return false;
+    }
+
+    if (state->grid_columns > 0 && state->lazy_load)
+    {
+        log_error("--grid shows many items at once and can not be combined with --lazy-load");
+        return false;
+    }
+
+    if (state->grid_columns == 0 && strcmp(state->thumbnail_cache, "") != 0)
+    {
+        log_error("--thumbnail-cache only applies to --grid");
+        return false;
+    }
+
+    if (strlen(state->message) == 0 && strcmp(state->file, "") == 0 && strcmp(state->directory, "") == 0)
+    {
+        log_error("No message, file or directory provided");
+        return false;
+    }
+
+    if (font_path != NULL)
+    {
+        // check if the font path is valid
+        if (access(font_path, F_OK) == -1)
+        {
+            log_error("Invalid font path provided");
+            return false;
+        }
+
+        state->fonts.font_path = strdup(font_path);
+    }
+    else
+    {
+        state->fonts.font_path = strdup(FONT_PATH);
+    }
+
+    // Apply default values for certain buttons and texts
+    if (strcmp(state->action_button, "") == 0)
+    {
+        strncpy(state->action_button, "", sizeof(state->action_button));
+    }
+
+    if (strcmp(state->action_text, "") == 0)
+    {
+        strncpy(state->action_text, "ACTION", sizeof(state->action_text));
+    }
+
+    if (strcmp(state->cancel_button, "") == 0)
+    {
+        strncpy(state->cancel_button, "B", sizeof(state->cancel_button));
+    }
+
+    if (strcmp(state->confirm_text, "") == 0)
+    {
+        strncpy(state->confirm_text, "SELECT", sizeof(state->confirm_text));
+    }
+
+    if (strcmp(state->cancel_text, "") == 0)
+    {
+        strncpy(state->cancel_text, "BACK", sizeof(state->cancel_text));
+    }
+
+    if (strcmp(state->inaction_text, "") == 0)
+    {
+        strncpy(state->inaction_text, "OTHER", sizeof(state->inaction_text));
+    }
+
+    // validate that hardware buttons aren't assigned to more than once
+    bool a_button_assigned = false;
+    bool b_button_assigned = false;
+    bool x_button_assigned = false;
+    bool y_button_assigned = false;
+    bool i_button_assigned = false;
+    if (strcmp(state->action_button, "A") == 0)
+    {
+        a_button_assigned = true;
+    }
+    if (strcmp(state->cancel_button, "A") == 0)
+    {
+        if (a_button_assigned)
+        {
+            log_error("A button cannot be assigned to more than one button");
+            return false;
+        }
+
+        a_button_assigned = true;
+    }
+    if (strcmp(state->confirm_button, "A") == 0)
+    {
+        if (a_button_assigned)
+        {
+            log_error("A button cannot be assigned to more than one button");
+            return false;
+        }
+
+        a_button_assigned = true;
+    }
+    if (strcmp(state->inaction_button, "A") == 0)
+    {
+        if (a_button_assigned)
+        {
+            log_error("A button cannot be assigned to more than one button");
+            return false;
+        }
+
+        a_button_assigned = true;
+    }
+
+    if (strcmp(state->action_button, "B") == 0)
+    {
+        b_button_assigned = true;
+    }
+    if (strcmp(state->cancel_button, "B") == 0)
+    {
+        if (b_button_assigned)
+        {
+            log_error("B button cannot be assigned to more than one button");
+            return false;
+        }
+
+        b_button_assigned = true;
+    }
+    if (strcmp(state->confirm_button, "B") == 0)
+    {
+        if (b_button_assigned)
+        {
+            log_error("B button cannot be assigned to more than one button");
+            return false;
+        }
+
+        b_button_assigned = true;
+    }
+    if (strcmp(state->inaction_button, "B") == 0)
+    {
+        if (b_button_assigned)
+        {
+            log_error("B button cannot be assigned to more than one button");
+            return false;
+        }
+
+        b_button_assigned = true;
+    }
+
+    if (strcmp(state->action_button, "X") == 0)
+    {
+        x_button_assigned = true;
+    }
+    if (strcmp(state->cancel_button, "X") == 0)
+    {
+        if (x_button_assigned)
+        {
+            log_error("X button cannot be assigned to more than one button");
+            return false;
+        }
+
+        x_button_assigned = true;
+    }
+    if (strcmp(state->confirm_button, "X") == 0)
+    {
+        if (x_button_assigned)
+        {
+            log_error("X button cannot be assigned to more than one button");
+            return false;
+        }
+
+        x_button_assigned = true;
+    }
+    if (strcmp(state->inaction_button, "X") == 0)
+    {
+        if (x_button_assigned)
+        {
+            log_error("X button cannot be assigned to more than one button");
+            return false;
+        }
+
+        x_button_assigned = true;
+    }
+
+    if (strcmp(state->action_button, "Y") == 0)
+    {
+        y_button_assigned = true;
+    }
+    if (strcmp(state->cancel_button, "Y") == 0)
+    {
+        if (y_button_assigned)
+        {
+            log_error("Y button cannot be assigned to more than one button");
+            return false;
+        }
+
+        y_button_assigned = true;
+    }
+    if (strcmp(state->confirm_button, "Y") == 0)
+    {
+        if (y_button_assigned)
+        {
+            log_error("Y button cannot be assigned to more than one button");
+            return false;
+        }
+
+        y_button_assigned = true;
+    }
+    if (strcmp(state->inaction_button, "Y") == 0)
+    {
+        if (y_button_assigned)
+        {
+            log_error("Y button cannot be assigned to more than one button");
+            return false;
+        }
+
+        y_button_assigned = true;
+    }
+
+    // validate that the confirm and cancel buttons are valid
+    if (strcmp(state->confirm_button, "A") != 0 && strcmp(state->confirm_button, "B") != 0 && strcmp(state->confirm_button, "X") != 0 && strcmp(state->confirm_button, "Y") != 0 && strcmp(state->confirm_button, "") != 0)
+    {
+        log_error("Invalid confirm button provided");
+        return false;
+    }
+    if (strcmp(state->cancel_button, "A") != 0 && strcmp(state->cancel_button, "B") != 0 && strcmp(state->cancel_button, "X") != 0 && strcmp(state->cancel_button, "Y") != 0 && strcmp(state->cancel_button, "") != 0)
+    {
+        log_error("Invalid cancel button provided");
+        return false;
+    }
+    if (strcmp(state->action_button, "A") != 0 && strcmp(state->action_button, "B") != 0 && strcmp(state->action_button, "X") != 0 && strcmp(state->action_button, "Y") != 0 && strcmp(state->action_button, "") != 0)
+    {
+        log_error("Invalid action button provided");
+        return false;
+    }
+    if (strcmp(state->inaction_button, "A") != 0 && strcmp(state->inaction_button, "B") != 0 && strcmp(state->inaction_button, "X") != 0 && strcmp(state->inaction_button, "Y") != 0 && strcmp(state->inaction_button, "") != 0)
+    {
+        log_error("Invalid inaction button provided");
+        return false;
+    }
+
+    return true;
+}
+
+// load_items creates the items of the message, file or directory given on
+// the command line. it runs on the startup thread, so it only touches the items
+bool load_items(struct AppState *state)
+{
+    if (strlen(state->message) > 0)
+    {
+        state->items_state = ItemsState_NewMessage(state->message, state->background_image, state->background_color, state->show_pill, state->alignment, state->progress);
+        if (state->items_state == NULL)
+        {
+            log_error("Failed to allocate items");
+            return false;
+        }
+    }
+    else if (strlen(state->directory) > 0)
+    {
+        state->items_state = ItemsState_NewDirectory(state->directory, state->directory_filter, state->recursive, state->background_color, state->show_pill, state->alignment);
+        if (state->items_state == NULL)
+        {
+            return false;
+        }
+    }
+    else if (state->progressive_load)
+    {
+        return ItemsProgress_Start(state);
+    }
+    else
+    {
+        state->items_state = ItemsState_New(state->file, state->item_key, state->background_image, state->background_color, state->show_pill, state->alignment, state->lazy_load);
+        if (state->items_state == NULL)
+        {
+            log_error("Failed to hydrate display states");
+            return false;
+        }
+
+        if (state->watch && state->items_state->deck != NULL)
+        {
+            log_error("--watch can not be combined with compiled decks, watch the JSON file instead");
+            return false;
+        }
+    }
+
+
+    return true;
+}
+
+// StartupLoader loads the items and decodes the first background image on a
+// thread while the main thread initializes the screen and opens the fonts,
+// the two only meet at the first frame. the fonts stay on the main thread:
+// they can't open before GFX_init has run TTF_Init, and once it has they
+// open while the image is still decoding
+struct StartupLoader
+{
+    // the loading thread
+    pthread_t thread;
+    // whether the thread was started, the items are loaded in place otherwise
+    bool started;
+    // the state the items are loaded into
+    struct AppState *state;
+    // whether the items loaded
+    bool ok;
+};
+
+// startup_load is the body of the startup thread
+static void *startup_load(void *arg)
+{
+    struct StartupLoader *loader = arg;
+    struct AppState *state = loader->state;
+
+    // signals are handled by the main thread
+    sigset_t signals;
+    sigfillset(&signals);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+    loader->ok = load_items(state);
+    if (!loader->ok)
+    {
+        return NULL;
+    }
+
+    // decoding only creates surfaces of its own, like make_thumbnail it
+    // needs no lock, the decoders were set up before the thread started
+    struct Item *item = ItemsState_Current(state->items_state);
+    if (item->background_image != NULL)
+    {
+        state->preloaded_image = load_background_image(item->background_image, &state->preloaded_prescaled);
+        state->preloaded_path = state->preloaded_image != NULL ? strdup(item->background_image) : NULL;
+        if (state->preloaded_image != NULL && state->preloaded_path == NULL)
+        {
+            SDL_FreeSurface(state->preloaded_image);
+            state->preloaded_image = NULL;
+        }
+    }
+
+    return NULL;
+}
+
+// StartupLoader_Start starts loading the items
+void StartupLoader_Start(struct StartupLoader *loader, struct AppState *state)
+{
+    // SDL_image sets its decoders up on first use, which GFX_init's own
+    // asset loading would otherwise race with the thread
+    IMG_Init(IMG_INIT_JPG | IMG_INIT_PNG);
+
+    loader->state = state;
+    loader->ok = false;
+    loader->started = pthread_create(&loader->thread, NULL, startup_load, loader) == 0;
+    if (!loader->started)
+    {
+        loader->ok = load_items(state);
+    }
+}
+
+// StartupLoader_Finish waits for the items, returning whether they loaded
+bool StartupLoader_Finish(struct StartupLoader *loader)
+{
+    if (loader->started)
+    {
+        pthread_join(loader->thread, NULL);
+        loader->started = false;
+    }
+    return loader->ok;
+}
+
+// set_cloexec sets the CLOEXEC flag on a file descriptor
+static void set_cloexec(int fd)
+{
+    int flags = fcntl(fd, F_GETFD);
+    if (flags == -1)
+    {
+        return;
+    }
+
+    fcntl(fd, F_SETFD, flags | FD_CLOEXEC);
+}
+
+// suppress_output suppresses stdout and stderr
+// returns a single integer containing both file descriptors
+int suppress_output(void)
+{
+    int stdout_fd = dup(STDOUT_FILENO);
+    int stderr_fd = dup(STDERR_FILENO);
+
+    // Prevent child processes started while stdout is suppressed from
+    // inheriting the saved descriptors and keeping command-substitution
+    // pipes open after the main process exits.
+    set_cloexec(stdout_fd);
+    set_cloexec(stderr_fd);
+
+    pthread_mutex_lock(&log_lock);
+    int dev_null_fd = open("/dev/null", O_WRONLY);
+    dup2(dev_null_fd, STDOUT_FILENO);
+    dup2(dev_null_fd, STDERR_FILENO);
+    close(dev_null_fd);
+    suppressed_stderr_fd = stderr_fd;
+    pthread_mutex_unlock(&log_lock);
+
+    return (stdout_fd << 16) | stderr_fd;
+}
+
+// restore_output restores stdout and stderr to the original file descriptors
+void restore_output(int saved_fds)
+{
+    int stdout_fd = (saved_fds >> 16) & 0xFFFF;
+    int stderr_fd = saved_fds & 0xFFFF;
+
+    fflush(stdout);
+    fflush(stderr);
+
+    pthread_mutex_lock(&log_lock);
+    dup2(stdout_fd, STDOUT_FILENO);
+    dup2(stderr_fd, STDERR_FILENO);
+    suppressed_stderr_fd = -1;
+    pthread_mutex_unlock(&log_lock);
+
+    close(stdout_fd);
+    close(stderr_fd);
+}
+
+// swallow_stdout_from_function swallows stdout from a function
+// this is useful for suppressing output from a function
+// that we don't want to see in the log file
+// the InitSettings() function is an example of this (some implementations print to stdout)
+void swallow_stdout_from_function(void (*func)(void))
+{
+    int saved_fds = suppress_output();
+
+    func();
+
+    restore_output(saved_fds);
+}
+
+// init initializes the app state
+// everything is placed here as MinUI sometimes logs to stdout
+// and the logging happens depending on the platform
+void init()
+{
+    // set the cpu speed to the menu speed
+    // this is done here to ensure we downclock
+    // the menu (no need to draw power unnecessarily)
+    PWR_setCPUSpeed(CPU_SPEED_MENU);
+
+    // initialize:
+    // - the screen, allowing us to draw to it
+    // - input from the pad/joystick/buttons/etc.
+    // - power management
+    // - sync hardware settings (brightness, hdmi, speaker, etc.)
+    if (screen == NULL)
+    {
+        screen = GFX_init(MODE_MAIN);
+    }
+    PAD_init();
+    PWR_init();
+    InitSettings();
+}
+
+// destruct cleans up the app state in reverse order
+void destruct()
+{
+    QuitSettings();
+    PWR_quit();
+    PAD_quit();
+    GFX_quit();
+}
+
+// destruct_keeping_screen cleans up like destruct, but leaves the last
+// frame on the screen instead of clearing it (--handoff)
+void destruct_keeping_screen()
+{
+    QuitSettings();
+    PWR_quit();
+    PAD_quit();
+}
+
+// destruct_failed cleans up after a display that failed to start, leaving
+// the frame handed over by the previous display up for the next one
+void destruct_failed(struct AppState *state)
+{
+    if (strcmp(state->handoff, "") != 0)
+    {
+        swallow_stdout_from_function(destruct_keeping_screen);
+    }
+    else
+    {
+        swallow_stdout_from_function(destruct);
+    }
+    release_preloaded_image(state);
+    ItemsProgress_Free(state);
+    ItemsState_Free(state->items_state);
+    state->items_state = NULL;
+    AssetPack_Close(&asset_pack);
+}
+
+// the stack of a render worker, layout_message keeps every word on it
+#define RENDER_STACK_SIZE (4 * 1024 * 1024)
+
+// RenderWorker draws a share of the items for --render-all on its own
+// surface with its own fonts. when its share runs out it steals half of
+// what is left in the share of another worker
+struct RenderWorker
+{
+    // the drawing thread
+    pthread_t thread;
+    // the workers, including this one
+    struct RenderWorker *workers;
+    // number of workers
+    int worker_count;
+    // protects next and end, which other workers steal from
+    pthread_mutex_t lock;
+    // the next item of the share
+    size_t next;
+    // the item past the end of the share
+    size_t end;
+    // a copy of the app state with its own fonts and progress bar
+    struct AppState state;
+    // a copy of the items state with its own selection
+    struct ItemsState items_state;
+    // the surface items are drawn on
+    SDL_Surface *surface;
+    // milliseconds spent drawing and writing every item, shared by the workers
+    double *draw_ms;
+    double *write_ms;
+    // number of items drawn, and of those that failed
+    size_t drawn;
+    size_t failed;
+};
+
+// RenderWorker_Take takes the next item of the share of a worker
+static bool RenderWorker_Take(struct RenderWorker *worker, size_t *index)
+{
+    pthread_mutex_lock(&worker->lock);
+    bool taken = worker->next < worker->end;
+    if (taken)
+    {
+        *index = worker->next++;
+    }
+    pthread_mutex_unlock(&worker->lock);
+    return taken;
+}
+
+// RenderWorker_Steal moves half of the items left to another worker into the
+// share of worker, returning false once no worker has any left
+static bool RenderWorker_Steal(struct RenderWorker *worker)
+{
+    int self = worker - worker->workers;
+    for (int i = 1; i < worker->worker_count; i++)
+    {
+        struct RenderWorker *victim = &worker->workers[(self + i) % worker->worker_count];
+        pthread_mutex_lock(&victim->lock);
+        size_t left = victim->end - victim->next;
+        size_t end = victim->end;
+        size_t start = end - (left + 1) / 2;
+        if (left > 0)
+        {
+            victim->end = start;
+        }
+        pthread_mutex_unlock(&victim->lock);
+
+        if (left > 0)
+        {
+            pthread_mutex_lock(&worker->lock);
+            worker->next = start;
+            worker->end = end;
+            pthread_mutex_unlock(&worker->lock);
+            return true;
+        }
+    }
+    return false;
+}
+
+// write_raw_frame writes a surface in the frame format of --handoff
+static bool write_raw_frame(const char *path, SDL_Surface *surface)
+{
+    struct HandoffHeader header = {
+        .magic = HANDOFF_MAGIC,
+        .version = HANDOFF_VERSION,
+        .width = surface->w,
+        .height = surface->h,
+        .pitch = surface->pitch,
+        .bits_per_pixel = surface->format->BitsPerPixel,
+    };
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    size_t size = (size_t)surface->pitch * surface->h;
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 && fwrite(surface->pixels, 1, size, file) == size;
+    return fclose(file) == 0 && ok;
+}
+
+// RenderWorker_Draw draws a single item and writes its image
+static bool RenderWorker_Draw(struct RenderWorker *worker, size_t index)
+{
+    struct AppState *state = &worker->state;
+    state->items_state->selected = index;
+    if (!ItemsState_Hydrate(state->items_state))
+    {
+        return false;
+    }
+    ProgressBar_Update(&state->progress_bar, ItemsState_Current(state->items_state)->progress);
+
+    struct timespec start, drawn, written;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    draw_screen(worker->surface, state);
+    clock_gettime(CLOCK_MONOTONIC, &drawn);
+
+    char path[2048];
+    bool ok;
+    if (state->render_format == RenderFormatRaw)
+    {
+        snprintf(path, sizeof(path), "%s/item-%06zu.raw", state->render_output, index);
+        ok = write_raw_frame(path, worker->surface);
+    }
+    else
+    {
+        snprintf(path, sizeof(path), "%s/item-%06zu.png", state->render_output, index);
+#ifdef USE_SDL2
+        ok = IMG_SavePNG(worker->surface, path) == 0;
+#else
+        ok = false;
+#endif
+    }
+    clock_gettime(CLOCK_MONOTONIC, &written);
+
+    worker->draw_ms[index] = (drawn.tv_sec - start.tv_sec) * 1000.0 + (drawn.tv_nsec - start.tv_nsec) / 1000000.0;
+    worker->write_ms[index] = (written.tv_sec - drawn.tv_sec) * 1000.0 + (written.tv_nsec - drawn.tv_nsec) / 1000000.0;
+    if (!ok)
+    {
+        char buff[1024];
+        snprintf(buff, sizeof(buff), "Failed to write %s", path);
+        log_error(buff);
+    }
+    return ok;
+}
+
+// render_worker is the body of a render worker
+static void *render_worker(void *arg)
+{
+    struct RenderWorker *worker = arg;
+    size_t index;
+    for (;;)
+    {
+        if (!RenderWorker_Take(worker, &index) && !(RenderWorker_Steal(worker) && RenderWorker_Take(worker, &index)))
+        {
+            break;
+        }
+
+        if (!RenderWorker_Draw(worker, index))
+        {
+            worker->failed++;
+        }
+        worker->drawn++;
+    }
+    return NULL;
+}
+
+// RenderWorker_Init gives a worker its copy of the state, fonts and surface
+static bool RenderWorker_Init(struct RenderWorker *worker, struct AppState *state)
+{
+    pthread_mutex_init(&worker->lock, NULL);
+    worker->state = *state;
+    worker->state.progress_bar = (struct ProgressBar){0};
+    worker->state.preloaded_image = NULL;
+    worker->state.preloaded_path = NULL;
+    worker->state.fonts.large = NULL;
+    worker->state.fonts.small = NULL;
+
+    // items are shared, except the single item compiled decks are read into
+    worker->items_state = *state->items_state;
+    worker->state.items_state = &worker->items_state;
+    if (state->items_state->deck != NULL)
+    {
+        worker->items_state.items = malloc(sizeof(struct Item));
+        worker->items_state.window_count = 0;
+        if (worker->items_state.items == NULL)
+        {
+            return false;
+        }
+    }
+
+    SDL_PixelFormat *format = screen->format;
+    worker->surface = SDL_CreateRGBSurface(0, screen->w, screen->h, format->BitsPerPixel, format->Rmask, format->Gmask, format->Bmask, format->Amask);
+    if (worker->surface == NULL)
+    {
+        return false;
+    }
+
+    pthread_mutex_lock(&gfx_lock);
+    bool fonts = open_fonts(&worker->state);
+    pthread_mutex_unlock(&gfx_lock);
+    return fonts;
+}
+
+// RenderWorker_Free releases what RenderWorker_Init set up
+static void RenderWorker_Free(struct RenderWorker *worker, struct AppState *state)
+{
+    pthread_mutex_lock(&gfx_lock);
+    if (worker->state.fonts.large != NULL)
+    {
+        TTF_CloseFont(worker->state.fonts.large);
+    }
+    if (worker->state.fonts.small != NULL)
+    {
+        TTF_CloseFont(worker->state.fonts.small);
+    }
+    pthread_mutex_unlock(&gfx_lock);
+
+    if (worker->surface != NULL)
+    {
+        SDL_FreeSurface(worker->surface);
+    }
+    if (state->items_state->deck != NULL)
+    {
+        free(worker->items_state.items);
+    }
+    ProgressBar_Close(&worker->state.progress_bar);
+    pthread_mutex_destroy(&worker->lock);
+}
+
+// render_all draws every item offscreen with the display pipeline and writes
+// an image of each into render_output, spread over a worker per core.
+// the time spent drawing and writing every item is printed as CSV
+int render_all(struct AppState *state)
+{
+#ifndef USE_SDL2
+    if (state->render_format == RenderFormatPNG)
+    {
+        log_error("PNG images can only be written with SDL2, use --render-format raw");
+        return ExitCodeError;
+    }
+#endif
+
+    if (!load_items(state))
+    {
+        return ExitCodeError;
+    }
+
+    if (mkdir(state->render_output, 0755) != 0 && errno != EEXIST)
+    {
+        log_error("Failed to create output directory");
+        ItemsState_Free(state->items_state);
+        return ExitCodeSerializeError;
+    }
+
+    // nothing is displayed, so no display is needed unless the caller picked one
+    setenv("SDL_VIDEODRIVER", "dummy", 0);
+    setenv("SDL_AUDIODRIVER", "dummy", 0);
+    swallow_stdout_from_function(init);
+
+    size_t item_count = state->items_state->item_count;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int worker_count = state->render_workers > 0 ? state->render_workers : cores < 1 ? 1 : cores;
+    if ((size_t)worker_count > item_count)
+    {
+        worker_count = item_count;
+    }
+
+    struct RenderWorker *workers = calloc(worker_count, sizeof(struct RenderWorker));
+    double *draw_ms = calloc(item_count, sizeof(double));
+    double *write_ms = calloc(item_count, sizeof(double));
+    bool ok = workers != NULL && draw_ms != NULL && write_ms != NULL;
+    if (!ok)
+    {
+        log_error("Failed to allocate render workers");
+    }
+
+    // every worker starts with an equal share of the items
+    int initialized = 0;
+    for (int i = 0; ok && i < worker_count; i++)
+    {
+        struct RenderWorker *worker = &workers[i];
+        worker->workers = workers;
+        worker->worker_count = worker_count;
+        worker->next = item_count * i / worker_count;
+        worker->end = item_count * (i + 1) / worker_count;
+        worker->draw_ms = draw_ms;
+        worker->write_ms = write_ms;
+        initialized++;
+        ok = RenderWorker_Init(worker, state);
+        if (!ok)
+        {
+            log_error("Failed to set up render worker");
+        }
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // signals are left to the main thread
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstacksize(&attributes, RENDER_STACK_SIZE);
+    int started = 0;
+    for (int i = 0; ok && i < worker_count; i++)
+    {
+        if (pthread_create(&workers[i].thread, &attributes, render_worker, &workers[i]) != 0)
+        {
+            break;
+        }
+        started++;
+    }
+    pthread_attr_destroy(&attributes);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+    // the items of workers that didn't start are stolen by the others,
+    // or drawn here when none started
+    if (ok && started == 0)
+    {
+        render_worker(&workers[0]);
+    }
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(workers[i].thread, NULL);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    size_t drawn = 0;
+    size_t failed = 0;
+    for (int i = 0; i < initialized; i++)
+    {
+        drawn += workers[i].drawn;
+        failed += workers[i].failed;
+        RenderWorker_Free(&workers[i], state);
+    }
+
+    if (ok)
+    {
+        double total_draw_ms = 0;
+        double total_write_ms = 0;
+        printf("item,draw_ms,write_ms\n");
+        for (size_t i = 0; i < item_count; i++)
+        {
+            printf("%zu,%.3f,%.3f\n", i, draw_ms[i], write_ms[i]);
+            total_draw_ms += draw_ms[i];
+            total_write_ms += write_ms[i];
+        }
+        fflush(stdout);
+
+        double elapsed_ms = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_nsec - start.tv_nsec) / 1000000.0;
+        char buff[1024];
+        snprintf(buff, sizeof(buff), "Rendered %zu items with %d workers in %.1f ms (%.1f items/s, %.3f ms drawing and %.3f ms writing per item)",
+                 drawn, started > 0 ? started : 1, elapsed_ms, elapsed_ms > 0 ? drawn * 1000.0 / elapsed_ms : 0, drawn > 0 ? total_draw_ms / drawn : 0, drawn > 0 ? total_write_ms / drawn : 0);
+        log_error(buff);
+    }
+
+    free(workers);
+    free(draw_ms);
+    free(write_ms);
+    swallow_stdout_from_function(destruct);
+    ItemsState_Free(state->items_state);
+
+    if (!ok)
+    {
+        return ExitCodeError;
+    }
+    return failed > 0 || drawn < item_count ? ExitCodeSerializeError : ExitCodeSuccess;
+}
+
+// Item_FreeCopy releases an item made by Item_Copy, leaving it empty
+static void Item_FreeCopy(struct Item *item)
+{
+    free(item->text);
+    free(item->background_color);
+    free(item->background_image);
+    free(item->progress);
+    *item = (struct Item){0};
+}
+
+// Item_Copy copies an item along with its strings, so it can be drawn on
+// another thread while the items change
+static bool Item_Copy(struct Item *copy, const struct Item *item)
+{
+    *copy = *item;
+    copy->id = NULL;
+
+    bool ok = true;
+    char **strings[4] = {&copy->text, &copy->background_color, &copy->background_image, &copy->progress};
+    for (int i = 0; i < 4; i++)
+    {
+        if (*strings[i] != NULL)
+        {
+            *strings[i] = ok ? strdup(*strings[i]) : NULL;
+            ok = ok && *strings[i] != NULL;
+        }
+    }
+
+    if (!ok)
+    {
+        Item_FreeCopy(copy);
+    }
+    return ok;
+}
+
+// RenderThread draws the frames of a display on a thread of its own, so a
+// slow image or text never holds up reading input (--render-thread). frames
+// go through three buffers, the one being drawn, the newest one finished and
+// the one on screen, so the newest frame is always the one shown and neither
+// thread waits for the other to be done with a buffer
+struct RenderThread
+{
+    // the drawing thread
+    pthread_t thread;
+    // the display drawn, only its options are read by the thread
+    struct AppState *app;
+    // protects everything up to stopping
+    pthread_mutex_t lock;
+    // signaled when there is something to draw, a frame finished or the thread should stop
+    pthread_cond_t changed;
+    // a copy of the item to draw next
+    struct Item item;
+    // index of the item to draw next, -1 when there is none
+    long pending;
+    // copies of the items worth drawing ahead of time, emptied once taken
+    struct Item ahead[RENDER_AHEAD_MAX_FRAMES];
+    // indexes of the items worth drawing ahead of time
+    long wanted[RENDER_AHEAD_MAX_FRAMES];
+    // number of items worth drawing ahead of time
+    int wanted_count;
+    // the generation of the frame cache of the display as of the last request
+    unsigned long generation;
+    // the newest finished frame
+    struct CachedFrame *ready;
+    // whether ready holds a frame that wasn't shown yet
+    bool fresh;
+    // whether a frame is being drawn
+    bool drawing;
+    // whether the thread should stop
+    bool stopping;
+    // the frame being drawn, only used by the thread
+    struct CachedFrame *back;
+    // the items drawn ahead of time, only used by the thread
+    struct FrameCache cache;
+    // the frame on screen, only used by the display
+    struct CachedFrame *front;
+    // whether the frame on screen is to be shown again, only used by the display
+    bool again;
+    // whether a frame was shown yet, only used by the display
+    bool shown;
+    // the three frames
+    struct CachedFrame buffers[3];
+};
+
+// RenderThread_Main draws the frames asked for, and the items worth drawing
+// ahead of time while no frame is
+static void *RenderThread_Main(void *arg)
+{
+    struct RenderThread *render = arg;
+    struct AppState *state = render->app;
+    unsigned long generation = render->generation;
+
+    pthread_mutex_lock(&render->lock);
+    while (!render->stopping)
+    {
+        // drawings made before the items changed are dropped
+        if (render->generation != generation)
+        {
+            generation = render->generation;
+            FrameCache_Clear(&render->cache);
+        }
+
+        long wanted[RENDER_AHEAD_MAX_FRAMES];
+        int wanted_count = render->wanted_count;
+        memcpy(wanted, render->wanted, sizeof(wanted));
+
+        struct Item item = {0};
+        long index = render->pending;
+        bool frame = index != -1;
+        if (frame)
+        {
+            item = render->item;
+            render->item = (struct Item){0};
+            render->pending = -1;
+            render->drawing = true;
+        }
+        for (int i = 0; i < wanted_count && index == -1; i++)
+        {
+            if (render->ahead[i].text != NULL && FrameCache_Find(&render->cache, wanted[i]) == NULL)
+            {
+                index = wanted[i];
+                item = render->ahead[i];
+                render->ahead[i] = (struct Item){0};
+            }
+        }
+
+        if (index == -1)
+        {
+            pthread_cond_wait(&render->changed, &render->lock);
+            continue;
+        }
+        pthread_mutex_unlock(&render->lock);
+
+        struct CachedFrame *back = render->back;
+        struct CachedFrame *cached = frame ? FrameCache_Find(&render->cache, index) : NULL;
+        if (!frame)
+        {
+            FrameCache_Fill(&render->cache, screen, state, index, &item, wanted, wanted_count);
+        }
+        else if (cached != NULL && FrameCache_Usable(cached, &item))
+        {
+            SDL_BlitSurface(cached->surface, NULL, back->surface, NULL);
+            back->bar_rect = cached->bar_rect;
+            back->image_drawn = cached->image_drawn;
+            back->item = index;
+        }
+        else
+        {
+            back->bar_rect = draw_item(back->surface, state, &item);
+            back->image_drawn = item.background_image != NULL && item.image_exists;
+            back->item = index;
+        }
+        Item_FreeCopy(&item);
+
+        pthread_mutex_lock(&render->lock);
+        if (frame)
+        {
+            // a finished frame that wasn't shown yet is replaced by the newer one
+            render->back = render->ready;
+            render->ready = back;
+            render->fresh = true;
+            render->drawing = false;
+            pthread_cond_broadcast(&render->changed);
+        }
+    }
+    pthread_mutex_unlock(&render->lock);
+    return NULL;
+}
+
+// RenderThread_Stop stops the render thread, waiting for the frame it is drawing
+void RenderThread_Stop(struct RenderThread *render)
+{
+    if (render == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&render->lock);
+    render->stopping = true;
+    pthread_cond_broadcast(&render->changed);
+    pthread_mutex_unlock(&render->lock);
+    pthread_join(render->thread, NULL);
+
+    Item_FreeCopy(&render->item);
+    for (int i = 0; i < RENDER_AHEAD_MAX_FRAMES; i++)
+    {
+        Item_FreeCopy(&render->ahead[i]);
+    }
+    for (int i = 0; i < 3; i++)
+    {
+        SDL_FreeSurface(render->buffers[i].surface);
+    }
+    FrameCache_Free(&render->cache);
+    pthread_mutex_destroy(&render->lock);
+    pthread_cond_destroy(&render->changed);
+    free(render);
+}
+
+// RenderThread_Start starts drawing the frames of a display on a thread of
+// its own, returning NULL when it can't
+struct RenderThread *RenderThread_Start(struct AppState *state)
+{
+    struct RenderThread *render = calloc(1, sizeof(struct RenderThread));
+    if (render == NULL)
+    {
+        return NULL;
+    }
+
+    SDL_PixelFormat *format = screen->format;
+    for (int i = 0; i < 3; i++)
+    {
+        render->buffers[i].item = -1;
+        render->buffers[i].surface = SDL_CreateRGBSurface(0, screen->w, screen->h, format->BitsPerPixel, format->Rmask, format->Gmask, format->Bmask, format->Amask);
+        if (render->buffers[i].surface == NULL)
+        {
+            for (int j = 0; j < i; j++)
+            {
+                SDL_FreeSurface(render->buffers[j].surface);
+            }
+            free(render);
+            return NULL;
+        }
+#ifdef USE_SDL2
+        SDL_SetSurfaceBlendMode(render->buffers[i].surface, SDL_BLENDMODE_NONE);
+#else
+        SDL_SetAlpha(render->buffers[i].surface, 0, SDL_ALPHA_OPAQUE);
+#endif
+    }
+    render->back = &render->buffers[0];
+    render->ready = &render->buffers[1];
+    render->front = &render->buffers[2];
+
+    // the display plans what to draw ahead of time, the thread keeps the drawings
+    FrameCache_Init(&render->cache, 0, screen);
+    render->cache.capacity = state->frame_cache.capacity;
+    render->app = state;
+    render->pending = -1;
+    render->generation = state->frame_cache.generation;
+    pthread_mutex_init(&render->lock, NULL);
+    pthread_cond_init(&render->changed, NULL);
+
+    // signals are left to the main thread
+    sigset_t all, previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setstacksize(&attributes, RENDER_STACK_SIZE);
+    int result = pthread_create(&render->thread, &attributes, RenderThread_Main, render);
+    pthread_attr_destroy(&attributes);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+
+    if (result != 0)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            SDL_FreeSurface(render->buffers[i].surface);
+        }
+        pthread_mutex_destroy(&render->lock);
+        pthread_cond_destroy(&render->changed);
+        free(render);
+        return NULL;
+    }
+
+    return render;
+}
+
+// RenderThread_Request asks for the selected item to be drawn, replacing a
+// request the thread didn't get to yet, along with the items worth drawing
+// ahead of time. the items are copied, they may change before they are drawn
+void RenderThread_Request(struct RenderThread *render, struct AppState *state)
+{
+    struct ItemsState *items_state = state->items_state;
+    struct Item item;
+    if (!Item_Copy(&item, ItemsState_Current(items_state)))
+    {
+        log_error("Failed to allocate frame");
+        return;
+    }
+
+    long wanted[RENDER_AHEAD_MAX_FRAMES] = {0};
+    struct Item ahead[RENDER_AHEAD_MAX_FRAMES] = {0};
+    int wanted_count = FrameCache_Plan(&state->frame_cache, state, wanted);
+    for (int i = 0; i < wanted_count; i++)
+    {
+        // items that can't be copied are not drawn ahead of time
+        struct Item peeked;
+        if (ItemsState_Peek(items_state, wanted[i], &peeked))
+        {
+            Item_Copy(&ahead[i], &peeked);
+        }
+    }
+
+    pthread_mutex_lock(&render->lock);
+    Item_FreeCopy(&render->item);
+    render->item = item;
+    render->pending = items_state->selected;
+    for (int i = 0; i < RENDER_AHEAD_MAX_FRAMES; i++)
+    {
+        Item_FreeCopy(&render->ahead[i]);
+        render->ahead[i] = ahead[i];
+        render->wanted[i] = wanted[i];
+    }
+    render->wanted_count = wanted_count;
+    render->generation = state->frame_cache.generation;
+    pthread_cond_broadcast(&render->changed);
+    pthread_mutex_unlock(&render->lock);
+}
+
+// RenderThread_Take takes the newest finished frame to be shown, returning
+// false when there is none. until the first frame was shown it waits for it,
+// so the display doesn't start a frame later than when drawn inline
+bool RenderThread_Take(struct RenderThread *render)
+{
+    if (render->again)
+    {
+        render->again = false;
+        return true;
+    }
+
+    pthread_mutex_lock(&render->lock);
+    while (!render->shown && !render->fresh && (render->pending != -1 || render->drawing))
+    {
+        pthread_cond_wait(&render->changed, &render->lock);
+    }
+    bool fresh = render->fresh;
+    if (fresh)
+    {
+        struct CachedFrame *front = render->front;
+        render->front = render->ready;
+        render->ready = front;
+        render->fresh = false;
+    }
+    pthread_mutex_unlock(&render->lock);
+
+    render->shown = render->shown || fresh;
+    return fresh;
+}
+
+// RenderThread_Wait waits for the frame asked for last to be finished, so
+// the display can draw on its own without sharing the fonts with the thread
+void RenderThread_Wait(struct RenderThread *render)
+{
+    pthread_mutex_lock(&render->lock);
+    while (render->pending != -1 || render->drawing)
+    {
+        pthread_cond_wait(&render->changed, &render->lock);
+    }
+    pthread_mutex_unlock(&render->lock);
+}
+
+// RenderThread_Show copies the frame taken last onto the screen and draws
+// the progress bar over it. a frame of an item the selection already moved
+// away from is shown without one until the newer frame is finished
+void RenderThread_Show(struct RenderThread *render, SDL_Surface *screen, struct AppState *state)
+{
+    struct CachedFrame *frame = render->front;
+    SDL_BlitSurface(frame->surface, NULL, screen, NULL);
+
+    struct ItemsState *items_state = state->items_state;
+    if (frame->item != items_state->selected)
+    {
+        return;
+    }
+
+    struct Item *item = ItemsState_Current(items_state);
+    if (frame->image_drawn)
+    {
+        item->image_exists = true;
+    }
+
+    state->progress_bar.rect = frame->bar_rect;
+    if (item->progress != NULL)
+    {
+        ProgressBar_Draw(&state->progress_bar, screen, true);
+    }
+}
+
+// init_state resets the app state to the defaults of every option
+void init_state(struct AppState *state)
+{
+    char default_action_button[1024] = "";
+    char default_action_text[1024] = "ACTION";
+    char default_background_image[1024] = "";
+    char default_background_color[1024] = "#000000";
+    char default_cancel_button[1024] = "B";
+    char default_cancel_text[1024] = "BACK";
+    char default_confirm_button[1024] = "A";
+    char default_confirm_text[1024] = "SELECT";
+    char default_inaction_button[1024] = "";
+    char default_inaction_text[1024] = "OTHER";
+    char default_file[1024] = "";
+    char default_item_key[1024] = "items";
+    char default_message[1024] = "";
+    *state = (struct AppState){
+        .redraw = 1,
+        .quitting = 0,
+        .exit_code = ExitCodeSuccess,
+        .show_hardware_group = false,
+        .timeout_seconds = 0,
+        .fonts = {
+            .size = FONT_LARGE,
+            .large = NULL,
+            .medium = NULL,
+            .font_path = NULL,
+        },
+        .action_show = false,
+        .confirm_show = false,
+        .cancel_show = false,
+        .disable_auto_sleep = false,
+        .inaction_show = false,
+        .lazy_load = false,
+        .progressive_load = false,
+        .render_format = RenderFormatPNG,
+        .items_progress = NULL,
+        .quit_after_last_item = false,
+        .show_time_left = false,
+        .items_state = NULL,
+        .start_time = 0,
+        .show_pill = false,
+        .probe_item = -1,
+        .readahead_item = -1,
+        .alignment = MessageAlignmentMiddle,
+        .render_ahead = 0,
+        .render_thread = false,
+        .transition = TransitionKindNone,
+        .transition_ms = TRANSITION_DEFAULT_MS,
+        .slide_duration_ms = 0,
+        .grid_columns = 0,
+        .grid_rows = 0,
+        .grid_shown = false,
+        .thumbnails = NULL,
+    };
+
+    // assign the default values to the app state
+    strncpy(state->action_button, default_action_button, sizeof(state->action_button));
+    strncpy(state->action_text, default_action_text, sizeof(state->action_text));
+    strncpy(state->background_image, default_background_image, sizeof(state->background_image));
+    strncpy(state->background_color, default_background_color, sizeof(state->background_color));
+    strncpy(state->cancel_button, default_cancel_button, sizeof(state->cancel_button));
+    strncpy(state->cancel_text, default_cancel_text, sizeof(state->cancel_text));
+    strncpy(state->confirm_button, default_confirm_button, sizeof(state->confirm_button));
+    strncpy(state->confirm_text, default_confirm_text, sizeof(state->confirm_text));
+    strncpy(state->inaction_button, default_inaction_button, sizeof(state->inaction_button));
+    strncpy(state->inaction_text, default_inaction_text, sizeof(state->inaction_text));
+    strncpy(state->file, default_file, sizeof(state->file));
+    strncpy(state->item_key, default_item_key, sizeof(state->item_key));
+    strncpy(state->message, default_message, sizeof(state->message));
+}
+
+// install_signal_handlers routes the signals the app responds to to signal_handler
+void install_signal_handlers(void)
+{
+    CommandQueue_Init(&command_queue);
+
+    struct sigaction sa = {
+        .sa_sigaction = signal_handler,
+        .sa_flags = SA_RESTART | SA_SIGINFO};
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sigaction(SIGUSR1, &sa, NULL);
+    sigaction(SIGUSR2, &sa, NULL);
+#ifdef SIGRTMIN
+    sigaction(SIGRTMIN, &sa, NULL);
+    sigaction(SIGRTMIN + 1, &sa, NULL);
+#endif
+}
+
+#define SERVER_MAX_CONNECTIONS 8
+// the largest command accepted from a client
+#define SERVER_MAX_FRAME (1024 * 1024)
+
+// ServerConnection is a client connected to --serve
+struct ServerConnection
+{
+    // the socket, -1 for free slots
+    int fd;
+    // the big endian length prefix of the frame being read
+    unsigned char header[4];
+    // number of bytes of the length prefix read so far
+    size_t header_length;
+    // the body of the frame being read, NULL until its length is known
+    char *frame;
+    // the size of the body
+    size_t frame_size;
+    // number of bytes of the body read so far
+    size_t frame_length;
+    // whether the client waits for the current display to end
+    bool waiting;
+    // whether the client waits for the current display to be drawn
+    bool waiting_for_display;
+};
+
+// PresenterServer keeps a single process displaying items for many clients
+// commands are frames holding a JSON object, prefixed with their length as
+// a 4 byte big endian integer, and every command is answered with a frame
+// holding {"exit_code": <code>}
+struct PresenterServer
+{
+    // the listening socket
+    int listen_fd;
+    // the path the socket is bound to
+    const char *socket_path;
+    // connected clients
+    struct ServerConnection connections[SERVER_MAX_CONNECTIONS];
+    // a show or quit command that ended the current display, run next
+    JSON_Value *pending;
+    // the connection the pending command came from
+    int pending_connection;
+    // the connection whose show command is being displayed, -1 if it didn't wait
+    int owner;
+    // the exit code of the last display
+    int last_exit_code;
+    // fonts kept open between displays
+    struct Fonts fonts;
+    // whether every display runs in a forked child (--zygote)
+    bool zygote;
+    // the child running the current display, -1 for none
+    pid_t child;
+};
+
+// write_frame writes a JSON value as a length prefixed frame
+bool write_frame(int fd, JSON_Value *value)
+{
+    char *body = json_serialize_to_string(value);
+    if (body == NULL)
+    {
+        return false;
+    }
+
+    size_t size = strlen(body);
+    unsigned char header[4] = {(size >> 24) & 0xFF, (size >> 16) & 0xFF, (size >> 8) & 0xFF, size & 0xFF};
+    bool ok = true;
+    const char *parts[2] = {(const char *)header, body};
+    size_t lengths[2] = {sizeof(header), size};
+    for (int i = 0; i < 2 && ok; i++)
+    {
+        size_t written = 0;
+        while (written < lengths[i])
+        {
+            ssize_t n = write(fd, parts[i] + written, lengths[i] - written);
+            if (n < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (n <= 0)
+            {
+                ok = false;
+                break;
+            }
+            written += n;
+        }
+    }
+
+    json_free_serialized_string(body);
+    return ok;
+}
+
+// read_frame reads a length prefixed frame and parses it, blocking until it arrives
+JSON_Value *read_frame(int fd)
+{
+    unsigned char header[4];
+    size_t length = 0;
+    while (length < sizeof(header))
+    {
+        ssize_t n = read(fd, header + length, sizeof(header) - length);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return NULL;
+        }
+        length += n;
+    }
+
+    size_t size = ((size_t)header[0] << 24) | (header[1] << 16) | (header[2] << 8) | header[3];
+    if (size > SERVER_MAX_FRAME)
+    {
+        return NULL;
+    }
+
+    char *body = malloc(size + 1);
+    if (body == NULL)
+    {
+        return NULL;
+    }
+
+    length = 0;
+    while (length < size)
+    {
+        ssize_t n = read(fd, body + length, size - length);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            free(body);
+            return NULL;
+        }
+        length += n;
+    }
+    body[size] = '\0';
+
+    JSON_Value *value = json_parse_string(body);
+    free(body);
+    return value;
+}
+
+// PresenterServer_Close disconnects a client
+static void PresenterServer_Close(struct PresenterServer *server, int index)
+{
+    struct ServerConnection *connection = &server->connections[index];
+    close(connection->fd);
+    free(connection->frame);
+    memset(connection, 0, sizeof(*connection));
+    connection->fd = -1;
+
+    if (server->owner == index)
+    {
+        server->owner = -1;
+    }
+}
+
+// PresenterServer_Reply answers a command with an exit code
+static void PresenterServer_Reply(struct PresenterServer *server, int index, int exit_code)
+{
+    JSON_Value *reply = json_value_init_object();
+    json_object_set_number(json_value_get_object(reply), "exit_code", exit_code);
+    if (!write_frame(server->connections[index].fd, reply))
+    {
+        PresenterServer_Close(server, index);
+    }
+    json_value_free(reply);
+}
+
+// PresenterServer_Accept takes a new client, turning it away when all slots are used
+static void PresenterServer_Accept(struct PresenterServer *server)
+{
+    int fd = accept(server->listen_fd, NULL, NULL);
+    if (fd == -1)
+    {
+        return;
+    }
+    set_cloexec(fd);
+
+    for (int i = 0; i < SERVER_MAX_CONNECTIONS; i++)
+    {
+        if (server->connections[i].fd == -1)
+        {
+            server->connections[i].fd = fd;
+            return;
+        }
+    }
+
+    log_error("Too many clients connected, closing new connection");
+    close(fd);
+}
+
+// PresenterServer_Read reads what a client sent so far, returning the
+// command once a whole frame arrived. closed is set when the client is gone
+static JSON_Value *PresenterServer_Read(struct PresenterServer *server, int index, bool *closed)
+{
+    struct ServerConnection *connection = &server->connections[index];
+    *closed = false;
+
+    ssize_t n;
+    if (connection->header_length < sizeof(connection->header))
+    {
+        n = read(connection->fd, connection->header + connection->header_length, sizeof(connection->header) - connection->header_length);
+    }
+    else
+    {
+        n = read(connection->fd, connection->frame + connection->frame_length, connection->frame_size - connection->frame_length);
+    }
+
+    if (n < 0 && errno == EINTR)
+    {
+        return NULL;
+    }
+    if (n <= 0)
+    {
+        *closed = true;
+        return NULL;
+    }
+
+    if (connection->header_length < sizeof(connection->header))
+    {
+        connection->header_length += n;
+        if (connection->header_length < sizeof(connection->header))
+        {
+            return NULL;
+        }
+
+        unsigned char *header = connection->header;
+        connection->frame_size = ((size_t)header[0] << 24) | (header[1] << 16) | (header[2] << 8) | header[3];
+        connection->frame = connection->frame_size <= SERVER_MAX_FRAME ? malloc(connection->frame_size + 1) : NULL;
+        if (connection->frame == NULL)
+        {
+            log_error("Invalid command frame received");
+            *closed = true;
+            return NULL;
+        }
+    }
+    else
+    {
+        connection->frame_length += n;
+    }
+
+    if (connection->frame_length < connection->frame_size)
+    {
+        return NULL;
+    }
+
+    connection->frame[connection->frame_size] = '\0';
+    JSON_Value *value = json_parse_string(connection->frame);
+    free(connection->frame);
+    connection->frame = NULL;
+    connection->frame_size = 0;
+    connection->frame_length = 0;
+    connection->header_length = 0;
+
+    if (value == NULL || json_value_get_object(value) == NULL)
+    {
+        log_error("Invalid command received");
+        if (value != NULL)
+        {
+            json_value_free(value);
+        }
+        PresenterServer_Reply(server, index, ExitCodeParseError);
+        return NULL;
+    }
+
+    return value;
+}
+
+// PresenterServer_Handle runs a command. select and wait act on the current
+// display, show and quit end it and are kept as the pending command
+static void PresenterServer_Handle(struct PresenterServer *server, int index, JSON_Value *value, struct AppState *state)
+{
+    JSON_Object *command = json_value_get_object(value);
+    const char *name = json_object_get_string(command, "command");
+    if (name == NULL)
+    {
+        name = "show";
+    }
+
+    if (strcmp(name, "show") == 0 || strcmp(name, "quit") == 0)
+    {
+        server->pending = value;
+        server->pending_connection = index;
+        if (state != NULL)
+        {
+            state->quitting = 1;
+            state->redraw = 0;
+            state->exit_code = ExitCodeSigterm;
+        }
+        return;
+    }
+
+    if (strcmp(name, "select") == 0)
+    {
+        double selected = json_object_get_number(command, "selected");
+        if (state != NULL && selected >= 0 && selected <= INT_MAX)
+        {
+            ItemsProgress_Wait(state, (size_t)selected);
+        }
+        if (state == NULL || !json_object_has_value_of_type(command, "selected", JSONNumber) || selected < 0 || selected >= state->items_state->item_count)
+        {
+            PresenterServer_Reply(server, index, ExitCodeError);
+        }
+        else
+        {
+            CommandQueue_Push(&command_queue, CommandSelect, (int)selected);
+            PresenterServer_Reply(server, index, ExitCodeSuccess);
+        }
+    }
+    else if (strcmp(name, "wait") == 0)
+    {
+        if (state != NULL || server->child != -1)
+        {
+            server->connections[index].waiting = true;
+        }
+        else
+        {
+            PresenterServer_Reply(server, index, server->last_exit_code);
+        }
+    }
+    else
+    {
+        char buff[1024];
+        snprintf(buff, sizeof(buff), "Unknown command: %s", name);
+        log_error(buff);
+        PresenterServer_Reply(server, index, ExitCodeError);
+    }
+
+    json_value_free(value);
+}
+
+// PresenterServer_Poll accepts clients and runs the commands they sent,
+// waiting up to timeout milliseconds (-1 to wait for a command to arrive)
+// state is the current display, or NULL between displays
+void PresenterServer_Poll(struct PresenterServer *server, struct AppState *state, int timeout)
+{
+    struct pollfd fds[SERVER_MAX_CONNECTIONS + 1];
+    int indexes[SERVER_MAX_CONNECTIONS + 1];
+    nfds_t count = 0;
+
+    fds[count] = (struct pollfd){.fd = server->listen_fd, .events = POLLIN};
+    indexes[count++] = -1;
+    for (int i = 0; i < SERVER_MAX_CONNECTIONS; i++)
+    {
+        if (server->connections[i].fd != -1)
+        {
+            fds[count] = (struct pollfd){.fd = server->connections[i].fd, .events = POLLIN};
+            indexes[count++] = i;
+        }
+    }
+
+    if (poll(fds, count, timeout) <= 0)
+    {
+        return;
+    }
+
+    // a pending show or quit stops reading, the rest is handled once it ran
+    for (nfds_t i = 1; i < count && server->pending == NULL; i++)
+    {
+        if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) == 0)
+        {
+            continue;
+        }
+
+        int index = indexes[i];
+        bool closed;
+        JSON_Value *value = PresenterServer_Read(server, index, &closed);
+        if (closed)
+        {
+            // a client going away ends its display, like killing the process would
+            if (state != NULL && server->owner == index)
+            {
+                state->quitting = 1;
+                state->exit_code = ExitCodeSigterm;
+            }
+            else if (server->child != -1 && server->owner == index)
+            {
+                kill(server->child, SIGTERM);
+            }
+            PresenterServer_Close(server, index);
+        }
+        else if (value != NULL)
+        {
+            PresenterServer_Handle(server, index, value, state);
+        }
+    }
+
+    if (fds[0].revents & POLLIN)
+    {
+        PresenterServer_Accept(server);
+    }
+}
+
+// PresenterServer_Displayed answers show commands that didn't wait for the
+// display to end, once it is on screen
+void PresenterServer_Displayed(struct PresenterServer *server)
+{
+    for (int i = 0; i < SERVER_MAX_CONNECTIONS; i++)
+    {
+        if (server->connections[i].fd != -1 && server->connections[i].waiting_for_display)
+        {
+            server->connections[i].waiting_for_display = false;
+            PresenterServer_Reply(server, i, ExitCodeSuccess);
+        }
+    }
+}
+
+// PresenterServer_Finish answers the clients waiting for the display to end
+static void PresenterServer_Finish(struct PresenterServer *server, int exit_code)
+{
+    server->last_exit_code = exit_code;
+    server->owner = -1;
+    for (int i = 0; i < SERVER_MAX_CONNECTIONS; i++)
+    {
+        struct ServerConnection *connection = &server->connections[i];
+        if (connection->fd != -1 && (connection->waiting || connection->waiting_for_display))
+        {
+            connection->waiting = false;
+            connection->waiting_for_display = false;
+            PresenterServer_Reply(server, i, exit_code);
+        }
+    }
+}
+
+// present displays the items of the app state until a button, the timeout
+// or a signal ends the display, returning the exit code
+int present(struct AppState *state)
+{
+    // get initial wifi state
+    int was_online = PLAT_isOnline();
+
+    // get the current time
+    gettimeofday(&state->start_time, NULL);
+
+    int show_setting = 0; // 1=brightness,2=volume
+
+    if (state->timeout_seconds <= 0 || state->disable_auto_sleep)
+    {
+        PWR_disableAutosleep();
+    }
+
+    FrameCache_Init(&state->frame_cache, state->render_ahead, screen);
+    Slideshow_Init(&state->slideshow);
+    // a slideshow draws at least the next item ahead, so changing to it on
+    // its deadline only copies it to the screen
+    if (state->frame_cache.capacity == 0 && (state->slide_duration_ms > 0 || state->items_state->durations))
+    {
+        state->frame_cache.capacity = 1;
+    }
+    struct Transition transition = {.kind = TransitionKindNone, .item = -1};
+
+    // the thumbnails of the grid view are made to fit its cells
+    if (state->grid_columns > 0)
+    {
+        SDL_Rect cell = grid_cell(state, 0);
+        state->thumbnails = ThumbnailPool_New(cell.w, cell.h, state->grid_columns * state->grid_rows, state->thumbnail_cache);
+        if (state->thumbnails == NULL)
+        {
+            log_error("Failed to allocate thumbnails, the grid view is disabled");
+            state->grid_columns = 0;
+        }
+    }
+
+    struct RenderThread *render_thread = NULL;
+    if (state->render_thread)
+    {
+        render_thread = RenderThread_Start(state);
+        if (render_thread == NULL)
+        {
+            log_error("Failed to start render thread, drawing inline");
+        }
+    }
+
+    // the items are reloaded while displayed when --watch is set
+    struct FileWatcher *watcher = NULL;
+    if (state->watch)
+    {
+        watcher = FileWatcher_New(state->file);
+        if (watcher == NULL)
+        {
+            log_error("Failed to watch file, changes won't be reloaded");
+        }
+    }
+
+    display_running = 1;
+    while (!state->quitting)
+    {
+        // start the frame to ensure GFX_sync() works
+        // on devices that don't support vsync
+        GFX_startFrame();
+
+        // handle turning the on/off screen on/off
+        // as well as general power management
+        PWR_update(&state->redraw, &show_setting, NULL, NULL);
+
+        // check if the device is on wifi
+        // redraw if the wifi state changed
+        // and then update our state
+        int is_online = PLAT_isOnline();
+        if (was_online != is_online)
+        {
+            state->redraw = 1;
+        }
+        was_online = is_online;
+
+        // take the items parsed in the background since the last frame
+        ItemsProgress_Wait(state, 0);
+
+        // handle any input events
+        handle_input(state);
+
+        // handle commands sent to --serve while displaying
+        if (state->server != NULL)
+        {
+            PresenterServer_Poll(state->server, state, 0);
+        }
+
+        // apply the commands streamed to --follow since the last frame
+        if (state->follower != NULL && !state->quitting)
+        {
+            Follower_Poll(state->follower, state);
+        }
+
+        // reload the items when the file changed on disk
+        if (watcher != NULL && FileWatcher_Changed(watcher))
+        {
+            CommandQueue_Push(&command_queue, CommandReload, 0);
+        }
+
+        // change to the next item when the slideshow is due
+        Slideshow_Tick(&state->slideshow);
+
+        // apply what signals, clients, stdin, the watcher and the slideshow asked for this frame
+        run_commands(state);
+
+        // parse the items around a new selection when lazily loading, an
+        // invalid item exits the same way as when every item is parsed up front
+        if (!state->quitting && !ItemsState_Hydrate(state->items_state))
+        {
+            state->exit_code = ExitCodeError;
+            break;
+        }
+
+        // time the item on screen from now on
+        Slideshow_Schedule(&state->slideshow, state);
+
+        // check and read ahead images without blocking the frame
+        probe_images(state);
+
+        // read the progress of the selected item, a bar that moved is
+        // drawn on its own unless the whole screen is redrawn anyway
+        bool progressed = ProgressBar_Update(&state->progress_bar, ItemsState_Current(state->items_state)->progress);
+
+        // the grid is drawn again as the thumbnails of its cells are made,
+        // it has no progress bar of its own
+        if (state->grid_shown)
+        {
+            state->redraw = state->redraw || ThumbnailPool_Fresh(state->thumbnails);
+            progressed = false;
+        }
+
+        // the next item is drawn ahead once it is due soon, even while the
+        // frames are kept busy and never get to draw it on an idle one
+        if (render_thread == NULL && !state->redraw && !state->grid_shown && Slideshow_Soon(&state->slideshow))
+        {
+            FrameCache_Build(&state->frame_cache, screen, state);
+        }
+
+        // with a render thread a change only asks for a frame, the screen
+        // is updated once the frame is finished. the grid is always drawn
+        // by the display
+        if (state->redraw && render_thread != NULL && !state->grid_shown)
+        {
+            RenderThread_Request(render_thread, state);
+            state->redraw = 0;
+        }
+
+        // redraw the screen if there has been a change
+        if (state->redraw || (render_thread != NULL && !state->grid_shown && RenderThread_Take(render_thread)))
+        {
+            // clear the screen at the beginning of each loop
+            GFX_clear(screen);
+
+            if (state->show_hardware_group)
+            {
+                pthread_mutex_lock(&gfx_lock);
+                // draw the hardware information in the top-right
+                GFX_blitHardwareGroup(screen, show_setting);
+                // draw the setting hints
+                if (show_setting && !GetHDMI())
+                {
+                    GFX_blitHardwareHints(screen, show_setting);
+                }
+                else
+                {
+                    GFX_blitButtonGroup((char *[]){BTN_SLEEP == BTN_POWER ? "POWER" : "MENU", "SLEEP", NULL}, 0, screen, 0);
+                }
+                pthread_mutex_unlock(&gfx_lock);
+            }
+
+            // your draw logic goes here, items drawn ahead of time are only copied
+            if (state->grid_shown)
+            {
+                if (render_thread != NULL)
+                {
+                    RenderThread_Wait(render_thread);
+                }
+                draw_screen(screen, state);
+
+                // leaving the grid changes to the selected item at once
+                transition.kind = TransitionKindNone;
+                transition.item = -1;
+            }
+            else if (render_thread != NULL)
+            {
+                RenderThread_Show(render_thread, screen, state);
+            }
+            else if (!FrameCache_Draw(&state->frame_cache, screen, state))
+            {
+                draw_screen(screen, state);
+            }
+
+            // the change to another item is animated from the frame shown before it
+            long shown = render_thread != NULL && !state->grid_shown ? render_thread->front->item : state->items_state->selected;
+            bool animated = !state->grid_shown && Transition_Begin(&transition, screen, state, shown);
+
+            // Takes the screen buffer and displays it on the screen
+            Handoff_Capture(&handoff, screen);
+            GFX_flip(screen);
+            Slideshow_Shown(&state->slideshow, shown);
+
+            if (state->server != NULL)
+            {
+                PresenterServer_Displayed(state->server);
+            }
+
+            // screens that flip between two buffers need the full frame in
+            // both before the bar alone can be drawn into either of them,
+            // transitions show their final frame twice for the same reason
+            bool repeat = !animated && !state->grid_shown && state->progress_bar.under != NULL && !state->progress_bar.repeated;
+            state->progress_bar.repeated = repeat;
+            if (repeat && render_thread != NULL)
+            {
+                render_thread->again = true;
+            }
+            else if (repeat)
+            {
+                state->redraw = 1;
+            }
+        }
+        else if (transition.kind != TransitionKindNone)
+        {
+            Transition_Step(&transition, screen, state);
+            Handoff_Capture(&handoff, screen);
+            GFX_flip(screen);
+        }
+        else if (progressed)
+        {
+            ProgressBar_Draw(&state->progress_bar, screen, false);
+            Handoff_Capture(&handoff, screen);
+            GFX_flip(screen);
+        }
+        else
+        {
+            // draw the items the selection may move to next while nothing
+            // else happens, the render thread does so on its own
+            if (render_thread == NULL && !state->grid_shown)
+            {
+                FrameCache_Build(&state->frame_cache, screen, state);
+            }
+
+            // Slows down the frame rate to match the refresh rate of the screen
+            // when the screen is not being redrawn
+            GFX_sync();
+        }
+
+        // if the sleep seconds is larger than 0, check if the sleep has expired
+        if (state->timeout_seconds > 0)
+        {
+            struct timeval current_time;
+            gettimeofday(&current_time, NULL);
+            if (current_time.tv_sec - state->start_time.tv_sec >= state->timeout_seconds)
+            {
+                state->exit_code = ExitCodeTimeout;
+                state->quitting = 1;
+            }
+
+            if (current_time.tv_sec != state->start_time.tv_sec && state->show_time_left)
+            {
+                state->redraw = 1;
+            }
+        }
     }
+    display_running = 0;
+
+    RenderThread_Stop(render_thread);
+    ThumbnailPool_Free(state->thumbnails);
+    state->thumbnails = NULL;
+    Slideshow_Report(&state->slideshow);
+    Transition_Free(&transition);
+    ProgressBar_Close(&state->progress_bar);
+    FrameCache_Free(&state->frame_cache);
+    FileWatcher_Free(watcher);
+    release_preloaded_image(state);
+    ItemsProgress_Free(state);
+    return state->exit_code;
+}
 
-    enum MessageAlignment default_alignment = MessageAlignmentMiddle;
-    if (strcmp(alignment, "top") == 0)
+// reset_getopt prepares getopt_long to parse another command line
+static void reset_getopt(void)
+{
+#ifdef __APPLE__
+    optreset = 1;
+    optind = 1;
+#else
+    optind = 0;
+#endif
+}
+
+// PresenterServer_Fonts opens the fonts of a display, reusing the ones of
+// the previous display when the font and size didn't change
+static bool PresenterServer_Fonts(struct PresenterServer *server, struct AppState *state)
+{
+    struct Fonts *cached = &server->fonts;
+    if (cached->font_path != NULL && cached->size == state->fonts.size && strcmp(cached->font_path, state->fonts.font_path) == 0)
     {
-        default_alignment = MessageAlignmentTop;
+        free(state->fonts.font_path);
+        state->fonts = *cached;
+        return true;
     }
-    else if (strcmp(alignment, "bottom") == 0)
+
+    if (!open_fonts(state))
     {
-        default_alignment = MessageAlignmentBottom;
+        if (state->fonts.large != NULL)
+        {
+            TTF_CloseFont(state->fonts.large);
+        }
+        free(state->fonts.font_path);
+        return false;
     }
-    else if (strcmp(alignment, "middle") == 0 || strcmp(alignment, "") == 0)
+
+    if (cached->font_path != NULL)
     {
-        default_alignment = MessageAlignmentMiddle;
+        TTF_CloseFont(cached->large);
+        TTF_CloseFont(cached->small);
+        free(cached->font_path);
     }
-    else
+    *cached = state->fonts;
+    return true;
+}
+
+// PresenterServer_Wait marks the client that sent a show command as waiting
+// for the display to end, or for it to be drawn when it asked not to wait
+static void PresenterServer_Wait(struct PresenterServer *server, JSON_Value *value, int index)
+{
+    JSON_Object *command = json_value_get_object(value);
+    bool wait = !json_object_has_value_of_type(command, "wait", JSONBoolean) || json_object_get_boolean(command, "wait");
+    server->connections[index].waiting = wait;
+    server->connections[index].waiting_for_display = !wait;
+    server->owner = wait ? index : -1;
+}
+
+// PresenterServer_Load loads the items of a display while its fonts open
+static bool PresenterServer_Load(struct PresenterServer *server, struct AppState *state)
+{
+    struct StartupLoader loader;
+    StartupLoader_Start(&loader, state);
+    bool fonts = PresenterServer_Fonts(server, state);
+    return StartupLoader_Finish(&loader) && fonts;
+}
+
+// PresenterServer_Show runs a show command, parsing its arguments exactly
+// like the command line of a separate process, and returns its exit code
+static int PresenterServer_Show(struct PresenterServer *server, JSON_Value *value)
+{
+    JSON_Object *command = json_value_get_object(value);
+    JSON_Array *args = json_object_get_array(command, "args");
+    size_t arg_count = json_array_get_count(args);
+
+    char **argv = calloc(arg_count + 2, sizeof(char *));
+    if (argv == NULL)
     {
-        log_error("Invalid message alignment provided");
-        return false;
+        return ExitCodeError;
     }
 
-    if (strlen(message) > 0)
+    argv[0] = "minui-presenter";
+    for (size_t i = 0; i < arg_count; i++)
     {
-        struct ItemsState *items_state = malloc(sizeof(struct ItemsState));
-        items_state->items = malloc(sizeof(struct Item) * 1);
-        items_state->items[0].text = strdup(message);
-        items_state->items[0].background_color = "#000000";
-        items_state->items[0].background_image = NULL;
-        items_state->items[0].image_exists = false;
-        items_state->items[0].show_pill = state->show_pill;
-
-        if (strcmp(state->background_color, "") != 0)
+        argv[i + 1] = (char *)json_array_get_string(args, i);
+        if (argv[i + 1] == NULL)
         {
-            items_state->items[0].background_color = strdup(state->background_color);
+            log_error("Invalid command arguments received");
+            free(argv);
+            return ExitCodeError;
         }
+    }
 
-        if (strcmp(state->background_image, "") != 0)
-        {
-            items_state->items[0].background_image = strdup(state->background_image);
-            items_state->items[0].image_exists = access(state->background_image, F_OK) != -1;
-        }
+    struct AppState state;
+    init_state(&state);
+
+    // forked displays are left alone, the parent answers the clients
+    state.server = server->zygote ? NULL : server;
+
+    reset_getopt();
+    if (!parse_arguments(&state, arg_count + 1, argv))
+    {
+        ItemsState_Free(state.items_state);
+        free(state.fonts.font_path);
+        AssetPack_Close(&asset_pack);
+        free(argv);
+        return ExitCodeError;
+    }
 
-        items_state->items[0].alignment = default_alignment;
-        items_state->item_count = 1;
-        items_state->selected = 0;
-        state->items_state = items_state;
+    int exit_code;
+    if (state.follow)
+    {
+        log_error("--follow is not supported by --serve, send select commands instead");
+        exit_code = ExitCodeError;
+        free(state.fonts.font_path);
     }
-    else if (strcmp(state->file, "") != 0)
+    else if (strcmp(state.render_output, "") != 0)
     {
-        state->items_state = ItemsState_New(state->file, state->item_key, state->background_image, state->background_color, state->show_pill, default_alignment);
-        if (state->items_state == NULL)
+        log_error("--render-all is not supported by --serve");
+        exit_code = ExitCodeError;
+        free(state.fonts.font_path);
+    }
+    else if (strcmp(state.pack_output, "") != 0)
+    {
+        exit_code = write_asset_pack(state.pack_output, state.pack_inputs, state.pack_input_count, state.pack_format) ? ExitCodeSuccess : ExitCodeSerializeError;
+    }
+    else if (strcmp(state.compile_output, "") != 0)
+    {
+        exit_code = ExitCodeError;
+        if (load_items(&state))
         {
-            log_error("Failed to hydrate display states");
-            return false;
+            exit_code = compile_deck(state.items_state, state.compile_output) ? ExitCodeSuccess : ExitCodeSerializeError;
         }
+        free(state.fonts.font_path);
     }
-    else
+    else if (!PresenterServer_Load(server, &state))
     {
-        log_error("No message or file provided");
-        return false;
+        exit_code = ExitCodeError;
     }
-
-    if (font_path != NULL)
+    else
     {
-        // check if the font path is valid
-        if (access(font_path, F_OK) == -1)
+        if (json_object_has_value_of_type(command, "selected", JSONNumber))
         {
-            log_error("Invalid font path provided");
-            return false;
+            double selected = json_object_get_number(command, "selected");
+            if (selected >= 0 && selected <= INT_MAX)
+            {
+                ItemsProgress_Wait(&state, (size_t)selected);
+            }
+            if (selected >= 0 && selected < state.items_state->item_count)
+            {
+                state.items_state->selected = (int)selected;
+            }
         }
 
-        state->fonts.font_path = strdup(font_path);
+        exit_code = present(&state);
+
+        if (state.timeout_seconds <= 0 || state.disable_auto_sleep)
+        {
+            PWR_enableAutosleep();
+        }
     }
-    else
+
+    ItemsProgress_Free(&state);
+    ItemsState_Free(state.items_state);
+    AssetPack_Close(&asset_pack);
+    free(argv);
+    return exit_code;
+}
+
+// child_signal_handler only interrupts the zygote's poll when a display exits
+static void child_signal_handler(int signal)
+{
+}
+
+// PresenterServer_Fork runs a show command in a child process, which starts
+// with the screen, input and fonts of the zygote already initialized
+static void PresenterServer_Fork(struct PresenterServer *server, JSON_Value *value)
+{
+    pid_t pid = fork();
+    if (pid == -1)
     {
-        state->fonts.font_path = strdup(FONT_PATH);
+        log_error("Failed to fork display process");
+        PresenterServer_Finish(server, ExitCodeError);
+        return;
     }
 
-    // Apply default values for certain buttons and texts
-    if (strcmp(state->action_button, "") == 0)
+    if (pid == 0)
     {
-        strncpy(state->action_button, "", sizeof(state->action_button));
+        // the parent keeps talking to the clients
+        close(server->listen_fd);
+        for (int i = 0; i < SERVER_MAX_CONNECTIONS; i++)
+        {
+            if (server->connections[i].fd != -1)
+            {
+                close(server->connections[i].fd);
+            }
+        }
+        signal(SIGCHLD, SIG_DFL);
+        signal(SIGPIPE, SIG_DFL);
+
+        // commands queued so far were for the zygote to forward
+        CommandQueue_Init(&command_queue);
+
+        // threads don't survive fork, so the prober is started per child
+        ImageProber_Start(&image_prober);
+
+        int exit_code = PresenterServer_Show(server, value);
+
+        // the screen and input belong to the zygote, so nothing is torn down
+        fflush(stdout);
+        fflush(stderr);
+        _exit(exit_code);
     }
 
-    if (strcmp(state->action_text, "") == 0)
+    server->child = pid;
+
+    // the child can't tell when it was drawn, so clients that don't wait
+    // are answered as soon as it runs
+    PresenterServer_Displayed(server);
+}
+
+// PresenterServer_Forward passes the commands signalled to the zygote on to
+// the running child, as the same signals. they are dropped without a child
+static void PresenterServer_Forward(struct PresenterServer *server)
+{
+    struct Command command;
+    while (CommandQueue_Pop(&command_queue, &command))
     {
-        strncpy(state->action_text, "ACTION", sizeof(state->action_text));
+        if (server->child == -1)
+        {
+            continue;
+        }
+
+        if (command.kind == CommandMove && command.value == 1)
+        {
+            kill(server->child, SIGUSR1);
+        }
+        else if (command.kind == CommandMove && command.value == -1)
+        {
+            kill(server->child, SIGUSR2);
+        }
+#ifdef SIGRTMIN
+        else if (command.kind == CommandMove || command.kind == CommandSelect)
+        {
+            sigqueue(server->child, command.kind == CommandSelect ? SIGRTMIN : SIGRTMIN + 1, (union sigval){.sival_int = command.value});
+        }
+#endif
     }
+}
 
-    if (strcmp(state->cancel_button, "") == 0)
+// PresenterServer_Reap answers the clients waiting on a child that exited,
+// with its exit code or 128 + the signal that killed it
+static void PresenterServer_Reap(struct PresenterServer *server, bool block)
+{
+    if (server->child == -1)
     {
-        strncpy(state->cancel_button, "B", sizeof(state->cancel_button));
+        return;
     }
 
-    if (strcmp(state->confirm_text, "") == 0)
+    int status;
+    pid_t pid;
+    do
     {
-        strncpy(state->confirm_text, "SELECT", sizeof(state->confirm_text));
+        pid = waitpid(server->child, &status, block ? 0 : WNOHANG);
+    } while (pid == -1 && errno == EINTR);
+
+    if (pid <= 0)
+    {
+        return;
     }
 
-    if (strcmp(state->cancel_text, "") == 0)
+    server->child = -1;
+    PresenterServer_Finish(server, WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status));
+}
+
+// serve keeps the screen, input and fonts initialized and displays
+// whatever clients of the socket ask for until a quit command arrives
+// as a zygote, every display runs in a forked child instead
+int serve(const char *socket_path, bool zygote)
+{
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(socket_path) >= sizeof(address.sun_path))
     {
-        strncpy(state->cancel_text, "BACK", sizeof(state->cancel_text));
+        log_error("Socket path is too long");
+        return ExitCodeError;
     }
+    strncpy(address.sun_path, socket_path, sizeof(address.sun_path) - 1);
 
-    if (strcmp(state->inaction_text, "") == 0)
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd == -1)
     {
-        strncpy(state->inaction_text, "OTHER", sizeof(state->inaction_text));
+        log_error("Failed to create socket");
+        return ExitCodeError;
     }
+    set_cloexec(listen_fd);
 
-    // validate that hardware buttons aren't assigned to more than once
-    bool a_button_assigned = false;
-    bool b_button_assigned = false;
-    bool x_button_assigned = false;
-    bool y_button_assigned = false;
-    bool i_button_assigned = false;
-    if (strcmp(state->action_button, "A") == 0)
+    // a socket left behind by a server that was killed is replaced,
+    // one that is still answering is not
+    if (connect(listen_fd, (struct sockaddr *)&address, sizeof(address)) == 0)
     {
-        a_button_assigned = true;
+        log_error("Another server is already listening on the socket");
+        close(listen_fd);
+        return ExitCodeError;
     }
-    if (strcmp(state->cancel_button, "A") == 0)
+    close(listen_fd);
+    unlink(socket_path);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd == -1 || bind(listen_fd, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listen_fd, SERVER_MAX_CONNECTIONS) != 0)
     {
-        if (a_button_assigned)
+        log_error("Failed to listen on socket");
+        if (listen_fd != -1)
         {
-            log_error("A button cannot be assigned to more than one button");
-            return false;
+            close(listen_fd);
         }
-
-        a_button_assigned = true;
+        return ExitCodeError;
     }
-    if (strcmp(state->confirm_button, "A") == 0)
+    set_cloexec(listen_fd);
+
+    struct PresenterServer server = {
+        .listen_fd = listen_fd,
+        .socket_path = socket_path,
+        .pending_connection = -1,
+        .owner = -1,
+        .last_exit_code = ExitCodeSuccess,
+        .zygote = zygote,
+        .child = -1,
+    };
+    for (int i = 0; i < SERVER_MAX_CONNECTIONS; i++)
     {
-        if (a_button_assigned)
-        {
-            log_error("A button cannot be assigned to more than one button");
-            return false;
-        }
-
-        a_button_assigned = true;
+        server.connections[i].fd = -1;
     }
-    if (strcmp(state->inaction_button, "A") == 0)
+
+    swallow_stdout_from_function(init);
+    install_signal_handlers();
+
+    // replies to clients that went away must not kill the server
+    signal(SIGPIPE, SIG_IGN);
+
+    if (zygote)
     {
-        if (a_button_assigned)
+        struct sigaction sa = {.sa_handler = child_signal_handler};
+        sigemptyset(&sa.sa_mask);
+        sigaction(SIGCHLD, &sa, NULL);
+
+        // children inherit the default fonts, only other fonts are opened per display
+        struct AppState state;
+        init_state(&state);
+        state.fonts.font_path = strdup(FONT_PATH);
+        if (open_fonts(&state))
         {
-            log_error("A button cannot be assigned to more than one button");
-            return false;
+            server.fonts = state.fonts;
+        }
+        else
+        {
+            free(state.fonts.font_path);
         }
-
-        a_button_assigned = true;
     }
-
-    if (strcmp(state->action_button, "B") == 0)
+    else if (!ImageProber_Start(&image_prober))
     {
-        b_button_assigned = true;
+        log_error("Failed to start image prober threads, checking images inline");
     }
-    if (strcmp(state->cancel_button, "B") == 0)
+
+    bool quitting = false;
+    while (!quitting)
     {
-        if (b_button_assigned)
+        while (server.pending == NULL)
         {
-            log_error("B button cannot be assigned to more than one button");
-            return false;
+            // a running child is checked on regularly, as it can exit
+            // between checking on it and starting to poll
+            PresenterServer_Poll(&server, NULL, server.child != -1 ? 100 : -1);
+            PresenterServer_Forward(&server);
+            PresenterServer_Reap(&server, false);
         }
 
-        b_button_assigned = true;
-    }
-    if (strcmp(state->confirm_button, "B") == 0)
-    {
-        if (b_button_assigned)
+        JSON_Value *value = server.pending;
+        int index = server.pending_connection;
+        server.pending = NULL;
+        server.pending_connection = -1;
+
+        // a new command replaces the display of the running child
+        if (server.child != -1)
         {
-            log_error("B button cannot be assigned to more than one button");
-            return false;
+            kill(server.child, SIGTERM);
+            PresenterServer_Reap(&server, true);
         }
 
-        b_button_assigned = true;
-    }
-    if (strcmp(state->inaction_button, "B") == 0)
-    {
-        if (b_button_assigned)
+        const char *name = json_object_get_string(json_value_get_object(value), "command");
+        if (name != NULL && strcmp(name, "quit") == 0)
         {
-            log_error("B button cannot be assigned to more than one button");
-            return false;
+            PresenterServer_Reply(&server, index, ExitCodeSuccess);
+            quitting = true;
         }
-
-        b_button_assigned = true;
-    }
-
-    if (strcmp(state->action_button, "X") == 0)
-    {
-        x_button_assigned = true;
-    }
-    if (strcmp(state->cancel_button, "X") == 0)
-    {
-        if (x_button_assigned)
+        else if (zygote)
         {
-            log_error("X button cannot be assigned to more than one button");
-            return false;
+            PresenterServer_Wait(&server, value, index);
+            PresenterServer_Fork(&server, value);
         }
-
-        x_button_assigned = true;
-    }
-    if (strcmp(state->confirm_button, "X") == 0)
-    {
-        if (x_button_assigned)
+        else
         {
-            log_error("X button cannot be assigned to more than one button");
-            return false;
+            PresenterServer_Wait(&server, value, index);
+            PresenterServer_Finish(&server, PresenterServer_Show(&server, value));
         }
+        json_value_free(value);
 
-        x_button_assigned = true;
+        // a signal that ended a display shown in this process ends the server too
+        quitting = quitting || exit_signal_code != 0;
     }
-    if (strcmp(state->inaction_button, "X") == 0)
+
+    for (int i = 0; i < SERVER_MAX_CONNECTIONS; i++)
     {
-        if (x_button_assigned)
+        if (server.connections[i].fd != -1)
         {
-            log_error("X button cannot be assigned to more than one button");
-            return false;
+            PresenterServer_Close(&server, i);
         }
-
-        x_button_assigned = true;
     }
+    close(listen_fd);
+    unlink(socket_path);
 
-    if (strcmp(state->action_button, "Y") == 0)
+    ImageProber_Stop(&image_prober);
+    swallow_stdout_from_function(destruct);
+
+    if (server.fonts.font_path != NULL)
     {
-        y_button_assigned = true;
+        TTF_CloseFont(server.fonts.large);
+        TTF_CloseFont(server.fonts.small);
+        free(server.fonts.font_path);
     }
-    if (strcmp(state->cancel_button, "Y") == 0)
-    {
-        if (y_button_assigned)
-        {
-            log_error("Y button cannot be assigned to more than one button");
-            return false;
-        }
 
-        y_button_assigned = true;
+    return exit_signal_code != 0 ? exit_signal_code : ExitCodeSuccess;
+}
+
+// client sends its arguments to a --serve process instead of displaying
+// them itself, exiting with the exit code the server answered with
+// the arguments "quit", "wait" and "select <index>" send those commands instead
+int client(const char *socket_path, int argc, char *argv[])
+{
+    JSON_Value *value = json_value_init_object();
+    JSON_Object *command = json_value_get_object(value);
+    if (argc == 1 && (strcmp(argv[0], "quit") == 0 || strcmp(argv[0], "wait") == 0))
+    {
+        json_object_set_string(command, "command", argv[0]);
     }
-    if (strcmp(state->confirm_button, "Y") == 0)
+    else if (argc == 2 && strcmp(argv[0], "select") == 0)
     {
-        if (y_button_assigned)
+        json_object_set_string(command, "command", "select");
+        json_object_set_number(command, "selected", atoi(argv[1]));
+    }
+    else
+    {
+        JSON_Value *args = json_value_init_array();
+        bool wait = true;
+        for (int i = 0; i < argc; i++)
         {
-            log_error("Y button cannot be assigned to more than one button");
-            return false;
+            if (strcmp(argv[i], "--no-wait") == 0)
+            {
+                wait = false;
+                continue;
+            }
+            json_array_append_string(json_value_get_array(args), argv[i]);
         }
 
-        y_button_assigned = true;
+        json_object_set_string(command, "command", "show");
+        json_object_set_value(command, "args", args);
+        json_object_set_boolean(command, "wait", wait);
     }
-    if (strcmp(state->inaction_button, "Y") == 0)
+
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    strncpy(address.sun_path, socket_path, sizeof(address.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1 || connect(fd, (struct sockaddr *)&address, sizeof(address)) != 0)
     {
-        if (y_button_assigned)
+        log_error("Failed to connect to server");
+        if (fd != -1)
         {
-            log_error("Y button cannot be assigned to more than one button");
-            return false;
+            close(fd);
         }
-
-        y_button_assigned = true;
+        json_value_free(value);
+        return ExitCodeError;
     }
 
-    // validate that the confirm and cancel buttons are valid
-    if (strcmp(state->confirm_button, "A") != 0 && strcmp(state->confirm_button, "B") != 0 && strcmp(state->confirm_button, "X") != 0 && strcmp(state->confirm_button, "Y") != 0 && strcmp(state->confirm_button, "") != 0)
+    int exit_code = ExitCodeError;
+    JSON_Value *reply = NULL;
+    if (write_frame(fd, value))
     {
-        log_error("Invalid confirm button provided");
-        return false;
+        reply = read_frame(fd);
     }
-    if (strcmp(state->cancel_button, "A") != 0 && strcmp(state->cancel_button, "B") != 0 && strcmp(state->cancel_button, "X") != 0 && strcmp(state->cancel_button, "Y") != 0 && strcmp(state->cancel_button, "") != 0)
+
+    if (reply != NULL && json_object_has_value_of_type(json_value_get_object(reply), "exit_code", JSONNumber))
     {
-        log_error("Invalid cancel button provided");
-        return false;
+        exit_code = (int)json_object_get_number(json_value_get_object(reply), "exit_code");
     }
-    if (strcmp(state->action_button, "A") != 0 && strcmp(state->action_button, "B") != 0 && strcmp(state->action_button, "X") != 0 && strcmp(state->action_button, "Y") != 0 && strcmp(state->action_button, "") != 0)
+    else
     {
-        log_error("Invalid action button provided");
-        return false;
+        log_error("No answer received from server");
     }
-    if (strcmp(state->inaction_button, "A") != 0 && strcmp(state->inaction_button, "B") != 0 && strcmp(state->inaction_button, "X") != 0 && strcmp(state->inaction_button, "Y") != 0 && strcmp(state->inaction_button, "") != 0)
+
+    if (reply != NULL)
     {
-        log_error("Invalid inaction button provided");
-        return false;
+        json_value_free(reply);
     }
-
-    return true;
+    json_value_free(value);
+    close(fd);
+    return exit_code;
 }
 
-// set_cloexec sets the CLOEXEC flag on a file descriptor
-static void set_cloexec(int fd)
+// set_progress writes progress into a segment, creating it when needed, for
+// producers that can't map the segment themselves
+int set_progress(const char *path, const char *value, const char *total)
 {
-    int flags = fcntl(fd, F_GETFD);
-    if (flags == -1)
+    char *value_end;
+    char *total_end;
+    unsigned long parsed_value = strtoul(value, &value_end, 10);
+    unsigned long parsed_total = strtoul(total, &total_end, 10);
+    if (*value == '\0' || *value_end != '\0' || *total == '\0' || *total_end != '\0' || parsed_value > UINT32_MAX || parsed_total > UINT32_MAX)
     {
-        return;
+        log_error("Invalid progress value provided");
+        return ExitCodeError;
     }
 
-    fcntl(fd, F_SETFD, flags | FD_CLOEXEC);
-}
-
-// suppress_output suppresses stdout and stderr
-// returns a single integer containing both file descriptors
-int suppress_output(void)
-{
-    int stdout_fd = dup(STDOUT_FILENO);
-    int stderr_fd = dup(STDERR_FILENO);
-
-    // Prevent child processes started while stdout is suppressed from
-    // inheriting the saved descriptors and keeping command-substitution
-    // pipes open after the main process exits.
-    set_cloexec(stdout_fd);
-    set_cloexec(stderr_fd);
-
-    int dev_null_fd = open("/dev/null", O_WRONLY);
-    dup2(dev_null_fd, STDOUT_FILENO);
-    dup2(dev_null_fd, STDERR_FILENO);
-    close(dev_null_fd);
-
-    return (stdout_fd << 16) | stderr_fd;
-}
-
-// restore_output restores stdout and stderr to the original file descriptors
-void restore_output(int saved_fds)
-{
-    int stdout_fd = (saved_fds >> 16) & 0xFFFF;
-    int stderr_fd = saved_fds & 0xFFFF;
-
-    fflush(stdout);
-    fflush(stderr);
-
-    dup2(stdout_fd, STDOUT_FILENO);
-    dup2(stderr_fd, STDERR_FILENO);
-
-    close(stdout_fd);
-    close(stderr_fd);
-}
-
-// swallow_stdout_from_function swallows stdout from a function
-// this is useful for suppressing output from a function
-// that we don't want to see in the log file
-// the InitSettings() function is an example of this (some implementations print to stdout)
-void swallow_stdout_from_function(void (*func)(void))
-{
-    int saved_fds = suppress_output();
-
-    func();
-
-    restore_output(saved_fds);
-}
-
-// init initializes the app state
-// everything is placed here as MinUI sometimes logs to stdout
-// and the logging happens depending on the platform
-void init()
-{
-    // set the cpu speed to the menu speed
-    // this is done here to ensure we downclock
-    // the menu (no need to draw power unnecessarily)
-    PWR_setCPUSpeed(CPU_SPEED_MENU);
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    struct stat st;
+    if (fd == -1 || fstat(fd, &st) != 0 || (st.st_size < (off_t)sizeof(struct ProgressSegment) && ftruncate(fd, sizeof(struct ProgressSegment)) != 0))
+    {
+        log_error("Failed to open progress segment");
+        if (fd != -1)
+        {
+            close(fd);
+        }
+        return ExitCodeError;
+    }
 
-    // initialize:
-    // - the screen, allowing us to draw to it
-    // - input from the pad/joystick/buttons/etc.
-    // - power management
-    // - sync hardware settings (brightness, hdmi, speaker, etc.)
-    if (screen == NULL)
+    struct ProgressSegment *segment = mmap(NULL, sizeof(struct ProgressSegment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment == MAP_FAILED)
     {
-        screen = GFX_init(MODE_MAIN);
+        log_error("Failed to map progress segment");
+        return ExitCodeError;
     }
-    PAD_init();
-    PWR_init();
-    InitSettings();
-}
 
-// destruct cleans up the app state in reverse order
-void destruct()
-{
-    QuitSettings();
-    PWR_quit();
-    PAD_quit();
-    GFX_quit();
+    // odd even when a previous writer died halfway through an update
+    uint32_t sequence = (atomic_load_explicit(&segment->sequence, memory_order_relaxed) + 1) | 1;
+    atomic_store_explicit(&segment->sequence, sequence, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    atomic_store_explicit(&segment->value, (uint32_t)parsed_value, memory_order_relaxed);
+    atomic_store_explicit(&segment->total, (uint32_t)parsed_total, memory_order_relaxed);
+    atomic_store_explicit(&segment->sequence, sequence + 1, memory_order_release);
+
+    munmap(segment, sizeof(struct ProgressSegment));
+    return ExitCodeSuccess;
 }
 
 // main is the entry point for the app
 int main(int argc, char *argv[])
 {
-    // Initialize app state
-    char default_action_button[1024] = "";
-    char default_action_text[1024] = "ACTION";
-    char default_background_image[1024] = "";
-    char default_background_color[1024] = "#000000";
-    char default_cancel_button[1024] = "B";
-    char default_cancel_text[1024] = "BACK";
-    char default_confirm_button[1024] = "A";
-    char default_confirm_text[1024] = "SELECT";
-    char default_inaction_button[1024] = "";
-    char default_inaction_text[1024] = "OTHER";
-    char default_file[1024] = "";
-    char default_item_key[1024] = "items";
-    char default_message[1024] = "";
-    struct AppState state = {
-        .redraw = 1,
-        .quitting = 0,
-        .exit_code = ExitCodeSuccess,
-        .show_hardware_group = false,
-        .timeout_seconds = 0,
-        .fonts = {
-            .size = FONT_LARGE,
-            .large = NULL,
-            .medium = NULL,
-            .font_path = NULL,
-        },
-        .action_show = false,
-        .confirm_show = false,
-        .cancel_show = false,
-        .disable_auto_sleep = false,
-        .inaction_show = false,
-        .quit_after_last_item = false,
-        .show_time_left = false,
-        .items_state = NULL,
-        .start_time = 0,
-        .show_pill = false,
-    };
+    // the server, its client and --set-progress take over the whole command line
+    if (argc >= 3 && strcmp(argv[1], "--serve") == 0)
+    {
+        return serve(argv[2], false);
+    }
+    if (argc >= 3 && strcmp(argv[1], "--zygote") == 0)
+    {
+        return serve(argv[2], true);
+    }
+    if (argc >= 3 && strcmp(argv[1], "--client") == 0)
+    {
+        return client(argv[2], argc - 3, argv + 3);
+    }
+    if (argc == 5 && strcmp(argv[1], "--set-progress") == 0)
+    {
+        return set_progress(argv[2], argv[3], argv[4]);
+    }
 
-    // assign the default values to the app state
-    strncpy(state.action_button, default_action_button, sizeof(state.action_button));
-    strncpy(state.action_text, default_action_text, sizeof(state.action_text));
-    strncpy(state.background_image, default_background_image, sizeof(state.background_image));
-    strncpy(state.background_color, default_background_color, sizeof(state.background_color));
-    strncpy(state.cancel_button, default_cancel_button, sizeof(state.cancel_button));
-    strncpy(state.cancel_text, default_cancel_text, sizeof(state.cancel_text));
-    strncpy(state.confirm_button, default_confirm_button, sizeof(state.confirm_button));
-    strncpy(state.confirm_text, default_confirm_text, sizeof(state.confirm_text));
-    strncpy(state.inaction_button, default_inaction_button, sizeof(state.inaction_button));
-    strncpy(state.inaction_text, default_inaction_text, sizeof(state.inaction_text));
-    strncpy(state.file, default_file, sizeof(state.file));
-    strncpy(state.item_key, default_item_key, sizeof(state.item_key));
+    struct AppState state;
+    init_state(&state);
 
     // parse the arguments
     if (!parse_arguments(&state, argc, argv))
@@ -1600,110 +10430,94 @@ int main(int argc, char *argv[])
         return ExitCodeError;
     }
 
-    swallow_stdout_from_function(init);
-
-    struct sigaction sa = {
-        .sa_handler = signal_handler,
-        .sa_flags = SA_RESTART};
-    sigemptyset(&sa.sa_mask);
-    sigaction(SIGINT, &sa, NULL);
-    sigaction(SIGTERM, &sa, NULL);
-    sigaction(SIGUSR1, &sa, NULL);
-
-    if (!open_fonts(&state))
+    // build an asset pack instead of displaying anything
+    if (strcmp(state.pack_output, "") != 0)
     {
-        return ExitCodeError;
+        return write_asset_pack(state.pack_output, state.pack_inputs, state.pack_input_count, state.pack_format) ? ExitCodeSuccess : ExitCodeSerializeError;
     }
 
-    // get initial wifi state
-    int was_online = PLAT_isOnline();
-
-    // get the current time
-    gettimeofday(&state.start_time, NULL);
+    // compile the items into a deck instead of displaying them
+    if (strcmp(state.compile_output, "") != 0)
+    {
+        if (!load_items(&state))
+        {
+            return ExitCodeError;
+        }
 
-    int show_setting = 0; // 1=brightness,2=volume
+        bool compiled = compile_deck(state.items_state, state.compile_output);
+        ItemsState_Free(state.items_state);
+        return compiled ? ExitCodeSuccess : ExitCodeSerializeError;
+    }
 
-    if (state.timeout_seconds <= 0 || state.disable_auto_sleep)
+    // draw every item into image files instead of displaying them
+    if (strcmp(state.render_output, "") != 0)
     {
-        PWR_disableAutosleep();
+        return render_all(&state);
     }
 
-    while (!state.quitting)
-    {
-        // start the frame to ensure GFX_sync() works
-        // on devices that don't support vsync
-        GFX_startFrame();
+    // the items and the first image load while the screen and fonts initialize
+    struct StartupLoader loader;
+    StartupLoader_Start(&loader, &state);
 
-        // handle turning the on/off screen on/off
-        // as well as general power management
-        PWR_update(&state.redraw, &show_setting, NULL, NULL);
+    swallow_stdout_from_function(init);
 
-        // check if the device is on wifi
-        // redraw if the wifi state changed
-        // and then update our state
-        int is_online = PLAT_isOnline();
-        if (was_online != is_online)
+    // the frame the previous display left stays up until the first frame is drawn
+    if (strcmp(state.handoff, "") != 0)
+    {
+        Handoff_Show(state.handoff, screen);
+        if (!Handoff_Start(&handoff, state.handoff, screen))
         {
-            state.redraw = 1;
+            log_error("Failed to allocate handoff frames");
         }
-        was_online = is_online;
+    }
 
-        // handle any input events
-        handle_input(&state);
+    install_signal_handlers();
 
-        // redraw the screen if there has been a change
-        if (state.redraw)
+    // the loader is waited for even when the fonts fail, it may still be using the state
+    bool fonts_opened = open_fonts(&state);
+    if (!StartupLoader_Finish(&loader) || !fonts_opened)
+    {
+        destruct_failed(&state);
+        return ExitCodeError;
+    }
+
+    if (state.follow)
+    {
+        state.follower = Follower_New(STDIN_FILENO, state.items_state);
+        if (state.follower == NULL)
         {
-            // clear the screen at the beginning of each loop
-            GFX_clear(screen);
+            destruct_failed(&state);
+            return ExitCodeError;
+        }
+    }
 
-            if (state.show_hardware_group)
-            {
-                // draw the hardware information in the top-right
-                GFX_blitHardwareGroup(screen, show_setting);
-                // draw the setting hints
-                if (show_setting && !GetHDMI())
-                {
-                    GFX_blitHardwareHints(screen, show_setting);
-                }
-                else
-                {
-                    GFX_blitButtonGroup((char *[]){BTN_SLEEP == BTN_POWER ? "POWER" : "MENU", "SLEEP", NULL}, 0, screen, 0);
-                }
-            }
+    // image checks and readahead run on worker threads
+    if (!ImageProber_Start(&image_prober))
+    {
+        log_error("Failed to start image prober threads, checking images inline");
+    }
 
-            // your draw logic goes here
-            draw_screen(screen, &state);
+    present(&state);
 
-            // Takes the screen buffer and displays it on the screen
-            GFX_flip(screen);
-        }
-        else
-        {
-            // Slows down the frame rate to match the refresh rate of the screen
-            // when the screen is not being redrawn
-            GFX_sync();
-        }
+    ImageProber_Stop(&image_prober);
+    Follower_Free(state.follower);
 
-        // if the sleep seconds is larger than 0, check if the sleep has expired
-        if (state.timeout_seconds > 0)
+    // the screen isn't cleared when the last frame is handed to the next display
+    if (strcmp(state.handoff, "") != 0)
+    {
+        if (!Handoff_Write(&handoff))
         {
-            struct timeval current_time;
-            gettimeofday(&current_time, NULL);
-            if (current_time.tv_sec - state.start_time.tv_sec >= state.timeout_seconds)
-            {
-                state.exit_code = ExitCodeTimeout;
-                state.quitting = 1;
-            }
-
-            if (current_time.tv_sec != state.start_time.tv_sec && state.show_time_left)
-            {
-                state.redraw = 1;
-            }
+            log_error("Failed to write handoff frame");
         }
+        swallow_stdout_from_function(destruct_keeping_screen);
+    }
+    else
+    {
+        swallow_stdout_from_function(destruct);
     }
 
-    swallow_stdout_from_function(destruct);
+    ItemsState_Free(state.items_state);
+    AssetPack_Close(&asset_pack);
 
     // exit the program
     return state.exit_code;